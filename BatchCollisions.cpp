@@ -0,0 +1,388 @@
+#include "BatchCollisions.h"
+
+// For sqrtf
+#include <cmath>
+
+//------------------------------------------------------
+// A point, line or box boiled down to what the batch
+// tests need: corners, axes, center and (for boxes) the
+// half sizes along each axis
+//------------------------------------------------------
+struct BatchConvex
+{
+   float x[4];
+   float y[4];
+   int cornerCount;
+   float axisX[2];
+   float axisY[2];
+   int axisCount;
+   float centerX;
+   float centerY;
+   float halfWidth;
+   float halfHeight;
+   ShapeType type;
+};
+
+//------------------------------------------------------
+// Fills in a BatchConvex for a point
+//------------------------------------------------------
+void MakeConvex(const Point* point, BatchConvex& convex)
+{
+   convex.type = SHAPE_POINT;
+   convex.x[0] = convex.centerX = point->X();
+   convex.y[0] = convex.centerY = point->Y();
+   convex.cornerCount = 1;
+   convex.axisCount = 0;
+   convex.halfWidth = convex.halfHeight = 0.0f;
+}
+
+//------------------------------------------------------
+// Fills in a BatchConvex for a line. Its axes are the
+// normal and the direction, so points past the ends miss.
+//------------------------------------------------------
+void MakeConvex(const Line* line, BatchConvex& convex)
+{
+   convex.type = LINE;
+   convex.x[0] = line->StartX();
+   convex.y[0] = line->StartY();
+   convex.x[1] = line->EndX();
+   convex.y[1] = line->EndY();
+   convex.cornerCount = 2;
+   convex.centerX = (convex.x[0] + convex.x[1]) * 0.5f;
+   convex.centerY = (convex.y[0] + convex.y[1]) * 0.5f;
+   convex.halfWidth = convex.halfHeight = 0.0f;
+
+   float dx = convex.x[1] - convex.x[0];
+   float dy = convex.y[1] - convex.y[0];
+   float length = sqrtf(dx * dx + dy * dy);
+   if (length > 0.0f) {
+      dx /= length;
+      dy /= length;
+      convex.axisX[0] = dy;
+      convex.axisY[0] = -dx;
+      convex.axisX[1] = dx;
+      convex.axisY[1] = dy;
+      convex.axisCount = 2;
+   }
+   else {
+      convex.axisCount = 0;
+   }
+}
+
+//------------------------------------------------------
+// Fills in a BatchConvex for a box
+//------------------------------------------------------
+void MakeConvex(const Box* box, BatchConvex& convex)
+{
+   convex.type = BOX;
+   for (int ii = 0; ii < Box::MAX_DIAGONALS; ++ii) {
+      Point corner = box->Corner((Box::DIAGONAL)ii);
+      convex.x[ii] = corner.X();
+      convex.y[ii] = corner.Y();
+   }
+   convex.cornerCount = 4;
+   box->Normal(0, convex.axisX[0], convex.axisY[0]);
+   box->Normal(1, convex.axisX[1], convex.axisY[1]);
+   convex.axisCount = 2;
+   convex.centerX = box->Center().X();
+   convex.centerY = box->Center().Y();
+   convex.halfWidth = box->HalfWidth();
+   convex.halfHeight = box->HalfHeight();
+}
+
+//------------------------------------------------------
+// Bounds of a BatchConvex's corners
+//------------------------------------------------------
+AABB ConvexBounds(const BatchConvex& convex)
+{
+   AABB bounds(convex.x[0], convex.y[0], convex.x[0], convex.y[0]);
+   for (int ii = 1; ii < convex.cornerCount; ++ii) {
+      if (convex.x[ii] < bounds.minX) bounds.minX = convex.x[ii];
+      if (convex.x[ii] > bounds.maxX) bounds.maxX = convex.x[ii];
+      if (convex.y[ii] < bounds.minY) bounds.minY = convex.y[ii];
+      if (convex.y[ii] > bounds.maxY) bounds.maxY = convex.y[ii];
+   }
+   return bounds;
+}
+
+//------------------------------------------------------
+// Projects a BatchConvex's corners onto an axis
+//------------------------------------------------------
+void ProjectConvex(const BatchConvex& convex, float axisX, float axisY, float& min, float& max)
+{
+   min = max = convex.x[0] * axisX + convex.y[0] * axisY;
+   for (int ii = 1; ii < convex.cornerCount; ++ii) {
+      float dot = convex.x[ii] * axisX + convex.y[ii] * axisY;
+      if (dot < min) min = dot;
+      if (dot > max) max = dot;
+   }
+}
+
+//------------------------------------------------------
+// Tests one set of axes for SAT, keeping the smallest
+// overlap. Returns false at the first gap.
+//------------------------------------------------------
+bool TestAxes(const BatchConvex& axes, const BatchConvex& a, const BatchConvex& b, BatchResult& result, float& smallest)
+{
+   float minA, maxA, minB, maxB;
+   for (int ii = 0; ii < axes.axisCount; ++ii) {
+      ProjectConvex(a, axes.axisX[ii], axes.axisY[ii], minA, maxA);
+      ProjectConvex(b, axes.axisX[ii], axes.axisY[ii], minB, maxB);
+      if (maxA < minB || maxB < minA) {
+         return false;
+      }
+
+      // Push A whichever way is shorter
+      float forward = maxB - minA;
+      float backward = maxA - minB;
+      float overlap = (forward < backward ? forward : -backward);
+      if (smallest < 0.0f || absValue(overlap) < smallest) {
+         smallest = absValue(overlap);
+         result.pushX = axes.axisX[ii] * overlap;
+         result.pushY = axes.axisY[ii] * overlap;
+      }
+   }
+   return true;
+}
+
+//------------------------------------------------------
+// SAT between the probe and a point, line or box
+//------------------------------------------------------
+void ConvexvConvex(const BatchConvex& probe, const BatchConvex& other, BatchResult& result)
+{
+   if (probe.axisCount == 0 && other.axisCount == 0) {
+      // Two points
+      result.hit = FloatEquals(probe.x[0], other.x[0]) && FloatEquals(probe.y[0], other.y[0]);
+      return;
+   }
+
+   float smallest = -1.0f;
+   result.hit = TestAxes(probe, probe, other, result, smallest)
+      && TestAxes(other, probe, other, result, smallest);
+   if (!result.hit) {
+      result.pushX = result.pushY = 0.0f;
+   }
+}
+
+//------------------------------------------------------
+// Closest point on a point, line or box to (x, y).
+// inside is set when (x, y) is inside a box.
+//------------------------------------------------------
+void ClosestOnConvex(const BatchConvex& convex, float x, float y, float& closestX, float& closestY, bool& inside)
+{
+   inside = false;
+   if (convex.type == SHAPE_POINT) {
+      closestX = convex.x[0];
+      closestY = convex.y[0];
+   }
+   else if (convex.type == LINE) {
+      float dx = convex.x[1] - convex.x[0];
+      float dy = convex.y[1] - convex.y[0];
+      float lengthSquared = dx * dx + dy * dy;
+      float t = (lengthSquared > 0.0f ? ((x - convex.x[0]) * dx + (y - convex.y[0]) * dy) / lengthSquared : 0.0f);
+      if (t < 0.0f) t = 0.0f;
+      if (t > 1.0f) t = 1.0f;
+      closestX = convex.x[0] + dx * t;
+      closestY = convex.y[0] + dy * t;
+   }
+   else {
+      // Into the box's space, clamp, and back out
+      float dx = x - convex.centerX;
+      float dy = y - convex.centerY;
+      float localX = dx * convex.axisX[0] + dy * convex.axisY[0];
+      float localY = dx * convex.axisX[1] + dy * convex.axisY[1];
+      inside = (absValue(localX) < convex.halfWidth && absValue(localY) < convex.halfHeight);
+      if (inside) {
+         // Snap to the closest face
+         if (convex.halfWidth - absValue(localX) < convex.halfHeight - absValue(localY)) {
+            localX = (localX < 0.0f ? -convex.halfWidth : convex.halfWidth);
+         }
+         else {
+            localY = (localY < 0.0f ? -convex.halfHeight : convex.halfHeight);
+         }
+      }
+      else {
+         if (localX < -convex.halfWidth) localX = -convex.halfWidth;
+         if (localX > convex.halfWidth) localX = convex.halfWidth;
+         if (localY < -convex.halfHeight) localY = -convex.halfHeight;
+         if (localY > convex.halfHeight) localY = convex.halfHeight;
+      }
+      closestX = convex.centerX + convex.axisX[0] * localX + convex.axisX[1] * localY;
+      closestY = convex.centerY + convex.axisY[0] * localX + convex.axisY[1] * localY;
+   }
+}
+
+//------------------------------------------------------
+// A circle against a point, line or box. The push moves
+// the circle.
+//------------------------------------------------------
+void CirclevConvex(float x, float y, float radius, const BatchConvex& convex, BatchResult& result)
+{
+   float closestX, closestY;
+   bool inside;
+   ClosestOnConvex(convex, x, y, closestX, closestY, inside);
+
+   float dx = x - closestX;
+   float dy = y - closestY;
+   float distanceSquared = dx * dx + dy * dy;
+   if (!inside && distanceSquared > radius * radius) {
+      result.hit = false;
+      return;
+   }
+
+   result.hit = true;
+   float distance = sqrtf(distanceSquared);
+   if (inside) {
+      // Out through the closest face, then a radius further
+      result.pushX = -dx / distance * (distance + radius);
+      result.pushY = -dy / distance * (distance + radius);
+   }
+   else if (distance > 0.0f) {
+      result.pushX = dx / distance * (radius - distance);
+      result.pushY = dy / distance * (radius - distance);
+   }
+   else if (convex.axisCount > 0) {
+      // Sitting right on a line, push along its normal
+      result.pushX = convex.axisX[0] * radius;
+      result.pushY = convex.axisY[0] * radius;
+   }
+   else {
+      result.pushX = radius;
+      result.pushY = 0.0f;
+   }
+}
+
+//------------------------------------------------------
+// A circle against a circle. The push moves the first.
+//------------------------------------------------------
+void CirclevCircle(float x, float y, float radius, const Circle* other, BatchResult& result)
+{
+   float dx = x - other->CenterX();
+   float dy = y - other->CenterY();
+   float reach = radius + other->Radius();
+   float distanceSquared = dx * dx + dy * dy;
+   result.hit = (distanceSquared <= reach * reach);
+   if (!result.hit) {
+      return;
+   }
+
+   float distance = sqrtf(distanceSquared);
+   if (distance > 0.0f) {
+      result.pushX = dx / distance * (reach - distance);
+      result.pushY = dy / distance * (reach - distance);
+   }
+   else {
+      result.pushX = reach;
+      result.pushY = 0.0f;
+   }
+}
+
+//------------------------------------------------------
+// Sorts the shapes by type, then runs a loop per type
+//------------------------------------------------------
+int CollideOneVsMany(Shape* probe, Shape* const* shapes, int count, vector<BatchResult>& results)
+{
+   results.assign(count < 0 ? 0 : count, BatchResult());
+   if (probe == 0 || count <= 0) {
+      return 0;
+   }
+
+   // Everything about the probe, worked out once
+   bool probeIsCircle = (probe->Type() == CIRCLE);
+   float probeX = 0.0f;
+   float probeY = 0.0f;
+   float probeRadius = 0.0f;
+   BatchConvex probeConvex;
+   AABB probeBounds;
+   switch (probe->Type()) {
+      case SHAPE_POINT:
+         MakeConvex(dynamic_cast<Point*>(probe), probeConvex);
+         probeBounds = ConvexBounds(probeConvex);
+         break;
+      case LINE:
+         MakeConvex(dynamic_cast<Line*>(probe), probeConvex);
+         probeBounds = ConvexBounds(probeConvex);
+         break;
+      case BOX:
+         MakeConvex(dynamic_cast<Box*>(probe), probeConvex);
+         probeBounds = ConvexBounds(probeConvex);
+         break;
+      case CIRCLE:
+      {
+         Circle* circle = dynamic_cast<Circle*>(probe);
+         probeX = circle->CenterX();
+         probeY = circle->CenterY();
+         probeRadius = circle->Radius();
+         probeBounds = AABB(probeX - probeRadius, probeY - probeRadius, probeX + probeRadius, probeY + probeRadius);
+         break;
+      }
+      default:
+         return 0;
+   }
+
+   // Bucket the shapes by type (after the filter and bounds checks)
+   FrameAllocator& scratch = ThreadFrameAllocator();
+   FrameAllocator::Marker marker = scratch.GetMarker();
+   int* buckets[NUM_SHAPES];
+   int bucketCounts[NUM_SHAPES];
+   for (int ii = 0; ii < NUM_SHAPES; ++ii) {
+      buckets[ii] = scratch.AllocateArray<int>(count);
+      bucketCounts[ii] = 0;
+   }
+   for (int ii = 0; ii < count; ++ii) {
+      Shape* shape = shapes[ii];
+      if (shape == 0 || shape == probe || shape->Type() < 0 || shape->Type() >= NUM_SHAPES || shape->Type() == CHAIN || shape->Type() == COMPOUND
+         || !ShouldCollide(probe, shape) || !probeBounds.Overlaps(ShapeBounds(shape))) {
+         continue;
+      }
+      buckets[shape->Type()][bucketCounts[shape->Type()]++] = ii;
+   }
+
+   // The types are known here, so the casts are static
+   int hits = 0;
+   BatchConvex other;
+   for (int ii = 0; ii < bucketCounts[CIRCLE]; ++ii) {
+      int index = buckets[CIRCLE][ii];
+      const Circle* circle = static_cast<const Circle*>(shapes[index]);
+      if (probeIsCircle) {
+         CirclevCircle(probeX, probeY, probeRadius, circle, results[index]);
+      }
+      else {
+         // The circle's push, turned around to move the probe
+         CirclevConvex(circle->CenterX(), circle->CenterY(), circle->Radius(), probeConvex, results[index]);
+         results[index].pushX = -results[index].pushX;
+         results[index].pushY = -results[index].pushY;
+      }
+      hits += results[index].hit;
+   }
+   for (int type = SHAPE_POINT; type < NUM_SHAPES; ++type) {
+      if (type == CIRCLE) {
+         continue;
+      }
+      for (int ii = 0; ii < bucketCounts[type]; ++ii) {
+         int index = buckets[type][ii];
+         if (type == SHAPE_POINT) MakeConvex(static_cast<const Point*>(shapes[index]), other);
+         else if (type == LINE) MakeConvex(static_cast<const Line*>(shapes[index]), other);
+         else MakeConvex(static_cast<const Box*>(shapes[index]), other);
+
+         if (probeIsCircle) {
+            CirclevConvex(probeX, probeY, probeRadius, other, results[index]);
+         }
+         else {
+            ConvexvConvex(probeConvex, other, results[index]);
+         }
+         hits += results[index].hit;
+      }
+   }
+
+   scratch.Rewind(marker);
+   return hits;
+}
+
+//------------------------------------------------------
+// Same thing, for a vector of shapes
+//------------------------------------------------------
+int CollideOneVsMany(Shape* probe, const vector<Shape*>& shapes, vector<BatchResult>& results)
+{
+   return CollideOneVsMany(probe, (shapes.empty() ? 0 : &shapes[0]), (int)shapes.size(), results);
+}
@@ -0,0 +1,41 @@
+#ifndef BATCHCOLLISIONS_H_
+#define BATCHCOLLISIONS_H_
+
+#include "Collisions.h"
+
+   //------------------------------------------------------
+   // What happened to one shape in a batch
+   //------------------------------------------------------
+   struct BatchResult
+   {
+      bool hit;
+      // How far the probe has to move to get out of the shape
+      // (zero if it didn't hit, or if they only touch)
+      float pushX;
+      float pushY;
+
+      BatchResult() : hit(false), pushX(0.0f), pushY(0.0f) {}
+   };
+
+   /*
+     Tests one shape (the probe) against lots of shapes, like
+     a player against everything near it. Nothing is moved,
+     every result says whether that shape was hit, and the
+     push that would move the probe out of it.
+
+     The probe's corners, axes and bounds are worked out once,
+     the shapes are sorted by type, and each type gets its
+     own loop. Pairs the collision filters reject, and shapes
+     whose bounds miss the probe's, are never tested.
+     Chains and compounds aren't convex, so they're left out
+     too (they always come back as misses, and can't be the
+     probe).
+
+     results ends up the same size as the shapes.
+     Returns how many shapes were hit.
+   */
+   int CollideOneVsMany(Shape* probe, Shape* const* shapes, int count, vector<BatchResult>& results);
+
+   int CollideOneVsMany(Shape* probe, const vector<Shape*>& shapes, vector<BatchResult>& results);
+
+#endif // BATCHCOLLISIONS_H_
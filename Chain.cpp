@@ -0,0 +1,518 @@
+#include "Chain.h"
+
+// For FLT_EPSILON
+#include <cfloat>
+// For sqrtf
+#include <cmath>
+
+// How many edges a leaf can hold
+const int chainLeafSize = 4;
+
+// How far (as the sine of the angle) a vertex has to bend before it counts as a corner
+const float turnTolerance = 0.001f;
+
+//------------------------------------------------------
+// Gets the bounds of the segment a -> b
+//------------------------------------------------------
+AABB EdgeBounds(float ax, float ay, float bx, float by)
+{
+   return AABB(ax < bx ? ax : bx, ay < by ? ay : by, ax < bx ? bx : ax, ay < by ? by : ay);
+}
+
+//------------------------------------------------------
+// Moves any kind of shape (Move isn't virtual)
+//------------------------------------------------------
+void MoveShape(Shape* shape, float x, float y)
+{
+   switch (shape->Type()) {
+      case SHAPE_POINT: static_cast<Point*>(shape)->Move(x, y); break;
+      case LINE: static_cast<Line*>(shape)->Move(x, y); break;
+      case CIRCLE: static_cast<Circle*>(shape)->Move(x, y); break;
+      case BOX: static_cast<Box*>(shape)->Move(x, y); break;
+      case CHAIN: static_cast<Chain*>(shape)->Move(x, y); break;
+      default: break;
+   }
+}
+
+//------------------------------------------------------
+// Constructors
+//------------------------------------------------------
+Chain::Chain() : loop(false), cacheVersion(~0u)
+{
+   this->shapeType = CHAIN;
+}
+
+Chain::Chain(const float* xs, const float* ys, int count, bool loop)
+   : vertexX(xs, xs + count), vertexY(ys, ys + count), loop(loop), cacheVersion(~0u)
+{
+   this->shapeType = CHAIN;
+}
+
+Chain::Chain(const vector<Point>& points, bool loop) : loop(loop), cacheVersion(~0u)
+{
+   this->shapeType = CHAIN;
+   vertexX.reserve(points.size());
+   vertexY.reserve(points.size());
+   for (unsigned int ii = 0; ii < points.size(); ++ii) {
+      vertexX.push_back(points[ii].X());
+      vertexY.push_back(points[ii].Y());
+   }
+}
+
+//------------------------------------------------------
+// Copy Constructor. The version comes along too, so
+// whatever the other chain has worked out is still good.
+//------------------------------------------------------
+Chain::Chain(const Chain& rhs)
+   : Shape(rhs), vertexX(rhs.vertexX), vertexY(rhs.vertexY), loop(rhs.loop),
+     normalX(rhs.normalX), normalY(rhs.normalY), turns(rhs.turns), nodes(rhs.nodes),
+     cacheVersion(rhs.cacheVersion)
+{
+}
+
+//------------------------------------------------------
+// Assignment Operator. The version moves on, so the
+// cache only carries over if it was current.
+//------------------------------------------------------
+Chain& Chain::operator=(const Chain& rhs)
+{
+   if (this != &rhs) {
+      bool current = (rhs.cacheVersion == rhs.version);
+      Shape::operator=(rhs);
+      vertexX = rhs.vertexX;
+      vertexY = rhs.vertexY;
+      loop = rhs.loop;
+      normalX = rhs.normalX;
+      normalY = rhs.normalY;
+      turns = rhs.turns;
+      nodes = rhs.nodes;
+      cacheVersion = (current ? version : ~0u);
+   }
+   return *this;
+}
+
+//------------------------------------------------------
+// A loop needs at least 3 vertices to close
+//------------------------------------------------------
+int Chain::EdgeCount() const
+{
+   int count = VertexCount();
+   if (count < 2) {
+      return 0;
+   }
+   return (loop && count > 2 ? count : count - 1);
+}
+
+//------------------------------------------------------
+// Gets one edge as a line, normal and all
+//------------------------------------------------------
+Line Chain::Edge(int edge) const
+{
+   Line line(vertexX[EdgeStart(edge)], vertexY[EdgeStart(edge)], vertexX[EdgeEnd(edge)], vertexY[EdgeEnd(edge)]);
+   line.Filter(filter);
+   return line;
+}
+
+//------------------------------------------------------
+// Half the bounds' diagonal
+//------------------------------------------------------
+float Chain::BoundingRadius() const
+{
+   AABB bounds = Bounds();
+   float width = bounds.maxX - bounds.minX;
+   float height = bounds.maxY - bounds.minY;
+   return sqrtf(width * width + height * height) * 0.5f;
+}
+
+//------------------------------------------------------
+// Works out the edge normals, which way every vertex
+// turns, and the tree
+//------------------------------------------------------
+void Chain::UpdateCache() const
+{
+   int vertexCount = VertexCount();
+   int edgeCount = EdgeCount();
+
+   normalX.resize(edgeCount);
+   normalY.resize(edgeCount);
+   for (int ii = 0; ii < edgeCount; ++ii) {
+      float dx = vertexX[EdgeEnd(ii)] - vertexX[ii];
+      float dy = vertexY[EdgeEnd(ii)] - vertexY[ii];
+      float length = sqrtf(dx * dx + dy * dy);
+      if (length > FLT_EPSILON) {
+         dx /= length;
+         dy /= length;
+      }
+      normalX[ii] = dy;
+      normalY[ii] = -dx;
+   }
+
+   // A vertex between two edges turns by the cross product of
+   // their normals (same as of their directions). One that
+   // folds straight back on itself sticks out both ways, so
+   // it's treated like an end.
+   turns.assign(vertexCount, (signed char)TURN_END);
+   for (int ii = 0; ii < vertexCount && edgeCount > 0; ++ii) {
+      int before = (ii > 0 ? ii - 1 : (edgeCount == vertexCount ? edgeCount - 1 : -1));
+      int after = (ii < edgeCount ? ii : -1);
+      if (before < 0 || after < 0) {
+         continue;
+      }
+
+      float cross = normalX[before] * normalY[after] - normalY[before] * normalX[after];
+      float dot = normalX[before] * normalX[after] + normalY[before] * normalY[after];
+      if (cross > turnTolerance) {
+         turns[ii] = (signed char)TURN_LEFT;
+      }
+      else if (cross < -turnTolerance) {
+         turns[ii] = (signed char)TURN_RIGHT;
+      }
+      else if (dot > 0.0f) {
+         turns[ii] = (signed char)TURN_NONE;
+      }
+   }
+
+   nodes.clear();
+   if (edgeCount > 0) {
+      nodes.reserve(edgeCount * 2 / chainLeafSize + 1);
+      BuildNode(0, edgeCount);
+   }
+   cacheVersion = version;
+}
+
+//------------------------------------------------------
+// Builds the node for a run of edges (and all of its
+// children). Neighbouring edges are already near each
+// other, so the run is just cut in half. Returns the
+// node's index.
+//------------------------------------------------------
+int Chain::BuildNode(int firstEdge, int edgeCount) const
+{
+   int nodeIndex = (int)nodes.size();
+   nodes.push_back(ChainNode());
+
+   AABB bounds = EdgeBounds(vertexX[firstEdge], vertexY[firstEdge], vertexX[EdgeEnd(firstEdge)], vertexY[EdgeEnd(firstEdge)]);
+   for (int ii = firstEdge + 1; ii < firstEdge + edgeCount; ++ii) {
+      AABB current = EdgeBounds(vertexX[ii], vertexY[ii], vertexX[EdgeEnd(ii)], vertexY[EdgeEnd(ii)]);
+      if (current.minX < bounds.minX) bounds.minX = current.minX;
+      if (current.minY < bounds.minY) bounds.minY = current.minY;
+      if (current.maxX > bounds.maxX) bounds.maxX = current.maxX;
+      if (current.maxY > bounds.maxY) bounds.maxY = current.maxY;
+   }
+   nodes[nodeIndex].bounds = bounds;
+   nodes[nodeIndex].firstEdge = firstEdge;
+   nodes[nodeIndex].edgeCount = edgeCount;
+   nodes[nodeIndex].right = -1;
+
+   if (edgeCount > chainLeafSize) {
+      // Left child is always the next node
+      int half = edgeCount / 2;
+      BuildNode(firstEdge, half);
+      int right = BuildNode(firstEdge + half, edgeCount - half);
+      nodes[nodeIndex].right = right;
+   }
+   return nodeIndex;
+}
+
+//------------------------------------------------------
+// Moves every vertex. If the tree was up to date, it's
+// shifted along too instead of being thrown away.
+//------------------------------------------------------
+void Chain::Move(float x, float y)
+{
+   bool current = (cacheVersion == version);
+   for (unsigned int ii = 0; ii < vertexX.size(); ++ii) {
+      vertexX[ii] += x;
+      vertexY[ii] += y;
+   }
+   Changed();
+
+   if (current) {
+      for (unsigned int ii = 0; ii < nodes.size(); ++ii) {
+         nodes[ii].bounds.minX += x;
+         nodes[ii].bounds.minY += y;
+         nodes[ii].bounds.maxX += x;
+         nodes[ii].bounds.maxY += y;
+      }
+      cacheVersion = version;
+   }
+}
+
+//------------------------------------------------------
+// Finds every edge whose bounds touch the area
+//------------------------------------------------------
+void Chain::Query(const AABB& area, vector<int>& edges) const
+{
+   Refresh();
+   if (nodes.size() == 0) {
+      return;
+   }
+
+   int stack[64];
+   int stackSize = 0;
+   stack[stackSize++] = 0;
+
+   while (stackSize > 0) {
+      int nodeIndex = stack[--stackSize];
+      const ChainNode& node = nodes[nodeIndex];
+      if (!node.bounds.Overlaps(area)) {
+         continue;
+      }
+
+      if (node.right < 0) {
+         for (int ii = node.firstEdge; ii < node.firstEdge + node.edgeCount; ++ii) {
+            if (EdgeBounds(vertexX[ii], vertexY[ii], vertexX[EdgeEnd(ii)], vertexY[EdgeEnd(ii)]).Overlaps(area)) {
+               edges.push_back(ii);
+            }
+         }
+      }
+      else {
+         stack[stackSize++] = node.right;
+         stack[stackSize++] = nodeIndex + 1;
+      }
+   }
+}
+
+//------------------------------------------------------
+// Does the corner at a vertex stick out towards a shape
+// on that side of the edges? (side is 1 for the normal's
+// side, -1 for the other)
+//------------------------------------------------------
+bool CornerFaces(Chain::TURN turn, float side)
+{
+   if (turn == Chain::TURN_END) {
+      return true;
+   }
+   return (float)turn * side > 0.0f;
+}
+
+//------------------------------------------------------
+// How far a circle (or a point, with no radius) has to
+// move to get off one edge
+//------------------------------------------------------
+bool RoundEdgePush(float x, float y, float radius, const Chain& chain, int edge, float& pushX, float& pushY)
+{
+   int start = chain.EdgeStart(edge);
+   int end = chain.EdgeEnd(edge);
+   float ax = chain.VertexX(start);
+   float ay = chain.VertexY(start);
+   float ex = chain.VertexX(end) - ax;
+   float ey = chain.VertexY(end) - ay;
+   float lengthSquared = ex * ex + ey * ey;
+   float t = (lengthSquared > FLT_EPSILON ? ((x - ax) * ex + (y - ay) * ey) / lengthSquared : 0.0f);
+   float clamped = (t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t));
+
+   float dx = x - (ax + ex * clamped);
+   float dy = y - (ay + ey * clamped);
+   float distanceSquared = dx * dx + dy * dy;
+   float reach = (radius > FLT_EPSILON ? radius : FLT_EPSILON);
+   if (distanceSquared > reach * reach) {
+      return false;
+   }
+
+   float normalX, normalY;
+   chain.Normal(edge, normalX, normalY);
+   float offset = (x - ax) * normalX + (y - ay) * normalY;
+   float side = (offset >= 0.0f ? 1.0f : -1.0f);
+
+   if (t >= 0.0f && t <= 1.0f) {
+      // Straight out from the face
+      float depth = radius - offset * side;
+      if (depth < 0.0f) depth = 0.0f;
+      pushX = normalX * side * depth;
+      pushY = normalY * side * depth;
+      return true;
+   }
+
+   // Past an end, so it's touching the vertex. Only the edge
+   // leaving a vertex handles it, so corners aren't pushed twice.
+   int vertex = (t < 0.0f ? start : end);
+   bool leaving = (t < 0.0f || chain.Turn(vertex) == Chain::TURN_END);
+   if (!leaving || !CornerFaces(chain.Turn(vertex), side)) {
+      return false;
+   }
+
+   float distance = sqrtf(distanceSquared);
+   float depth = (distance < radius ? radius - distance : 0.0f);
+   if (distance > FLT_EPSILON) {
+      pushX = dx / distance * depth;
+      pushY = dy / distance * depth;
+   }
+   else {
+      pushX = normalX * side * depth;
+      pushY = normalY * side * depth;
+   }
+   return true;
+}
+
+//------------------------------------------------------
+// How far a line or box has to move to get off one edge.
+// SAT on the edge's normal and the shape's normals. If
+// the smallest push runs off the end of the edge past a
+// vertex that doesn't stick out towards the shape, that
+// push is a snag, so it goes out along the normal instead.
+//------------------------------------------------------
+bool FlatEdgePush(Shape* shape, const Chain& chain, int edge, float& pushX, float& pushY)
+{
+   Point corners[4];
+   float axisX[3];
+   float axisY[3];
+   int cornerCount = 0;
+   int axisCount = 1;
+   float centerX, centerY;
+
+   if (shape->Type() == LINE) {
+      Line* line = static_cast<Line*>(shape);
+      corners[cornerCount++] = line->Start();
+      corners[cornerCount++] = line->End();
+      line->Normal(0, axisX[axisCount], axisY[axisCount]);
+      ++axisCount;
+      centerX = (line->StartX() + line->EndX()) * 0.5f;
+      centerY = (line->StartY() + line->EndY()) * 0.5f;
+   }
+   else {
+      Box* box = static_cast<Box*>(shape);
+      for (int ii = 0; ii < Box::MAX_DIAGONALS; ++ii) {
+         corners[cornerCount++] = box->Corner((Box::DIAGONAL)ii);
+      }
+      for (int ii = 0; ii < box->NormalCount(); ++ii) {
+         box->Normal(ii, axisX[axisCount], axisY[axisCount]);
+         ++axisCount;
+      }
+      centerX = box->Center().X();
+      centerY = box->Center().Y();
+   }
+
+   int start = chain.EdgeStart(edge);
+   int end = chain.EdgeEnd(edge);
+   float ax = chain.VertexX(start);
+   float ay = chain.VertexY(start);
+   float bx = chain.VertexX(end);
+   float by = chain.VertexY(end);
+   chain.Normal(edge, axisX[0], axisY[0]);
+
+   float best = FLT_MAX;
+   float bestX = 0.0f;
+   float bestY = 0.0f;
+   for (int ii = 0; ii < axisCount; ++ii) {
+      float shapeMin = FLT_MAX;
+      float shapeMax = -FLT_MAX;
+      for (int jj = 0; jj < cornerCount; ++jj) {
+         float projection = corners[jj].X() * axisX[ii] + corners[jj].Y() * axisY[ii];
+         if (projection < shapeMin) shapeMin = projection;
+         if (projection > shapeMax) shapeMax = projection;
+      }
+      float projectionA = ax * axisX[ii] + ay * axisY[ii];
+      float projectionB = bx * axisX[ii] + by * axisY[ii];
+      float edgeMin = (projectionA < projectionB ? projectionA : projectionB);
+      float edgeMax = (projectionA < projectionB ? projectionB : projectionA);
+
+      float pushBack = shapeMax - edgeMin;
+      float pushOn = edgeMax - shapeMin;
+      if (pushBack < 0.0f || pushOn < 0.0f) {
+         return false;
+      }
+      float overlap = (pushBack < pushOn ? pushBack : pushOn);
+      if (overlap < best) {
+         best = overlap;
+         float sign = (pushBack < pushOn ? -1.0f : 1.0f);
+         bestX = axisX[ii] * overlap * sign;
+         bestY = axisY[ii] * overlap * sign;
+      }
+   }
+
+   // Which way along the edge the push goes, and the vertex it goes past
+   float along = bestX * (bx - ax) + bestY * (by - ay);
+   float side = ((centerX - ax) * axisX[0] + (centerY - ay) * axisY[0] >= 0.0f ? 1.0f : -1.0f);
+   if (absValue(along) > FLT_EPSILON && !CornerFaces(chain.Turn(along < 0.0f ? start : end), side)) {
+      // Out along the normal, on the shape's side
+      float deepest = FLT_MAX;
+      for (int jj = 0; jj < cornerCount; ++jj) {
+         float projection = ((corners[jj].X() - ax) * axisX[0] + (corners[jj].Y() - ay) * axisY[0]) * side;
+         if (projection < deepest) deepest = projection;
+      }
+      float across = -deepest * side;
+      bestX = axisX[0] * across;
+      bestY = axisY[0] * across;
+   }
+
+   pushX = bestX;
+   pushY = bestY;
+   return true;
+}
+
+//------------------------------------------------------
+// Collides a shape against every edge near it, one at a
+// time. Walks the tree itself, so nothing is allocated.
+//------------------------------------------------------
+bool HandleShapevChain(Shape* shape, Chain* chain, float pushPercent)
+{
+   if (shape == 0 || chain == 0 || shape->Type() == CHAIN || chain->NodeCount() == 0) {
+      return false;
+   }
+
+   AABB area = ShapeBounds(shape);
+   int stack[64];
+   int stackSize = 0;
+   stack[stackSize++] = 0;
+
+   bool collided = false;
+   while (stackSize > 0) {
+      int nodeIndex = stack[--stackSize];
+      const ChainNode& node = chain->Node(nodeIndex);
+      if (!node.bounds.Overlaps(area)) {
+         continue;
+      }
+
+      if (node.right >= 0) {
+         stack[stackSize++] = node.right;
+         stack[stackSize++] = nodeIndex + 1;
+         continue;
+      }
+
+      for (int ii = node.firstEdge; ii < node.firstEdge + node.edgeCount; ++ii) {
+         int end = chain->EdgeEnd(ii);
+         if (!EdgeBounds(chain->VertexX(ii), chain->VertexY(ii), chain->VertexX(end), chain->VertexY(end)).Overlaps(area)) {
+            continue;
+         }
+
+         float pushX = 0.0f;
+         float pushY = 0.0f;
+         bool hit = false;
+         switch (shape->Type()) {
+            case SHAPE_POINT:
+            {
+               Point* point = static_cast<Point*>(shape);
+               hit = RoundEdgePush(point->X(), point->Y(), 0.0f, *chain, ii, pushX, pushY);
+               break;
+            }
+            case CIRCLE:
+            {
+               Circle* circle = static_cast<Circle*>(shape);
+               hit = RoundEdgePush(circle->CenterX(), circle->CenterY(), circle->Radius(), *chain, ii, pushX, pushY);
+               break;
+            }
+            case LINE:
+            case BOX:
+               hit = FlatEdgePush(shape, *chain, ii, pushX, pushY);
+               break;
+            default:
+               break;
+         }
+         if (!hit) {
+            continue;
+         }
+
+         collided = true;
+         if (pushPercent < 0.0f) {
+            return true;
+         }
+
+         // Later edges see where this push left things
+         MoveShape(shape, pushX * pushPercent, pushY * pushPercent);
+         chain->Move(-pushX * (1.0f - pushPercent), -pushY * (1.0f - pushPercent));
+         area = ShapeBounds(shape);
+      }
+   }
+   return collided;
+}
@@ -0,0 +1,128 @@
+#ifndef CHAIN_H_
+#define CHAIN_H_
+
+#include "Collisions.h"
+
+   //------------------------------------------------------
+   // A node in a chain's tree. Edges in a chain run end to
+   // end, so each node just covers a run of them. The left
+   // child is always right after its parent.
+   //------------------------------------------------------
+   struct ChainNode
+   {
+      AABB bounds;
+      int firstEdge;
+      int edgeCount;
+      // Inner: the right child. Leaf: -1
+      int right;
+   };
+
+   //------------------------------------------------------
+   // A run of wall segments joined end to end, sharing
+   // their vertices. Edge ii goes from vertex ii to vertex
+   // ii + 1 (a loop's last edge goes back to vertex 0).
+   //
+   // The whole outline is one shape, so it's one proxy in
+   // the broadphase. The narrowphase walks the chain's own
+   // tree to the few edges near the other shape, and knows
+   // which way each vertex bends, so a shape sliding along
+   // a flat run of edges doesn't catch on the joins between
+   // them.
+   //
+   // Edge normals point to the right of the edge's
+   // direction, like Line's. Chains don't collide with
+   // other chains.
+   //------------------------------------------------------
+   class Chain : public Shape
+   {
+   public:
+      // How a vertex bends, seen walking along the chain
+      enum TURN {
+         TURN_RIGHT = -1,
+         TURN_NONE = 0,
+         TURN_LEFT = 1,
+         // The first or last vertex of a chain that isn't a loop
+         TURN_END = 2
+      };
+
+   private:
+      vector<float> vertexX;
+      vector<float> vertexY;
+      bool loop;
+
+      // Worked out the first time they're asked for after a change
+      mutable vector<float> normalX;
+      mutable vector<float> normalY;
+      mutable vector<signed char> turns;
+      mutable vector<ChainNode> nodes;
+      mutable unsigned int cacheVersion;
+
+      void Refresh() const { if (cacheVersion != version) UpdateCache(); }
+      void UpdateCache() const;
+      int BuildNode(int firstEdge, int edgeCount) const;
+
+   public:
+      Chain();
+      Chain(const float* xs, const float* ys, int count, bool loop = false);
+      Chain(const vector<Point>& points, bool loop = false);
+
+      // Copy Constructor
+      Chain(const Chain& rhs);
+
+      // Assignment Operator
+      Chain& operator=(const Chain& rhs);
+
+      // Accessors
+      bool Loop() const { return loop; }
+      int VertexCount() const { return (int)vertexX.size(); }
+      int EdgeCount() const;
+      float VertexX(int index) const { return vertexX[index]; }
+      float VertexY(int index) const { return vertexY[index]; }
+      Point Vertex(int index) const { return Point(vertexX[index], vertexY[index]); }
+      // The vertex an edge starts and ends at
+      int EdgeStart(int edge) const { return edge; }
+      int EdgeEnd(int edge) const { return (edge + 1 == VertexCount() ? 0 : edge + 1); }
+      Line Edge(int edge) const;
+      TURN Turn(int vertex) const { Refresh(); return (TURN)turns[vertex]; }
+      inline int NormalCount() const { return EdgeCount(); }
+      void Normal(int normalIndex, float& x, float& y) const { Refresh(); x = normalX[normalIndex]; y = normalY[normalIndex]; }
+      AABB Bounds() const { Refresh(); return nodes.size() > 0 ? nodes[0].bounds : AABB(); }
+      // Half the bounds' diagonal, around the bounds' middle
+      float BoundingRadius() const;
+      int NodeCount() const { Refresh(); return (int)nodes.size(); }
+      const ChainNode& Node(int index) const { Refresh(); return nodes[index]; }
+
+      // Mutators
+      void Vertex(int index, float x, float y) { vertexX[index] = x; vertexY[index] = y; Changed(); }
+      void AddVertex(float x, float y) { vertexX.push_back(x); vertexY.push_back(y); Changed(); }
+      void Loop(bool loop) { this->loop = loop; Changed(); }
+      void Clear() { vertexX.clear(); vertexY.clear(); Changed(); }
+      // Moving doesn't change the shape, so the tree is moved rather than rebuilt
+      void Move(float x, float y);
+
+      // Finds every edge whose bounds touch the area
+      void Query(const AABB& area, vector<int>& edges) const;
+   };
+
+   /*
+     Collides a shape against a chain's edges. Like the
+     other handlers, the shape moves pushPercent of the way
+     out and the chain the rest (or nobody moves, for a
+     negative percent). Only edges near the shape are looked
+     at, and each one is resolved in turn.
+
+     A shape touching an edge right at one of its ends only
+     gets pushed off that vertex if the chain bends away
+     from the shape there. Where the chain runs straight on,
+     or bends round towards the shape, the edge next door
+     already pushes it out along its normal, so the vertex
+     is left alone. That's what stops shapes snagging on
+     joins.
+   */
+   bool HandleShapevChain(Shape* shape, Chain* chain, float pushPercent);
+
+   inline bool HandleChainvShape(Chain* chain, Shape* shape, float pushPercent) {
+      return HandleShapevChain(shape, chain, pushPercent < 0.0f ? pushPercent : 1.0f - pushPercent);
+   }
+
+#endif // CHAIN_H_
@@ -1,8 +1,9 @@
 #include "CollisionStruct.h"
+#include "DeterministicTrig.h"
 
 // For FLT_EPSILON
 #include <cfloat>
-// For sqrtf, and pi
+// For sqrtf, fabsf, and pi
 #include <cmath>
 
 const float pi = 3.14159265358f;
@@ -11,6 +12,17 @@ bool FloatEquals(const float a, const float b) {
    return (a >= b - FLT_EPSILON && a <= b + FLT_EPSILON);
 }
 
+//------------------------------------------------------
+// Determines if two collision filters allow a collision.
+// A shared group overrides the category/mask bits.
+//------------------------------------------------------
+bool ShouldCollide(const CollisionFilter& a, const CollisionFilter& b) {
+   if (a.groupIndex == b.groupIndex && a.groupIndex != 0) {
+      return a.groupIndex > 0;
+   }
+   return (a.maskBits & b.categoryBits) != 0 && (b.maskBits & a.categoryBits) != 0;
+}
+
 //------------------------------------------------------
 // Point Constructor - has defaults of 5.0f, 5.0f
 //------------------------------------------------------
@@ -36,8 +48,7 @@ Point::Point(int x, int y) {
 //------------------------------------------------------
 // Copy Constructor for a Point
 //------------------------------------------------------
-Point::Point(const Point& rhs) {
-   this->shapeType = rhs.shapeType;
+Point::Point(const Point& rhs) : Shape(rhs) {
    this->x = rhs.x;
    this->y = rhs.y;
    this->dirty = rhs.dirty;
@@ -50,10 +61,12 @@ Point::Point(const Point& rhs) {
 Point& Point::operator=(const Point& rhs) {
    if (this != &rhs) {
       this->shapeType = rhs.shapeType;
+      this->filter = rhs.filter;
       this->x = rhs.x;
       this->y = rhs.y;
       this->dirty = rhs.dirty;
       this->length = rhs.length;
+      Changed();
    }
    return *this;
 }
@@ -203,6 +216,7 @@ Line::Line(float startX, float startY, float endX, float endY) {
    this->start.Y(startY);
    this->end.X(endX);
    this->end.Y(endY);
+   this->cacheVersion = ~0u;
 }
 
 //------------------------------------------------------
@@ -215,6 +229,7 @@ Line::Line(int startX, int startY, int endX, int endY) {
    this->start.YInt(startY);
    this->end.XInt(endX);
    this->end.YInt(endY);
+   this->cacheVersion = ~0u;
 }
 
 //------------------------------------------------------
@@ -224,29 +239,35 @@ Line::Line(Point start, Point end) {
    this->shapeType = LINE;
    this->start = start;
    this->end = end;
+   this->cacheVersion = ~0u;
 }
 
 //------------------------------------------------------
-// Copy Constructor for a Line
+// Copy Constructor for a Line. Same version, so the
+// cache comes along too.
 //------------------------------------------------------
-Line::Line(const Line& rhs) {
-   this->shapeType = LINE;
-   this->start.X(rhs.start.X());
-   this->start.Y(rhs.start.Y());
-   this->end.X(rhs.end.X());
-   this->end.Y(rhs.end.Y());
+Line::Line(const Line& rhs)
+   : Shape(rhs), start(rhs.start), end(rhs.end), bounds(rhs.bounds), boundingRadius(rhs.boundingRadius),
+     direction(rhs.direction), normalX(rhs.normalX), normalY(rhs.normalY), cacheVersion(rhs.cacheVersion)
+{
 }
 
 //------------------------------------------------------
-// Assignment Operator for a Line
+// Assignment Operator for a Line. The version moves on,
+// so the cache only carries over if it was current.
 //------------------------------------------------------
 Line& Line::operator=(const Line& rhs) {
    if (this != &rhs) {
-      this->shapeType = LINE;
-      this->start.X(rhs.start.X());
-      this->start.Y(rhs.start.Y());
-      this->end.X(rhs.end.X());
-      this->end.Y(rhs.end.Y());
+      bool current = (rhs.cacheVersion == rhs.version);
+      Shape::operator=(rhs);
+      this->start = rhs.start;
+      this->end = rhs.end;
+      this->bounds = rhs.bounds;
+      this->boundingRadius = rhs.boundingRadius;
+      this->direction = rhs.direction;
+      this->normalX = rhs.normalX;
+      this->normalY = rhs.normalY;
+      this->cacheVersion = (current ? version : ~0u);
    }
    return *this;
 }
@@ -260,6 +281,26 @@ void Line::Move(float x, float y)
    this->end.X(this->end.X() + x);
    this->start.Y(this->start.Y() + y);
    this->end.Y(this->end.Y() + y);
+   Changed();
+}
+
+//------------------------------------------------------
+// Works out the line's bounds, bounding radius, and
+// normals for this version of the line
+//------------------------------------------------------
+void Line::UpdateCache() const
+{
+   bounds.minX = (start.X() < end.X() ? start.X() : end.X());
+   bounds.maxX = (start.X() < end.X() ? end.X() : start.X());
+   bounds.minY = (start.Y() < end.Y() ? start.Y() : end.Y());
+   bounds.maxY = (start.Y() < end.Y() ? end.Y() : start.Y());
+
+   direction = this->end - this->start;
+   boundingRadius = direction.Length() * 0.5f;
+   direction.Normalize();
+   normalX = direction.Y();
+   normalY = -direction.X();
+   cacheVersion = version;
 }
 
 //------------------------------------------------------
@@ -271,10 +312,9 @@ void Line::Normal(int normalIndex, float& x, float& y) const
       x = y = 0.0f;
       return;
    }
-   Point normal = this->end - this->start;
-   normal.Normalize();
-   x = normal.Y();
-   y = -normal.X();
+   Refresh();
+   x = normalX;
+   y = normalY;
 }
 
 //------------------------------------------------------
@@ -282,9 +322,8 @@ void Line::Normal(int normalIndex, float& x, float& y) const
 //------------------------------------------------------
 Point Line::LineNormal() const
 {
-   Point normal = this->end - this->start;
-   normal.Normalize();
-   return normal;
+   Refresh();
+   return direction;
 }
 
 //------------------------------------------------------
@@ -296,6 +335,7 @@ Circle::Circle(float x, float y, float radius) {
    this->shapeType = CIRCLE;
    this->center = Point(x, y);
    this->radius = radius;
+   this->cacheVersion = ~0u;
 }
 
 //------------------------------------------------------
@@ -306,25 +346,30 @@ Circle::Circle(Point center, float radius) {
    this->shapeType = CIRCLE;
    this->center = center;
    this->radius = radius;
+   this->cacheVersion = ~0u;
 }
 
 //------------------------------------------------------
-// Copy Constructor for a Circle
+// Copy Constructor for a Circle. Same version, so the
+// cache comes along too.
 //------------------------------------------------------
-Circle::Circle(const Circle& rhs) {
-   this->shapeType = CIRCLE;
-   this->center = rhs.center;
-   this->radius = rhs.radius;
+Circle::Circle(const Circle& rhs)
+   : Shape(rhs), center(rhs.center), radius(rhs.radius), bounds(rhs.bounds), cacheVersion(rhs.cacheVersion)
+{
 }
 
 //------------------------------------------------------
-// Assignment Operator for a Circle
+// Assignment Operator for a Circle. The version moves
+// on, so the cache only carries over if it was current.
 //------------------------------------------------------
 Circle& Circle::operator=(const Circle& rhs) {
    if (this != &rhs) {
-      this->shapeType = CIRCLE;
+      bool current = (rhs.cacheVersion == rhs.version);
+      Shape::operator=(rhs);
       this->center = rhs.center;
       this->radius = rhs.radius;
+      this->bounds = rhs.bounds;
+      this->cacheVersion = (current ? version : ~0u);
    }
    return *this;
 }
@@ -337,6 +382,7 @@ Box::Box(Point topLeft, Point bottomRight)
    // Set up the easy stuff
    this->shapeType = BOX;
    this->rotation = 0.0f;
+   this->cacheVersion = ~0u;
    this->width = bottomRight.X() - topLeft.X();
    this->height = bottomRight.Y() - topLeft.Y();
    this->center = Point(topLeft.X() + (width * 0.5f), topLeft.Y() + (height * 0.5f));
@@ -354,6 +400,7 @@ Box::Box(Point center, float width, float height, float rotation)
    this->width = width;
    this->height = height;
    this->rotation = rotation;
+   this->cacheVersion = ~0u;
    CalculateDiagonals();
 }
 
@@ -364,9 +411,32 @@ Box::Box(float topLeftX, float topLeftY, float width, float height, float rotati
    this->width = width;
    this->height = height;
    this->rotation = rotation;
+   this->cacheVersion = ~0u;
    CalculateDiagonals();
 }
 
+//------------------------------------------------------
+// Box Constructor that takes everything CalculateDiagonals
+// would work out, so loading lots of boxes skips the trig
+//------------------------------------------------------
+Box::Box(Point center, float width, float height, float rotation, float diagonalLength,
+   Point topLeftDiagonal, Point topRightDiagonal, Point normalX, Point normalY)
+{
+   this->shapeType = BOX;
+   this->center = center;
+   this->width = width;
+   this->height = height;
+   this->rotation = rotation;
+   this->diagonalLength = diagonalLength;
+   diagonalVectors[TOPLEFT] = topLeftDiagonal;
+   diagonalVectors[TOPRIGHT] = topRightDiagonal;
+   diagonalVectors[BOTTOMLEFT] = topRightDiagonal * -1.0f;
+   diagonalVectors[BOTTOMRIGHT] = topLeftDiagonal * -1.0f;
+   faceNormals[0] = normalX;
+   faceNormals[1] = normalY;
+   this->cacheVersion = ~0u;
+}
+
 //------------------------------------------------------
 // Gets the specified corner of the box
 //------------------------------------------------------
@@ -420,25 +490,32 @@ void Box::CalculateDiagonals()
 
    if(this->rotation != 0.0f) {
       // Rotation must be applied
+#ifdef COLLISIONS_DETERMINISTIC
+      float sine = DeterministicSin(rotation);
+      float cosine = DeterministicCos(rotation);
+#else
       float radians = CalculateRadians(rotation);
-      float newX = diagonalVectors[TOPLEFT].X() * cos(radians) - diagonalVectors[TOPLEFT].Y() * sin(radians);
-      float newY = diagonalVectors[TOPLEFT].X() * sin(radians) + diagonalVectors[TOPLEFT].Y() * cos(radians);
+      float sine = sin(radians);
+      float cosine = cos(radians);
+#endif
+      float newX = diagonalVectors[TOPLEFT].X() * cosine - diagonalVectors[TOPLEFT].Y() * sine;
+      float newY = diagonalVectors[TOPLEFT].X() * sine + diagonalVectors[TOPLEFT].Y() * cosine;
       diagonalVectors[TOPLEFT] = Point(newX, newY);
       diagonalVectors[TOPLEFT].Normalize();
 
-      newX = diagonalVectors[TOPRIGHT].X() * cos(radians) - diagonalVectors[TOPRIGHT].Y() * sin(radians);
-      newY = diagonalVectors[TOPRIGHT].X() * sin(radians) + diagonalVectors[TOPRIGHT].Y() * cos(radians);
+      newX = diagonalVectors[TOPRIGHT].X() * cosine - diagonalVectors[TOPRIGHT].Y() * sine;
+      newY = diagonalVectors[TOPRIGHT].X() * sine + diagonalVectors[TOPRIGHT].Y() * cosine;
       diagonalVectors[TOPRIGHT] = Point(newX, newY);
       diagonalVectors[TOPRIGHT].Normalize();
 
       // Rotate the face normals too
-      newX = faceNormals[0].X() * cos(radians) - faceNormals[0].Y() * sin(radians);
-      newY = faceNormals[0].X() * sin(radians) + faceNormals[0].Y() * cos(radians);
+      newX = faceNormals[0].X() * cosine - faceNormals[0].Y() * sine;
+      newY = faceNormals[0].X() * sine + faceNormals[0].Y() * cosine;
       faceNormals[0] = Point(newX, newY);
       faceNormals[0].Normalize();
 
-      newX = faceNormals[1].X() * cos(radians) - faceNormals[1].Y() * sin(radians);
-      newY = faceNormals[1].X() * sin(radians) + faceNormals[1].Y() * cos(radians);
+      newX = faceNormals[1].X() * cosine - faceNormals[1].Y() * sine;
+      newY = faceNormals[1].X() * sine + faceNormals[1].Y() * cosine;
       faceNormals[1] = Point(newX, newY);
       faceNormals[1].Normalize();
    }
@@ -447,6 +524,29 @@ void Box::CalculateDiagonals()
    diagonalVectors[BOTTOMLEFT] = diagonalVectors[TOPRIGHT] * -1.0f;
    // Get the bottomright diagonal vector
    diagonalVectors[BOTTOMRIGHT] = diagonalVectors[TOPLEFT] * -1.0f;
+
+   Changed();
+}
+
+//------------------------------------------------------
+// Works out the corners and bounds for this version of
+// the box. The other two diagonals are these two
+// flipped, so they give the same extents.
+//------------------------------------------------------
+void Box::UpdateCache() const
+{
+   for (int ii = 0; ii < MAX_DIAGONALS; ++ii) {
+      corners[ii] = center + (diagonalVectors[ii] * diagonalLength);
+   }
+
+   float topLeftX = fabsf(diagonalVectors[TOPLEFT].X());
+   float topRightX = fabsf(diagonalVectors[TOPRIGHT].X());
+   float topLeftY = fabsf(diagonalVectors[TOPLEFT].Y());
+   float topRightY = fabsf(diagonalVectors[TOPRIGHT].Y());
+   float extentX = (topLeftX > topRightX ? topLeftX : topRightX) * diagonalLength;
+   float extentY = (topLeftY > topRightY ? topLeftY : topRightY) * diagonalLength;
+   bounds = AABB(center.X() - extentX, center.Y() - extentY, center.X() + extentX, center.Y() + extentY);
+   cacheVersion = version;
 }
 
 //------------------------------------------------------
@@ -489,7 +589,8 @@ float Box::CalculateRadians(float degrees)
 //------------------------------------------------------
 Point Box::TopLeft() const
 {
-   return center + (diagonalVectors[TOPLEFT] * diagonalLength);
+   Refresh();
+   return corners[TOPLEFT];
 }
 
 //------------------------------------------------------
@@ -497,7 +598,8 @@ Point Box::TopLeft() const
 //------------------------------------------------------
 Point Box::TopRight() const
 {
-   return center + (diagonalVectors[TOPRIGHT] * diagonalLength);
+   Refresh();
+   return corners[TOPRIGHT];
 }
 
 //------------------------------------------------------
@@ -505,7 +607,8 @@ Point Box::TopRight() const
 //------------------------------------------------------
 Point Box::BottomLeft() const
 {
-   return center + (diagonalVectors[BOTTOMLEFT] * diagonalLength);
+   Refresh();
+   return corners[BOTTOMLEFT];
 }
 
 //------------------------------------------------------
@@ -513,7 +616,8 @@ Point Box::BottomLeft() const
 //------------------------------------------------------
 Point Box::BottomRight() const
 {
-   return center + (diagonalVectors[BOTTOMRIGHT] * diagonalLength);
+   Refresh();
+   return corners[BOTTOMRIGHT];
 }
 
 //------------------------------------------------------
@@ -521,7 +625,8 @@ Point Box::BottomRight() const
 //------------------------------------------------------
 Point Box::TL() const
 {
-   return center + (diagonalVectors[TOPLEFT] * diagonalLength);
+   Refresh();
+   return corners[TOPLEFT];
 }
 
 //------------------------------------------------------
@@ -529,7 +634,8 @@ Point Box::TL() const
 //------------------------------------------------------
 Point Box::TR() const
 {
-   return center + (diagonalVectors[TOPRIGHT] * diagonalLength);
+   Refresh();
+   return corners[TOPRIGHT];
 }
 
 //------------------------------------------------------
@@ -537,7 +643,8 @@ Point Box::TR() const
 //------------------------------------------------------
 Point Box::BL() const
 {
-   return center + (diagonalVectors[BOTTOMLEFT] * diagonalLength);
+   Refresh();
+   return corners[BOTTOMLEFT];
 }
 
 //------------------------------------------------------
@@ -545,7 +652,8 @@ Point Box::BL() const
 //------------------------------------------------------
 Point Box::BR() const
 {
-   return center + (diagonalVectors[BOTTOMRIGHT] * diagonalLength);
+   Refresh();
+   return corners[BOTTOMRIGHT];
 }
 
 //------------------------------------------------------
@@ -553,48 +661,29 @@ Point Box::BR() const
 //------------------------------------------------------
 Line Box::Line(Box::SIDE side) const
 {
-   auto chosenOne = Line::Line();
+   Refresh();
    switch (side)
    {
       case TOP:
-      {
-         chosenOne.Start(center + (diagonalVectors[TOPLEFT] * diagonalLength));
-         chosenOne.End(center + (diagonalVectors[TOPRIGHT] * diagonalLength));
-         break;
-      }
+         return ::Line(corners[TOPLEFT], corners[TOPRIGHT]);
       case BOTTOM:
-      {
-         chosenOne.Start(center + (diagonalVectors[BOTTOMRIGHT] * diagonalLength));
-         chosenOne.End(center + (diagonalVectors[BOTTOMLEFT] * diagonalLength));
-         break;
-      }
+         return ::Line(corners[BOTTOMRIGHT], corners[BOTTOMLEFT]);
       case LEFT:
-      {
-         chosenOne.Start(center + (diagonalVectors[BOTTOMLEFT] * diagonalLength));
-         chosenOne.End(center + (diagonalVectors[TOPLEFT] * diagonalLength));
-         break;
-      }
+         return ::Line(corners[BOTTOMLEFT], corners[TOPLEFT]);
       case RIGHT:
       default:
-      {
-         chosenOne.Start(center + (diagonalVectors[TOPRIGHT] * diagonalLength));
-         chosenOne.End(center + (diagonalVectors[BOTTOMRIGHT] * diagonalLength));
-         break;
-      }
+         return ::Line(corners[TOPRIGHT], corners[BOTTOMRIGHT]);
    };
-   return chosenOne;
 }
 
 //------------------------------------------------------
 // Gets the left X value of the box (IGNORES ROTATION)
+// (the middle of the left side)
 //------------------------------------------------------
 float Box::Left() const
 {
-   // Get left line
-   auto chosenOne = this->Line(Box::LEFT);
-   
-   // Get middle point
-   return ((chosenOne.End() + chosenOne.Start()) * 0.5f).X();
+   Refresh();
+   return (corners[BOTTOMLEFT].X() + corners[TOPLEFT].X()) * 0.5f;
 }
 
 //------------------------------------------------------
@@ -602,11 +691,8 @@ float Box::Left() const
 //------------------------------------------------------
 float Box::Right() const
 {
-   // Get left line
-   auto chosenOne = this->Line(Box::RIGHT);
-
-   // Get the middle point
-   return ((chosenOne.End() + chosenOne.Start()) * 0.5f).X();
+   Refresh();
+   return (corners[TOPRIGHT].X() + corners[BOTTOMRIGHT].X()) * 0.5f;
 }
 
 //------------------------------------------------------
@@ -614,11 +700,8 @@ float Box::Right() const
 //------------------------------------------------------
 float Box::Top() const
 {
-   // Get left line
-   auto chosenOne = this->Line(Box::TOP);
-
-   // Get the middle point
-   return ((chosenOne.End() + chosenOne.Start()) * 0.5f).Y();
+   Refresh();
+   return (corners[TOPLEFT].Y() + corners[TOPRIGHT].Y()) * 0.5f;
 }
 
 //------------------------------------------------------
@@ -626,11 +709,8 @@ float Box::Top() const
 //------------------------------------------------------
 float Box::Bottom() const
 {
-   // Get left line
-   auto chosenOne = this->Line(Box::BOTTOM);
-
-   // Get the middle point
-   return ((chosenOne.End() + chosenOne.Start()) * 0.5f).Y();
+   Refresh();
+   return (corners[BOTTOMRIGHT].Y() + corners[BOTTOMLEFT].Y()) * 0.5f;
 }
 
 void Box::Normal(int normalIndex, float& x, float& y) const
@@ -15,9 +15,53 @@
       LINE,
       CIRCLE,
       BOX,
+      CHAIN,
+      COMPOUND,
       NUM_SHAPES
    };
 
+   //------------------------------------------------------
+   // Collision filtering data for a shape.
+   //
+   // Two shapes can only collide if each one's category
+   // is in the other one's mask. If both shapes share the
+   // same non-zero group, the bits are ignored: a positive
+   // group always collides, a negative group never does.
+   // (So a projectile and its owner share a negative group)
+   //------------------------------------------------------
+   struct CollisionFilter
+   {
+      unsigned short categoryBits;
+      unsigned short maskBits;
+      short groupIndex;
+
+      CollisionFilter(unsigned short categoryBits = 0x0001, unsigned short maskBits = 0xFFFF, short groupIndex = 0)
+         : categoryBits(categoryBits), maskBits(maskBits), groupIndex(groupIndex) {}
+   };
+
+   // Determines if two filters allow a collision
+   bool ShouldCollide(const CollisionFilter& a, const CollisionFilter& b);
+
+   //------------------------------------------------------
+   // An axis aligned bounding box. Used by the broadphase
+   // to quickly throw away pairs that can't be touching.
+   //------------------------------------------------------
+   struct AABB
+   {
+      float minX;
+      float minY;
+      float maxX;
+      float maxY;
+
+      AABB(float minX = 0.0f, float minY = 0.0f, float maxX = 0.0f, float maxY = 0.0f)
+         : minX(minX), minY(minY), maxX(maxX), maxY(maxY) {}
+
+      // Do the two boxes overlap? (Touching counts)
+      bool Overlaps(const AABB& rhs) const {
+         return !(minX > rhs.maxX || maxX < rhs.minX || minY > rhs.maxY || maxY < rhs.minY);
+      }
+   };
+
    //------------------------------------------------------
    // The base class - a shape, which has a ShapeType
    //------------------------------------------------------
@@ -27,11 +71,42 @@
       // All shapes have a type of shape
       ShapeType shapeType;
 
+      // Who this shape is allowed to collide with
+      CollisionFilter filter;
+
+      // Bumped by everything that moves or reshapes the shape.
+      // Anything worked out from the shape is good for as long
+      // as the version stays the same. (The shapes work theirs
+      // out when it's first asked for, so ask on one thread
+      // before handing a changed shape to several.)
+      unsigned int version;
+      void Changed() { ++this->version; }
+
    public:
-      Shape() {}
+      Shape() : version(0) {}
+      Shape(const Shape& rhs) : shapeType(rhs.shapeType), filter(rhs.filter), version(rhs.version) {}
+      // The new version is past both old ones, so nothing cached for either matches it
+      Shape& operator=(const Shape& rhs) {
+         shapeType = rhs.shapeType;
+         filter = rhs.filter;
+         version = (version > rhs.version ? version : rhs.version) + 1;
+         return *this;
+      }
       virtual ~Shape() {}
       // Accessor
       ShapeType Type() const { return this->shapeType; }
+      // Has the shape changed since this was last looked at?
+      unsigned int Version() const { return this->version; }
+      const CollisionFilter& Filter() const { return this->filter; }
+      unsigned short CategoryBits() const { return this->filter.categoryBits; }
+      unsigned short MaskBits() const { return this->filter.maskBits; }
+      short GroupIndex() const { return this->filter.groupIndex; }
+
+      // Mutators
+      void Filter(const CollisionFilter& filter) { this->filter = filter; }
+      void CategoryBits(unsigned short bits) { this->filter.categoryBits = bits; }
+      void MaskBits(unsigned short bits) { this->filter.maskBits = bits; }
+      void GroupIndex(short group) { this->filter.groupIndex = group; }
       inline int NormalCount() const { return 0; }
       inline void Normal(int normalIndex, float& x, float& y) const { x = y = 0.0f; }
       inline void Move(float x, float y) {}
@@ -43,6 +118,10 @@
    //
    // This is also used as a math VECTOR/NORMAL.
    // Which might bite me in the ass later.
+   //
+   // Only the setters, Move() and assignment count as a
+   // change to the version. The maths operators are for
+   // vectors, which nobody tracks.
    //------------------------------------------------------
    class Point : public Shape {
    private:
@@ -82,15 +161,17 @@
       float Y() const { return y; }
       int XInt() const { return (int)x; }
       int YInt() const { return (int)y; }
+      AABB Bounds() const { return AABB(x, y, x, y); }
+      float BoundingRadius() const { return 0.0f; }
       inline int NormalCount() const { return 0; }
       inline void Normal(int normalIndex, float& x, float& y) const { x = y = 0.0f; }
 
       // Mutators
-      void X(float x) { this->x = x; dirty = true; }
-      void Y(float y) { this->y = y; dirty = true; }
-      void XInt(int x) { this->x = (float)x; dirty = true; }
-      void YInt(int y) { this->y = (float)y; dirty = true; }
-      void Move(float x, float y) { this->x += x; this->y += y; dirty = true; }
+      void X(float x) { this->x = x; dirty = true; Changed(); }
+      void Y(float y) { this->y = y; dirty = true; Changed(); }
+      void XInt(int x) { this->x = (float)x; dirty = true; Changed(); }
+      void YInt(int y) { this->y = (float)y; dirty = true; Changed(); }
+      void Move(float x, float y) { this->x += x; this->y += y; dirty = true; Changed(); }
 
       // Normalizes a vector
       void Normalize();
@@ -113,6 +194,17 @@
       Point start;
       Point end;
 
+      // Worked out the first time they're asked for after a change
+      mutable AABB bounds;
+      mutable float boundingRadius;
+      mutable Point direction;
+      mutable float normalX;
+      mutable float normalY;
+      mutable unsigned int cacheVersion;
+
+      void Refresh() const { if (cacheVersion != version) UpdateCache(); }
+      void UpdateCache() const;
+
    public:
       // Constructors
       Line(float startX = -5.0f, float startY = 0.0f, float endX = 5.0f, float endY = 0.0f);
@@ -135,14 +227,17 @@
       Point LineNormal() const;
       void Normal(int normalIndex, float& x, float& y) const;
       inline int NormalCount() const { return 1; }
+      const AABB& Bounds() const { Refresh(); return bounds; }
+      // Half the length, around the middle of the line
+      float BoundingRadius() const { Refresh(); return boundingRadius; }
 
       // Mutators
-      void Start(Point start) { this->start = start; }
-      void End(Point end) { this->end = end; }
-      void Start(float x, float y) { this->start.X(x); this->start.Y(y); }
-      void End(float x, float y) { this->end.X(x); this->end.Y(y); }
-      void StartInt(int x, int y) { this->start.XInt(x); this->start.YInt(y); }
-      void EndInt(int x, int y) { this->end.XInt(x); this->end.YInt(y); }
+      void Start(Point start) { this->start = start; Changed(); }
+      void End(Point end) { this->end = end; Changed(); }
+      void Start(float x, float y) { this->start.X(x); this->start.Y(y); Changed(); }
+      void End(float x, float y) { this->end.X(x); this->end.Y(y); Changed(); }
+      void StartInt(int x, int y) { this->start.XInt(x); this->start.YInt(y); Changed(); }
+      void EndInt(int x, int y) { this->end.XInt(x); this->end.YInt(y); Changed(); }
       void Move(float x, float y);
       
    };
@@ -155,6 +250,16 @@
    private:
       Point center;
       float radius;
+      // Worked out the first time it's asked for after a change
+      mutable AABB bounds;
+      mutable unsigned int cacheVersion;
+
+      void Refresh() const {
+         if (cacheVersion != version) {
+            bounds = AABB(center.X() - radius, center.Y() - radius, center.X() + radius, center.Y() + radius);
+            cacheVersion = version;
+         }
+      }
    public:
       // Constructor
       Circle(float x = 0.0f, float y = 0.0f, float radius = 5.0f);
@@ -172,15 +277,17 @@
       float CenterY() const { return center.Y(); }
       float Radius() const { return radius; }
       float RadiusSquared() const { return radius * radius; }
+      const AABB& Bounds() const { Refresh(); return bounds; }
+      float BoundingRadius() const { return radius; }
       inline int NormalCount() const { return 0; }
       inline void Normal(int normalIndex, float& x, float& y) const { x = y = 0.0f; }
 
       // Mutators
-      void Center(Point center) { this->center = center; }
-      void Center(float x, float y) { this->center = Point(x, y); }
-      void CenterX(float x) { this->center.X(x); }
-      void CenterY(float y) { this->center.Y(y); }
-      void Radius(float radius) { this->radius = radius; }
+      void Center(Point center) { this->center = center; Changed(); }
+      void Center(float x, float y) { this->center = Point(x, y); Changed(); }
+      void CenterX(float x) { this->center.X(x); Changed(); }
+      void CenterY(float y) { this->center.Y(y); Changed(); }
+      void Radius(float radius) { this->radius = radius; Changed(); }
       void Move(float xDistance, float yDistance) { this->Center(this->CenterX() + xDistance, this->CenterY() + yDistance); }
    };
 
@@ -215,9 +322,15 @@
       float height;
       float diagonalLength;
       float rotation;
+      // Worked out the first time they're asked for after a change
+      mutable Point corners[4];
+      mutable AABB bounds;
+      mutable unsigned int cacheVersion;
 
       // Calculates the diagonals of the box
       void CalculateDiagonals();
+      void Refresh() const { if (cacheVersion != version) UpdateCache(); }
+      void UpdateCache() const;
       float CalculateRadians(float degrees);
 
 
@@ -225,6 +338,10 @@
       Box(Point topLeft, Point bottomRight);
       Box(Point center, float width, float height, float rotation);
       Box(float topLeftX = 0.0f, float topLeftY = 0.0f, float width = 128.0f, float height = 128.0f, float rotation = 0.0f);
+      // For loading saved boxes: takes the already worked out
+      // top left/top right diagonals and face normals, so no trig is done
+      Box(Point center, float width, float height, float rotation, float diagonalLength,
+         Point topLeftDiagonal, Point topRightDiagonal, Point normalX, Point normalY);
 
       // Get all 4 corners
 
@@ -255,15 +372,20 @@
       inline float HalfWidth() const { return width * 0.5f; }
       inline float HalfHeight() const { return height * 0.5f; }
       inline float Rotation() const { return rotation; }
+      inline float DiagonalLength() const { return diagonalLength; }
+      inline Point Diagonal(DIAGONAL corner) const { return diagonalVectors[corner]; }
+      inline const AABB& Bounds() const { Refresh(); return bounds; }
+      // Center to corner, so a circle around the center holds the whole box
+      inline float BoundingRadius() const { return diagonalLength; }
       inline int NormalCount() const { return 2; }
       void Normal(int normalIndex, float& x, float& y) const;
 
       // Mutators
-      inline void Center(Point newCenter) { this->center = newCenter; }
+      inline void Center(Point newCenter) { this->center = newCenter; Changed(); }
       void Width(float newWidth);
       void Height(float newHeight);
       void Rotation(float newRotation);
-      void Move(float x, float y) { this->center += Point(x, y); }
+      void Move(float x, float y) { this->center += Point(x, y); Changed(); }
    };
 
 #endif // COLLISIONSTRUCT_H_
\ No newline at end of file
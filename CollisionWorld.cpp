@@ -0,0 +1,788 @@
+#include "CollisionWorld.h"
+#include "StaticMesh.h"
+#include "TileMap.h"
+#include "DistanceField.h"
+#include "ShapePool.h"
+#include "ParallelBroadphase.h"
+#include "ShapeDistance.h"
+
+#include <algorithm>
+
+//------------------------------------------------------
+// Constructor. Sleeping is on by default.
+//------------------------------------------------------
+CollisionWorld::CollisionWorld()
+{
+   staticMesh = 0;
+   tileMap = 0;
+   terrain = 0;
+   sleepEnabled = true;
+   sleepThreshold = 0.05f;
+   stepsToSleep = 60;
+   parallelBroadphase = 0;
+   contactEvents = 0;
+}
+
+//------------------------------------------------------
+// Destructor
+//------------------------------------------------------
+CollisionWorld::~CollisionWorld()
+{
+   delete parallelBroadphase;
+}
+
+//------------------------------------------------------
+// Sets how many threads the broadphase uses. Anything
+// but 1 switches to the parallel tree.
+//------------------------------------------------------
+void CollisionWorld::BroadphaseThreads(int threadCount)
+{
+   if (threadCount == 1) {
+      delete parallelBroadphase;
+      parallelBroadphase = 0;
+      return;
+   }
+   if (parallelBroadphase == 0) {
+      parallelBroadphase = new ParallelBroadphase(threadCount);
+   }
+   else {
+      parallelBroadphase->ThreadCount(threadCount);
+   }
+}
+
+//------------------------------------------------------
+// How many threads the broadphase uses
+//------------------------------------------------------
+int CollisionWorld::BroadphaseThreads() const
+{
+   return (parallelBroadphase != 0 ? parallelBroadphase->ThreadCount() : 1);
+}
+
+//------------------------------------------------------
+// Adds a shape to the world. Reuses old proxy ids.
+//------------------------------------------------------
+int CollisionWorld::AddShape(Shape* shape, bool isStatic)
+{
+   CollisionProxy proxy;
+   proxy.shape = shape;
+   proxy.bounds = ShapeBounds(shape);
+   proxy.shapeVersion = shape->Version();
+   proxy.isStatic = isStatic;
+   proxy.isSensor = false;
+   proxy.store = 0;
+   proxy.lastX = (proxy.bounds.minX + proxy.bounds.maxX) * 0.5f;
+   proxy.lastY = (proxy.bounds.minY + proxy.bounds.maxY) * 0.5f;
+   proxy.stillSteps = 0;
+   proxy.asleep = false;
+   proxy.sleepIsland = -1;
+
+   int proxyId;
+   if (freeProxies.size() > 0) {
+      proxyId = freeProxies.back();
+      freeProxies.pop_back();
+      proxies[proxyId] = proxy;
+   }
+   else {
+      proxyId = (int)proxies.size();
+      proxies.push_back(proxy);
+   }
+
+   sortedProxies.push_back(proxyId);
+   return proxyId;
+}
+
+//------------------------------------------------------
+// Adds a sensor. Sensors can move, but never get pushed.
+//------------------------------------------------------
+int CollisionWorld::AddSensor(Shape* shape)
+{
+   int proxyId = AddShape(shape, false);
+   proxies[proxyId].isSensor = true;
+   return proxyId;
+}
+
+//------------------------------------------------------
+// Adds a pooled shape to the world. Returns -1 if the
+// handle is stale. The handle is kept so the world notices
+// when the shape is destroyed under it.
+//------------------------------------------------------
+int CollisionWorld::AddShape(const ShapeStore& store, const ShapeHandle& handle, bool isStatic)
+{
+   Shape* shape = store.Get(handle);
+   if (shape == 0) {
+      return -1;
+   }
+   int proxyId = AddShape(shape, isStatic);
+   proxies[proxyId].store = &store;
+   proxies[proxyId].handle = handle;
+   return proxyId;
+}
+
+//------------------------------------------------------
+// Removes a shape from the world (doesn't delete it)
+//------------------------------------------------------
+void CollisionWorld::RemoveShape(int proxyId)
+{
+   if (proxyId < 0 || proxyId >= (int)proxies.size() || proxies[proxyId].shape == 0) {
+      return;
+   }
+
+   ForgetSleeper(proxyId);
+   proxies[proxyId].shape = 0;
+   freeProxies.push_back(proxyId);
+   ForgetRemoved();
+
+   for (unsigned int ii = 0; ii < sortedProxies.size(); ++ii) {
+      if (sortedProxies[ii] == proxyId) {
+         sortedProxies.erase(sortedProxies.begin() + ii);
+         break;
+      }
+   }
+}
+
+//------------------------------------------------------
+// Removes a batch of shapes. Rather than searching the
+// sorted list once per shape, they're all flagged and
+// the list is squeezed once.
+//------------------------------------------------------
+void CollisionWorld::RemoveShapes(const vector<int>& proxyIds)
+{
+   bool removedAny = false;
+   for (unsigned int ii = 0; ii < proxyIds.size(); ++ii) {
+      int proxyId = proxyIds[ii];
+      if (proxyId < 0 || proxyId >= (int)proxies.size() || proxies[proxyId].shape == 0) {
+         continue;
+      }
+      ForgetSleeper(proxyId);
+      proxies[proxyId].shape = 0;
+      freeProxies.push_back(proxyId);
+      removedAny = true;
+   }
+
+   if (!removedAny) {
+      return;
+   }
+   ForgetRemoved();
+
+   unsigned int kept = 0;
+   for (unsigned int ii = 0; ii < sortedProxies.size(); ++ii) {
+      if (proxies[sortedProxies[ii]].shape != 0) {
+         sortedProxies[kept++] = sortedProxies[ii];
+      }
+   }
+   sortedProxies.resize(kept);
+}
+
+//------------------------------------------------------
+// Gets the shape for a proxy id (0 if there isn't one)
+//------------------------------------------------------
+Shape* CollisionWorld::GetShape(int proxyId) const
+{
+   if (proxyId < 0 || proxyId >= (int)proxies.size()) {
+      return 0;
+   }
+   return proxies[proxyId].shape;
+}
+
+//------------------------------------------------------
+// Is the proxy static? (never pushed)
+//------------------------------------------------------
+bool CollisionWorld::IsStatic(int proxyId) const
+{
+   if (proxyId < 0 || proxyId >= (int)proxies.size()) {
+      return false;
+   }
+   return proxies[proxyId].isStatic;
+}
+
+//------------------------------------------------------
+// Is the proxy asleep?
+//------------------------------------------------------
+bool CollisionWorld::IsAsleep(int proxyId) const
+{
+   if (proxyId < 0 || proxyId >= (int)proxies.size()) {
+      return false;
+   }
+   return proxies[proxyId].asleep;
+}
+
+//------------------------------------------------------
+// Is the proxy a sensor?
+//------------------------------------------------------
+bool CollisionWorld::IsSensor(int proxyId) const
+{
+   if (proxyId < 0 || proxyId >= (int)proxies.size()) {
+      return false;
+   }
+   return proxies[proxyId].isSensor;
+}
+
+//------------------------------------------------------
+// Forgets any sensor overlaps or contacts with removed
+// shapes, so a reused proxy id can't inherit them. Sensor
+// exits get reported with the next step's events, contact
+// ends go out right away.
+//------------------------------------------------------
+void CollisionWorld::ForgetRemoved()
+{
+   unsigned int stillTouching = 0;
+   for (unsigned int ii = 0; ii < touching.size(); ++ii) {
+      const ProxyPair& contact = touching[ii];
+      if (proxies[contact.proxyA].shape == 0 || proxies[contact.proxyB].shape == 0) {
+         contactEvents->Publish(ContactEvent(contact.proxyA, contact.proxyB, false));
+      }
+      else {
+         touching[stillTouching++] = contact;
+      }
+   }
+   touching.resize(stillTouching);
+
+   unsigned int kept = 0;
+   for (unsigned int ii = 0; ii < sensorOverlaps.size(); ++ii) {
+      const ProxyPair& overlap = sensorOverlaps[ii];
+      if (proxies[overlap.proxyA].shape == 0 || proxies[overlap.proxyB].shape == 0) {
+         removedSensorEvents.push_back(SensorEvent(overlap.proxyA, overlap.proxyB, false));
+      }
+      else {
+         sensorOverlaps[kept++] = overlap;
+      }
+   }
+   sensorOverlaps.resize(kept);
+}
+
+//------------------------------------------------------
+// Sorts (sensor, other) pairs
+//------------------------------------------------------
+bool SensorOrder(const ProxyPair& a, const ProxyPair& b)
+{
+   return (a.proxyA != b.proxyA ? a.proxyA < b.proxyA : a.proxyB < b.proxyB);
+}
+
+//------------------------------------------------------
+// Compares this step's sensor overlaps to last step's.
+// Both lists are sorted, so one walk down them both finds
+// everything that came in or left.
+//------------------------------------------------------
+void CollisionWorld::UpdateSensors()
+{
+   std::sort(newSensorOverlaps.begin(), newSensorOverlaps.end(), SensorOrder);
+
+   sensorEvents.swap(removedSensorEvents);
+   removedSensorEvents.clear();
+
+   unsigned int oldIndex = 0;
+   unsigned int newIndex = 0;
+   while (oldIndex < sensorOverlaps.size() || newIndex < newSensorOverlaps.size()) {
+      if (newIndex == newSensorOverlaps.size()
+         || (oldIndex < sensorOverlaps.size() && SensorOrder(sensorOverlaps[oldIndex], newSensorOverlaps[newIndex]))) {
+         const ProxyPair& left = sensorOverlaps[oldIndex++];
+         sensorEvents.push_back(SensorEvent(left.proxyA, left.proxyB, false));
+      }
+      else if (oldIndex == sensorOverlaps.size()
+         || SensorOrder(newSensorOverlaps[newIndex], sensorOverlaps[oldIndex])) {
+         const ProxyPair& entered = newSensorOverlaps[newIndex++];
+         sensorEvents.push_back(SensorEvent(entered.proxyA, entered.proxyB, true));
+      }
+      else {
+         // Still inside
+         ++oldIndex;
+         ++newIndex;
+      }
+   }
+
+   sensorOverlaps.swap(newSensorOverlaps);
+   newSensorOverlaps.clear();
+}
+
+//------------------------------------------------------
+// Sets where contact events go. Switching rings (or
+// turning them off) starts over: anything touching now
+// gets a fresh begin event in the new ring.
+//------------------------------------------------------
+void CollisionWorld::ContactEvents(ContactEventRing* ring)
+{
+   contactEvents = ring;
+   touching.clear();
+}
+
+//------------------------------------------------------
+// Sorts contacts by their ids
+//------------------------------------------------------
+bool ContactOrder(const ContactEvent& a, const ContactEvent& b)
+{
+   return (a.proxyA != b.proxyA ? a.proxyA < b.proxyA : a.proxyB < b.proxyB);
+}
+
+//------------------------------------------------------
+// Compares this step's contacts to last step's (both
+// sorted), and publishes what began and ended. Pairs
+// where neither shape is awake aren't tested any more, so
+// they're kept as they were: they haven't stopped
+// touching, and they won't begin again when they wake.
+//------------------------------------------------------
+void CollisionWorld::PublishContacts()
+{
+   std::sort(newTouching.begin(), newTouching.end(), ContactOrder);
+
+   nextTouching.clear();
+   unsigned int oldIndex = 0;
+   unsigned int newIndex = 0;
+   while (oldIndex < touching.size() || newIndex < newTouching.size()) {
+      const ProxyPair* old = (oldIndex < touching.size() ? &touching[oldIndex] : 0);
+      const ContactEvent* now = (newIndex < newTouching.size() ? &newTouching[newIndex] : 0);
+      if (now == 0 || (old != 0 && (old->proxyA != now->proxyA ? old->proxyA < now->proxyA : old->proxyB < now->proxyB))) {
+         if (!IsAwake(proxies[old->proxyA]) && !IsAwake(proxies[old->proxyB])) {
+            // Asleep, not gone
+            nextTouching.push_back(*old);
+         }
+         else {
+            contactEvents->Publish(ContactEvent(old->proxyA, old->proxyB, false));
+         }
+         ++oldIndex;
+      }
+      else if (old == 0 || old->proxyA != now->proxyA || old->proxyB != now->proxyB) {
+         contactEvents->Publish(*now);
+         nextTouching.push_back(ProxyPair(now->proxyA, now->proxyB));
+         ++newIndex;
+      }
+      else {
+         // Still touching
+         nextTouching.push_back(*old);
+         ++oldIndex;
+         ++newIndex;
+      }
+   }
+
+   touching.swap(nextTouching);
+   newTouching.clear();
+}
+
+//------------------------------------------------------
+// Turns sleeping on/off. Turning it off wakes everyone.
+//------------------------------------------------------
+void CollisionWorld::SleepEnabled(bool enabled)
+{
+   sleepEnabled = enabled;
+   if (!enabled) {
+      for (unsigned int ii = 0; ii < proxies.size(); ++ii) {
+         proxies[ii].asleep = false;
+         proxies[ii].stillSteps = 0;
+         proxies[ii].sleepIsland = -1;
+      }
+      islands.clear();
+      freeIslands.clear();
+   }
+}
+
+//------------------------------------------------------
+// Wakes a shape (and everything it fell asleep with)
+//------------------------------------------------------
+void CollisionWorld::WakeShape(int proxyId)
+{
+   if (proxyId < 0 || proxyId >= (int)proxies.size() || proxies[proxyId].shape == 0) {
+      return;
+   }
+
+   if (proxies[proxyId].asleep) {
+      WakeIsland(proxies[proxyId].sleepIsland);
+   }
+   proxies[proxyId].stillSteps = 0;
+}
+
+//------------------------------------------------------
+// Wakes every proxy that fell asleep in the given island.
+// Only the island's own members are looked at, and the
+// slot goes back to be reused.
+//------------------------------------------------------
+void CollisionWorld::WakeIsland(int islandId)
+{
+   // Already awake (an island can get hit more than once a step)
+   if (islandId < 0 || islandId >= (int)islands.size() || islands[islandId].members.empty()) {
+      return;
+   }
+
+   SleepIsland& island = islands[islandId];
+   for (unsigned int ii = 0; ii < island.members.size(); ++ii) {
+      CollisionProxy& proxy = proxies[island.members[ii]];
+      // A removed member's id may belong to someone else by now
+      if (proxy.shape != 0 && proxy.asleep && proxy.sleepIsland == islandId) {
+         proxy.asleep = false;
+         proxy.stillSteps = 0;
+         proxy.sleepIsland = -1;
+      }
+   }
+   island.members.clear();
+   island.sleeping = 0;
+   freeIslands.push_back(islandId);
+}
+
+//------------------------------------------------------
+// A sleeping proxy is being removed. Its island lets go of
+// it, and goes back to be reused if it was the last one.
+//------------------------------------------------------
+void CollisionWorld::ForgetSleeper(int proxyId)
+{
+   CollisionProxy& proxy = proxies[proxyId];
+   if (!proxy.asleep || proxy.sleepIsland < 0) {
+      return;
+   }
+
+   SleepIsland& island = islands[proxy.sleepIsland];
+   if (--island.sleeping == 0) {
+      island.members.clear();
+      freeIslands.push_back(proxy.sleepIsland);
+   }
+   proxy.asleep = false;
+   proxy.sleepIsland = -1;
+}
+
+//------------------------------------------------------
+// Finds the root of an island (union find, with path halving)
+//------------------------------------------------------
+int CollisionWorld::FindIsland(int proxyId)
+{
+   while (islandParents[proxyId] != proxyId) {
+      islandParents[proxyId] = islandParents[islandParents[proxyId]];
+      proxyId = islandParents[proxyId];
+   }
+   return proxyId;
+}
+
+//------------------------------------------------------
+// Measures how far every awake shape moved this step,
+// builds islands out of the contacts, and puts islands
+// where everything has been still long enough to sleep
+//------------------------------------------------------
+void CollisionWorld::UpdateSleep()
+{
+   // Accumulate still time from how far each shape moved
+   for (unsigned int ii = 0; ii < proxies.size(); ++ii) {
+      CollisionProxy& proxy = proxies[ii];
+      if (proxy.shape == 0 || !IsAwake(proxy) || proxy.isSensor) {
+         continue;
+      }
+
+      // Pushes happened after the broadphase, so get fresh bounds
+      if (proxy.shape->Version() != proxy.shapeVersion) {
+         proxy.bounds = ShapeBounds(proxy.shape);
+         proxy.shapeVersion = proxy.shape->Version();
+      }
+      float x = (proxy.bounds.minX + proxy.bounds.maxX) * 0.5f;
+      float y = (proxy.bounds.minY + proxy.bounds.maxY) * 0.5f;
+      float dx = x - proxy.lastX;
+      float dy = y - proxy.lastY;
+      if (dx * dx + dy * dy <= sleepThreshold * sleepThreshold) {
+         ++proxy.stillSteps;
+      }
+      else {
+         proxy.stillSteps = 0;
+      }
+      proxy.lastX = x;
+      proxy.lastY = y;
+   }
+
+   // Build islands out of touching dynamic shapes.
+   // Static shapes don't join islands, or the whole level would be one.
+   islandParents.resize(proxies.size());
+   for (unsigned int ii = 0; ii < proxies.size(); ++ii) {
+      islandParents[ii] = ii;
+   }
+   for (unsigned int ii = 0; ii < contacts.size(); ++ii) {
+      if (proxies[contacts[ii].proxyA].isStatic || proxies[contacts[ii].proxyB].isStatic) {
+         continue;
+      }
+      int rootA = FindIsland(contacts[ii].proxyA);
+      int rootB = FindIsland(contacts[ii].proxyB);
+      if (rootA != rootB) {
+         islandParents[rootB] = rootA;
+      }
+   }
+
+   // An island is only as still as its least still member
+   islandStillSteps.assign(proxies.size(), stepsToSleep);
+   for (unsigned int ii = 0; ii < proxies.size(); ++ii) {
+      if (proxies[ii].shape != 0 && IsAwake(proxies[ii]) && !proxies[ii].isSensor) {
+         int root = FindIsland(ii);
+         if (proxies[ii].stillSteps < islandStillSteps[root]) {
+            islandStillSteps[root] = proxies[ii].stillSteps;
+         }
+      }
+   }
+
+   // Put resting islands to sleep (sensors stay awake, or
+   // they'd stop noticing sleeping things inside them)
+   islandSlots.assign(proxies.size(), -1);
+   for (unsigned int ii = 0; ii < proxies.size(); ++ii) {
+      if (proxies[ii].shape != 0 && IsAwake(proxies[ii]) && !proxies[ii].isSensor) {
+         int root = FindIsland(ii);
+         if (islandStillSteps[root] < stepsToSleep) {
+            continue;
+         }
+
+         if (islandSlots[root] < 0) {
+            if (freeIslands.size() > 0) {
+               islandSlots[root] = freeIslands.back();
+               freeIslands.pop_back();
+            }
+            else {
+               islandSlots[root] = (int)islands.size();
+               islands.push_back(SleepIsland());
+            }
+         }
+         SleepIsland& island = islands[islandSlots[root]];
+         island.members.push_back(ii);
+         ++island.sleeping;
+         proxies[ii].asleep = true;
+         proxies[ii].sleepIsland = islandSlots[root];
+      }
+   }
+}
+
+//------------------------------------------------------
+// Refreshes the bounds of every shape that has changed
+// since the world last looked. Sleeping shapes only
+// change if they were moved by hand, so they wake up.
+// Pooled shapes whose handle has gone stale are dropped
+// before anything looks at them.
+//------------------------------------------------------
+void CollisionWorld::UpdateBounds()
+{
+   for (unsigned int ii = 0; ii < proxies.size(); ++ii) {
+      CollisionProxy& proxy = proxies[ii];
+      if (proxy.shape == 0) {
+         continue;
+      }
+      if (proxy.store != 0 && proxy.store->Get(proxy.handle) != proxy.shape) {
+         staleProxies.push_back(ii);
+         continue;
+      }
+      if (proxy.shape->Version() == proxy.shapeVersion) {
+         continue;
+      }
+
+      proxy.bounds = ShapeBounds(proxy.shape);
+      proxy.shapeVersion = proxy.shape->Version();
+      if (proxy.asleep) {
+         WakeIsland(proxy.sleepIsland);
+      }
+   }
+
+   if (staleProxies.size() > 0) {
+      RemoveShapes(staleProxies);
+      staleProxies.clear();
+   }
+}
+
+//------------------------------------------------------
+// Insertion sorts the proxies by minX. Since things
+// don't move far in one step, the list is almost sorted
+// already and this is close to linear.
+//------------------------------------------------------
+void CollisionWorld::SortProxies()
+{
+   for (unsigned int ii = 1; ii < sortedProxies.size(); ++ii) {
+      int current = sortedProxies[ii];
+      float currentMin = proxies[current].bounds.minX;
+      int jj = (int)ii - 1;
+      while (jj >= 0 && proxies[sortedProxies[jj]].bounds.minX > currentMin) {
+         sortedProxies[jj + 1] = sortedProxies[jj];
+         --jj;
+      }
+      sortedProxies[jj + 1] = current;
+   }
+}
+
+//------------------------------------------------------
+// Sort and sweep broadphase. Fills the pairs list.
+//------------------------------------------------------
+void CollisionWorld::FindPairs()
+{
+   UpdateBounds();
+   if (parallelBroadphase != 0) {
+      FindPairsParallel();
+      return;
+   }
+   SortProxies();
+   pairs.clear();
+
+   for (unsigned int ii = 0; ii < sortedProxies.size(); ++ii) {
+      const CollisionProxy& proxyA = proxies[sortedProxies[ii]];
+
+      for (unsigned int jj = ii + 1; jj < sortedProxies.size(); ++jj) {
+         const CollisionProxy& proxyB = proxies[sortedProxies[jj]];
+
+         // Everything after this starts past our right side
+         if (proxyB.bounds.minX > proxyA.bounds.maxX) {
+            break;
+         }
+
+         // Static/sleeping things never need to collide with each other
+         if (!IsAwake(proxyA) && !IsAwake(proxyB)) {
+            continue;
+         }
+
+         if (SensorIgnores(proxyA, proxyB)) {
+            continue;
+         }
+
+         // Filtered pairs are never generated
+         if (!ShouldCollide(proxyA.shape, proxyB.shape)) {
+            continue;
+         }
+
+         if (proxyA.bounds.Overlaps(proxyB.bounds)) {
+            pairs.push_back(ProxyPair(sortedProxies[ii], sortedProxies[jj]));
+         }
+      }
+   }
+}
+
+//------------------------------------------------------
+// Parallel broadphase. The tree only knows the live
+// proxies, by their place in liveProxies, and only awake
+// ones walk it, so static/sleeping pairs never turn up.
+// Filters are checked after, since they're cheap next to
+// finding the pairs. Bounds were refreshed on this thread,
+// so the workers never touch a shape's lazy caches.
+//------------------------------------------------------
+void CollisionWorld::FindPairsParallel()
+{
+   liveProxies.clear();
+   liveBounds.clear();
+   liveAwake.clear();
+   for (unsigned int ii = 0; ii < proxies.size(); ++ii) {
+      if (proxies[ii].shape != 0) {
+         liveProxies.push_back(ii);
+         liveBounds.push_back(proxies[ii].bounds);
+         liveAwake.push_back(IsAwake(proxies[ii]) ? 1 : 0);
+      }
+   }
+
+   parallelBroadphase->Build(liveBounds);
+   parallelBroadphase->FindPairs(livePairs, liveAwake.empty() ? 0 : &liveAwake[0]);
+
+   pairs.clear();
+   for (unsigned int ii = 0; ii < livePairs.size(); ++ii) {
+      int proxyA = liveProxies[livePairs[ii].proxyA];
+      int proxyB = liveProxies[livePairs[ii].proxyB];
+      if (!SensorIgnores(proxies[proxyA], proxies[proxyB])
+         && ShouldCollide(proxies[proxyA].shape, proxies[proxyB].shape)) {
+         pairs.push_back(ProxyPair(proxyA, proxyB));
+      }
+   }
+}
+
+//------------------------------------------------------
+// The middle of a shape's bounds
+//------------------------------------------------------
+Point BoundsCenter(Shape* shape)
+{
+   AABB bounds = ShapeBounds(shape);
+   return Point((bounds.minX + bounds.maxX) * 0.5f, (bounds.minY + bounds.maxY) * 0.5f);
+}
+
+//------------------------------------------------------
+// Finds all the pairs, then collides them.
+// Returns the number of actual collisions.
+//------------------------------------------------------
+int CollisionWorld::Step()
+{
+   FindPairs();
+   contacts.clear();
+
+   for (unsigned int ii = 0; ii < pairs.size(); ++ii) {
+      CollisionProxy& proxyA = proxies[pairs[ii].proxyA];
+      CollisionProxy& proxyB = proxies[pairs[ii].proxyB];
+
+      // Sensors only need to know if they overlap. No push
+      // math, and it isn't a contact.
+      if (proxyA.isSensor || proxyB.isSensor) {
+         if (!BoundsReject(proxyA.shape, proxyB.shape) && ShapeDistance(proxyA.shape, proxyB.shape) <= 0.0f) {
+            if (proxyA.isSensor) {
+               newSensorOverlaps.push_back(pairs[ii]);
+            }
+            else {
+               newSensorOverlaps.push_back(ProxyPair(pairs[ii].proxyB, pairs[ii].proxyA));
+            }
+         }
+         continue;
+      }
+
+      // Static shapes take none of the push
+      float shareA = 0.5f;
+      if (proxyA.isStatic) {
+         shareA = 0.0f;
+      }
+      else if (proxyB.isStatic) {
+         shareA = 1.0f;
+      }
+      float pushPercent = PushPercentFor(proxyA.shape, proxyB.shape, shareA);
+
+      // For contact events, the push is measured by how far
+      // the shapes moved
+      Point startA, startB;
+      if (contactEvents != 0) {
+         startA = BoundsCenter(proxyA.shape);
+         startB = BoundsCenter(proxyB.shape);
+      }
+
+      if (HandleCollision(proxyA.shape, proxyB.shape, pushPercent)) {
+         contacts.push_back(pairs[ii]);
+
+         if (contactEvents != 0) {
+            Point apart = (BoundsCenter(proxyB.shape) - startB) - (BoundsCenter(proxyA.shape) - startA);
+            ContactEvent contact(pairs[ii].proxyA, pairs[ii].proxyB, true);
+            if (contact.proxyA > contact.proxyB) {
+               contact = ContactEvent(pairs[ii].proxyB, pairs[ii].proxyA, true);
+               apart *= -1.0f;
+            }
+            contact.depth = apart.Length();
+            if (contact.depth > 0.0f) {
+               contact.normalX = apart.X() / contact.depth;
+               contact.normalY = apart.Y() / contact.depth;
+            }
+            newTouching.push_back(contact);
+         }
+
+         // Getting hit wakes up a sleeping island
+         if (proxyA.asleep) {
+            hitIslands.push_back(proxyA.sleepIsland);
+         }
+         if (proxyB.asleep) {
+            hitIslands.push_back(proxyB.sleepIsland);
+         }
+      }
+   }
+
+   UpdateSensors();
+   if (contactEvents != 0) {
+      PublishContacts();
+   }
+   for (unsigned int ii = 0; ii < hitIslands.size(); ++ii) {
+      WakeIsland(hitIslands[ii]);
+   }
+   hitIslands.clear();
+
+   // Push everything awake out of the level
+   if (staticMesh != 0 || tileMap != 0 || terrain != 0) {
+      for (unsigned int ii = 0; ii < proxies.size(); ++ii) {
+         if (proxies[ii].shape != 0 && IsAwake(proxies[ii]) && !proxies[ii].isSensor) {
+            if (staticMesh != 0) {
+               staticMesh->Collide(proxies[ii].shape);
+            }
+            if (tileMap != 0) {
+               tileMap->Collide(proxies[ii].shape);
+            }
+            if (terrain != 0) {
+               terrain->Collide(proxies[ii].shape);
+            }
+         }
+      }
+   }
+
+   if (sleepEnabled) {
+      UpdateSleep();
+   }
+
+   return (int)contacts.size();
+}
@@ -0,0 +1,257 @@
+#ifndef COLLISIONWORLD_H_
+#define COLLISIONWORLD_H_
+
+#include "Collisions.h"
+#include "ContactEvents.h"
+#include "ShapePool.h"
+
+class StaticMesh;
+class TileMap;
+class DistanceField;
+class ParallelBroadphase;
+
+   //------------------------------------------------------
+   // A shape that has been added to the world.
+   // The world does NOT own the shape.
+   //------------------------------------------------------
+   struct CollisionProxy
+   {
+      Shape* shape;
+      AABB bounds;
+      bool isStatic;
+      // Sensors only report overlaps, they never push or get pushed
+      bool isSensor;
+      // The shape's version when bounds was taken
+      unsigned int shapeVersion;
+      // Where a pooled shape lives (store is 0 if it isn't
+      // pooled), so the world can tell once it's destroyed
+      const ShapeStore* store;
+      ShapeHandle handle;
+
+      // Sleep tracking. lastX/lastY is the center of the
+      // bounds at the end of the last step.
+      float lastX;
+      float lastY;
+      int stillSteps;
+      bool asleep;
+      // Which island this proxy fell asleep with (-1 if awake)
+      int sleepIsland;
+   };
+
+   //------------------------------------------------------
+   // Proxies that fell asleep together, so they can be
+   // woken together without looking at every proxy
+   //------------------------------------------------------
+   struct SleepIsland
+   {
+      vector<int> members;
+      // Members still asleep in the world
+      int sleeping;
+
+      SleepIsland() : sleeping(0) {}
+   };
+
+   //------------------------------------------------------
+   // Two proxies (by id) that the world found together
+   //------------------------------------------------------
+   struct ProxyPair
+   {
+      int proxyA;
+      int proxyB;
+
+      ProxyPair(int proxyA = -1, int proxyB = -1) : proxyA(proxyA), proxyB(proxyB) {}
+   };
+
+   //------------------------------------------------------
+   // Something started or stopped overlapping a sensor
+   //------------------------------------------------------
+   struct SensorEvent
+   {
+      int sensorProxy;
+      int otherProxy;
+      // true when it came in, false when it left
+      bool entered;
+
+      SensorEvent(int sensorProxy = -1, int otherProxy = -1, bool entered = false)
+         : sensorProxy(sensorProxy), otherProxy(otherProxy), entered(entered) {}
+   };
+
+   //------------------------------------------------------
+   // A collection of shapes that get collided against
+   // each other every Step().
+   //
+   // The broadphase is a sort and sweep along X. The sorted
+   // list is kept between steps, so re-sorting is cheap when
+   // things haven't moved much. Pairs that the collision
+   // filters reject, and static vs static pairs, are thrown
+   // out inside the sweep so they never become pairs.
+   //
+   // Shapes that barely move for a while go to sleep.
+   // Shapes touching each other form an island, and an
+   // island only sleeps once everything in it is resting.
+   // Sleeping vs sleeping/static pairs are never generated,
+   // and a sleeping island wakes when something awake hits it.
+   //
+   // Only shapes whose Version() has changed get their bounds
+   // refreshed, so moving any shape yourself (even a static
+   // or sleeping one) is noticed on the next step, and a
+   // sleeping shape that was moved wakes up its island.
+   //
+   // Sensors (triggers) are shapes that only want to know
+   // what's overlapping them. The world keeps the set of
+   // everything inside each sensor between steps, and each
+   // Step() reports just what came in or left. Sensors never
+   // push or get pushed, never sleep, and are never paired
+   // with each other or with static shapes.
+   //
+   // Hand the world a ContactEventRing and every Step()
+   // publishes which pairs started and stopped touching, for
+   // other threads to read without locking.
+   //
+   // Really big worlds can give the broadphase more threads
+   // with BroadphaseThreads(), which swaps the sweep for a
+   // ParallelBroadphase tree rebuilt every step.
+   //------------------------------------------------------
+   class CollisionWorld
+   {
+   private:
+      vector<CollisionProxy> proxies;
+      vector<int> freeProxies;
+      // Proxy ids, sorted by their bounds' minX
+      vector<int> sortedProxies;
+      vector<ProxyPair> pairs;
+      vector<ProxyPair> contacts;
+      // What's inside each sensor (sensor first), sorted
+      vector<ProxyPair> sensorOverlaps;
+      vector<ProxyPair> newSensorOverlaps;
+      vector<SensorEvent> sensorEvents;
+      // Exits from shapes removed since the last step
+      vector<SensorEvent> removedSensorEvents;
+
+      // Contact events (ring not owned, 0 when off). Pairs
+      // that were touching last step, sorted, lowest id first.
+      // Pairs that fell asleep stay in here until they wake.
+      ContactEventRing* contactEvents;
+      vector<ProxyPair> touching;
+      vector<ContactEvent> newTouching;
+      vector<ProxyPair> nextTouching;
+
+      // Baked level geometry (not owned)
+      const StaticMesh* staticMesh;
+      const TileMap* tileMap;
+      const DistanceField* terrain;
+
+      // Sleep settings
+      bool sleepEnabled;
+      float sleepThreshold;
+      int stepsToSleep;
+      // Scratch for island building
+      vector<int> islandParents;
+      vector<int> islandStillSteps;
+      vector<int> islandSlots;
+      // Sleeping islands. A slot is only reused once its island
+      // has woken (or lost every member), so a proxy's
+      // sleepIsland can't end up naming somebody else's island.
+      vector<SleepIsland> islands;
+      vector<int> freeIslands;
+      // Sleeping islands hit this step. They wake once the
+      // step's contacts are out, so the pairs they skipped
+      // aren't taken for ones that stopped touching.
+      vector<int> hitIslands;
+
+      // Multi-threaded broadphase (0 when off) and its scratch
+      ParallelBroadphase* parallelBroadphase;
+      vector<int> liveProxies;
+      vector<AABB> liveBounds;
+      vector<unsigned char> liveAwake;
+      vector<ProxyPair> livePairs;
+      // Pooled shapes found destroyed by UpdateBounds()
+      vector<int> staleProxies;
+
+      void UpdateBounds();
+      void SortProxies();
+      bool IsAwake(const CollisionProxy& proxy) const { return !proxy.isStatic && !proxy.asleep; }
+      // Sensors never need to overlap each other or the level
+      bool SensorIgnores(const CollisionProxy& a, const CollisionProxy& b) const {
+         return (a.isSensor && (b.isSensor || b.isStatic)) || (b.isSensor && a.isStatic);
+      }
+      void ForgetRemoved();
+      void UpdateSensors();
+      void PublishContacts();
+      int FindIsland(int proxyId);
+      void WakeIsland(int islandId);
+      void ForgetSleeper(int proxyId);
+      void UpdateSleep();
+      void FindPairsParallel();
+
+      CollisionWorld(const CollisionWorld&) = delete;
+      CollisionWorld& operator=(const CollisionWorld&) = delete;
+
+   public:
+      CollisionWorld();
+      ~CollisionWorld();
+
+      // Adds a shape, returns the proxy id for it
+      int AddShape(Shape* shape, bool isStatic = false);
+      // Adds a pooled shape. Once its handle goes stale (it was
+      // destroyed, or its slot reused) the next step drops it.
+      int AddShape(const ShapeStore& store, const ShapeHandle& handle, bool isStatic = false);
+      void RemoveShape(int proxyId);
+      // Removes a lot of shapes at once, in one pass over the sorted list
+      void RemoveShapes(const vector<int>& proxyIds);
+      // Adds a sensor, returns the proxy id for it
+      int AddSensor(Shape* shape);
+
+      // Accessors
+      Shape* GetShape(int proxyId) const;
+      bool IsStatic(int proxyId) const;
+      const AABB& Bounds(int proxyId) const { return proxies[proxyId].bounds; }
+      int ProxyCapacity() const { return (int)proxies.size(); }
+      const vector<ProxyPair>& Pairs() const { return pairs; }
+      const vector<ProxyPair>& Contacts() const { return contacts; }
+      bool IsAsleep(int proxyId) const;
+      bool IsSensor(int proxyId) const;
+      // What came into or left a sensor during the last Step()
+      const vector<SensorEvent>& SensorEvents() const { return sensorEvents; }
+      // Everything inside a sensor right now, as (sensor, other)
+      const vector<ProxyPair>& SensorOverlaps() const { return sensorOverlaps; }
+
+      // Where contact begin/end events go (0 for nowhere)
+      void ContactEvents(ContactEventRing* ring);
+      ContactEventRing* ContactEvents() const { return contactEvents; }
+
+      // Sleeping. A shape that moves less than the threshold
+      // each step for stepsToSleep steps is ready to sleep.
+      void SleepEnabled(bool enabled);
+      void SleepSettings(float threshold, int stepsToSleep) { this->sleepThreshold = threshold; this->stepsToSleep = stepsToSleep; }
+      void WakeShape(int proxyId);
+
+      // Baked level geometry that every awake shape gets
+      // collided against at the end of Step(). The world
+      // doesn't own it. Pass 0 to remove it.
+      void StaticGeometry(const StaticMesh* mesh) { this->staticMesh = mesh; }
+      const StaticMesh* StaticGeometry() const { return staticMesh; }
+
+      // Same idea, for a tile grid
+      void TileGeometry(const TileMap* tiles) { this->tileMap = tiles; }
+      const TileMap* TileGeometry() const { return tileMap; }
+
+      // And for distance field terrain
+      void TerrainGeometry(const DistanceField* terrain) { this->terrain = terrain; }
+      const DistanceField* TerrainGeometry() const { return terrain; }
+
+      // How many threads the broadphase uses. 1 (the default)
+      // is the sort and sweep, 0 means one per core.
+      void BroadphaseThreads(int threadCount);
+      int BroadphaseThreads() const;
+
+      // Runs just the broadphase, filling Pairs()
+      void FindPairs();
+
+      // Runs the broadphase then collides (and pushes) every pair.
+      // Static shapes never get pushed.
+      // Returns the number of pairs that actually collided.
+      int Step();
+   };
+
+#endif // COLLISIONWORLD_H_
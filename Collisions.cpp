@@ -1,11 +1,23 @@
 #include "Collisions.h"
+#include "Chain.h"
+#include "Compound.h"
+#include "SegmentIntersect.h"
+
+// For FLT_EPSILON
+#include <cfloat>
+// For sqrtf
+#include <cmath>
+
+// How far past touching two lines get pushed, so they
+// don't start the next step still touching
+const float lineClearance = 0.1f;
 
 //------------------------------------------------------
 // Returns a normal between two points.
 // The first point is the FROM point
 // The second point is the TO point (points from -> to)
 //------------------------------------------------------
-Point GetNormalBetweenPoints(Point& fromPoint, Point& toPoint) {
+Point GetNormalBetweenPoints(const Point& fromPoint, const Point& toPoint) {
    Point normal = toPoint - fromPoint;
    normal.Normalize();
    return normal;
@@ -19,7 +31,7 @@ Point GetNormalBetweenPoints(Point& fromPoint, Point& toPoint) {
 // ON the line segment (since lines are technically infinite)
 // The bool defaults to true.
 //------------------------------------------------------
-Point ClosestPointOnLine(Line& theLine, Point& testPoint, bool pointOnSegment)
+Point ClosestPointOnLine(const Line& theLine, const Point& testPoint, bool pointOnSegment)
 {
    return ClosestPointOnLine(theLine.Start(), theLine.End(), testPoint, pointOnSegment);
 }
@@ -32,7 +44,7 @@ Point ClosestPointOnLine(Line& theLine, Point& testPoint, bool pointOnSegment)
 // ON the line segment (since lines are technically infinite)
 // The bool defaults to true.
 //------------------------------------------------------
-Point ClosestPointOnLine(Point& startPoint, Point& endPoint, Point& testPoint, bool pointOnSegment) {
+Point ClosestPointOnLine(const Point& startPoint, const Point& endPoint, const Point& testPoint, bool pointOnSegment) {
    // Get the line's normal
    Point lineNormal = GetNormalBetweenPoints(startPoint, endPoint);
 
@@ -153,6 +165,222 @@ bool SatOverlap(vector<Point> normals, vector<Point> pointsA, vector<Point> poin
    return true;
 }
 
+//------------------------------------------------------
+// Gets the min/max of an array of points along a normal
+//------------------------------------------------------
+void MinMax(const Point& normal, const Point* points, int pointCount, float& min, float& max)
+{
+   // Assumed there is always at least 1 point
+   min = max = normal.Dot(points[0]);
+   float dot = 0.0f;
+   for (int ii = 1; ii < pointCount; ++ii) {
+      dot = points[ii].Dot(normal);
+      if (dot < min) min = dot;
+      if (dot > max) max = dot;
+   }
+}
+
+//------------------------------------------------------
+// SAT on plain arrays. The min/maxes live in scratch
+// memory instead of vectors. Same answer as the vector
+// version, but it quits at the first separating axis.
+//------------------------------------------------------
+bool SatOverlap(const Point* normals, int normalCount, const Point* pointsA, int pointCountA,
+   const Point* pointsB, int pointCountB, Point& overlapDir, float& overlap, FrameAllocator& scratch)
+{
+   // No normals or points? Bad function call.
+   if (normalCount <= 0 || pointCountA <= 0 || pointCountB <= 0) {
+      return false;
+   }
+
+   // x is the min, y is the max
+   Point* aMinMaxes = scratch.AllocateArray<Point>(normalCount);
+   Point* bMinMaxes = scratch.AllocateArray<Point>(normalCount);
+   float min, max, distance;
+   overlap = 0.0f;
+   bool firstOverlap = true;
+
+   for (int ii = 0; ii < normalCount; ++ii) {
+      MinMax(normals[ii], pointsA, pointCountA, min, max);
+      aMinMaxes[ii] = Point(min, max);
+      MinMax(normals[ii], pointsB, pointCountB, min, max);
+      bMinMaxes[ii] = Point(min, max);
+
+      if (!MinMaxOverlap(aMinMaxes[ii], bMinMaxes[ii])) {
+         // No overlap, thus no collision
+         return false;
+      }
+      distance = OverlapDistance(aMinMaxes[ii], bMinMaxes[ii]);
+
+      // Save the smallest distance & normal
+      if (firstOverlap || absValue(distance) < absValue(overlap)) {
+         overlapDir = normals[ii];
+         overlap = distance;
+         firstOverlap = false;
+      }
+   }
+
+   // We have a collision
+   return true;
+}
+
+
+//------------------------------------------------------
+// Determines if two shapes are allowed to collide,
+// based on their collision filters
+//------------------------------------------------------
+bool ShouldCollide(const Shape* objA, const Shape* objB) {
+   return ShouldCollide(objA->Filter(), objB->Filter());
+}
+
+//------------------------------------------------------
+// Gets the push percent that moves objA by shareA.
+// Most handlers move A by the push percent, but the
+// box handlers that do SAT/projection against a box
+// move B by it, so they get the other side.
+//------------------------------------------------------
+float PushPercentFor(const Shape* objA, const Shape* objB, float shareA) {
+   bool flipped = (objA->Type() == CIRCLE && objB->Type() == BOX)
+      || (objA->Type() == BOX && objB->Type() == CIRCLE)
+      || (objA->Type() == BOX && objB->Type() == BOX);
+   return (flipped ? 1.0f - shareA : shareA);
+}
+
+//------------------------------------------------------
+// Gets the axis aligned bounds of a shape. The shapes
+// keep these up to date, so this is just a lookup.
+//------------------------------------------------------
+AABB ShapeBounds(Shape* shape) {
+   if (shape == 0) {
+      return AABB();
+   }
+
+   switch (shape->Type()) {
+      case SHAPE_POINT:
+         return static_cast<Point*>(shape)->Bounds();
+      case LINE:
+         return static_cast<Line*>(shape)->Bounds();
+      case CIRCLE:
+         return static_cast<Circle*>(shape)->Bounds();
+      case BOX:
+         return static_cast<Box*>(shape)->Bounds();
+      case CHAIN:
+         return static_cast<Chain*>(shape)->Bounds();
+      case COMPOUND:
+         return static_cast<Compound*>(shape)->Bounds();
+      default:
+         return AABB();
+   };
+}
+
+//------------------------------------------------------
+// Gets a circle around the whole shape
+//------------------------------------------------------
+void BoundingCircle(Shape* shape, float& x, float& y, float& radius) {
+   switch (shape->Type()) {
+      case SHAPE_POINT:
+      {
+         Point* point = static_cast<Point*>(shape);
+         x = point->X();
+         y = point->Y();
+         radius = 0.0f;
+         break;
+      }
+      case LINE:
+      {
+         Line* line = static_cast<Line*>(shape);
+         x = (line->StartX() + line->EndX()) * 0.5f;
+         y = (line->StartY() + line->EndY()) * 0.5f;
+         radius = line->BoundingRadius();
+         break;
+      }
+      case CIRCLE:
+      {
+         Circle* circle = static_cast<Circle*>(shape);
+         x = circle->CenterX();
+         y = circle->CenterY();
+         radius = circle->Radius();
+         break;
+      }
+      case BOX:
+      {
+         Box* box = static_cast<Box*>(shape);
+         x = box->Center().X();
+         y = box->Center().Y();
+         radius = box->BoundingRadius();
+         break;
+      }
+      case CHAIN:
+      {
+         Chain* chain = static_cast<Chain*>(shape);
+         AABB bounds = chain->Bounds();
+         x = (bounds.minX + bounds.maxX) * 0.5f;
+         y = (bounds.minY + bounds.maxY) * 0.5f;
+         radius = chain->BoundingRadius();
+         break;
+      }
+      case COMPOUND:
+      {
+         Compound* compound = static_cast<Compound*>(shape);
+         x = compound->X();
+         y = compound->Y();
+         radius = compound->BoundingRadius();
+         break;
+      }
+      default:
+         x = y = radius = 0.0f;
+         break;
+   };
+}
+
+//------------------------------------------------------
+// The cheap test before any pair test: do the bounds or
+// the bounding circles miss? (Point == allows FLT_EPSILON,
+// so the tests do too)
+//------------------------------------------------------
+bool BoundsReject(Shape* objA, Shape* objB) {
+   AABB boundsA = ShapeBounds(objA);
+   AABB boundsB = ShapeBounds(objB);
+   if (boundsA.minX > boundsB.maxX + FLT_EPSILON || boundsA.maxX < boundsB.minX - FLT_EPSILON
+      || boundsA.minY > boundsB.maxY + FLT_EPSILON || boundsA.maxY < boundsB.minY - FLT_EPSILON) {
+      return true;
+   }
+
+   float xA, yA, radiusA, xB, yB, radiusB;
+   BoundingCircle(objA, xA, yA, radiusA);
+   BoundingCircle(objB, xB, yB, radiusB);
+   float dx = xA - xB;
+   float dy = yA - yB;
+   float reach = radiusA + radiusB + 2.0f * FLT_EPSILON;
+   return dx * dx + dy * dy > reach * reach;
+}
+
+//------------------------------------------------------
+// How often the bounds test saves a pair test
+//------------------------------------------------------
+void CollisionStats::Reset() {
+   for (int ii = 0; ii < NUM_SHAPES; ++ii) {
+      for (int jj = 0; jj < NUM_SHAPES; ++jj) {
+         tests[ii][jj] = 0;
+         rejects[ii][jj] = 0;
+      }
+   }
+}
+
+float CollisionStats::RejectRate(ShapeType typeA, ShapeType typeB) const {
+   if (tests[typeA][typeB] == 0) {
+      return 0.0f;
+   }
+   return (float)rejects[typeA][typeB] / (float)tests[typeA][typeB];
+}
+
+//------------------------------------------------------
+// Each thread counts its own, so no locking is needed
+//------------------------------------------------------
+CollisionStats& ThreadCollisionStats() {
+   static thread_local CollisionStats stats;
+   return stats;
+}
 
 //------------------------------------------------------
 // Handles the collision between 2 shapes
@@ -161,6 +389,36 @@ bool HandleCollision(Shape* objA, Shape* objB, float pushPercent) {
 	// Check the validity of the objects
 	if(objA != 0 && objB != 0)
 	{
+		// Filtered out pairs never reach the pair tests
+		if(!ShouldCollide(objA, objB)) {
+			return false;
+		}
+
+		// Neither do pairs whose bounds miss
+		CollisionStats& stats = ThreadCollisionStats();
+		++stats.tests[objA->Type()][objB->Type()];
+		if(BoundsReject(objA, objB)) {
+			++stats.rejects[objA->Type()][objB->Type()];
+			return false;
+		}
+
+		// Compounds hand the other shape to the children it reaches
+		// (first, so a compound against a chain goes child by child)
+		if(objB->Type() == COMPOUND) {
+			return HandleShapevCompound(objA, dynamic_cast<Compound*>(objB), pushPercent);
+		}
+		else if(objA->Type() == COMPOUND) {
+			return HandleCompoundvShape(dynamic_cast<Compound*>(objA), objB, pushPercent);
+		}
+
+		// Chains walk their own edges against the other shape
+		if(objB->Type() == CHAIN) {
+			return HandleShapevChain(objA, dynamic_cast<Chain*>(objB), pushPercent);
+		}
+		else if(objA->Type() == CHAIN) {
+			return HandleChainvShape(dynamic_cast<Chain*>(objA), objB, pushPercent);
+		}
+
 		if(objA->Type() == SHAPE_POINT) {
 			if(objB->Type() == SHAPE_POINT) {
 				return HandlePointvPoint(dynamic_cast<Point*>(objA), dynamic_cast<Point*>(objB), pushPercent);
@@ -221,6 +479,52 @@ bool HandleCollision(Shape* objA, Shape* objB, float pushPercent) {
   return false;
 }
 
+//------------------------------------------------------
+// Pushes a circle out of an axis aligned box that can't
+// move. Uses the closest point on the box, so it works
+// for long thin boxes too. If the center is inside the
+// box, the circle goes out the nearest side.
+//------------------------------------------------------
+bool PushCircleOutOfAABB(Circle* circle, const AABB& bounds) {
+   float x = circle->CenterX();
+   float y = circle->CenterY();
+
+   // Closest point on the box to the center
+   float closestX = (x < bounds.minX ? bounds.minX : (x > bounds.maxX ? bounds.maxX : x));
+   float closestY = (y < bounds.minY ? bounds.minY : (y > bounds.maxY ? bounds.maxY : y));
+   float dx = x - closestX;
+   float dy = y - closestY;
+   float distanceSquared = dx * dx + dy * dy;
+
+   if (distanceSquared > circle->RadiusSquared()) {
+      return false;
+   }
+
+   if (distanceSquared > 0.0f) {
+      // Center is outside the box, push straight away from it
+      float distance = sqrtf(distanceSquared);
+      float push = circle->Radius() - distance;
+      circle->Move(dx / distance * push, dy / distance * push);
+   }
+   else {
+      // Center is inside, leave through the closest side
+      float left = x - bounds.minX;
+      float right = bounds.maxX - x;
+      float top = y - bounds.minY;
+      float bottom = bounds.maxY - y;
+      float smallest = left;
+      if (right < smallest) smallest = right;
+      if (top < smallest) smallest = top;
+      if (bottom < smallest) smallest = bottom;
+
+      if (smallest == left) circle->Move(-(left + circle->Radius()), 0.0f);
+      else if (smallest == right) circle->Move(right + circle->Radius(), 0.0f);
+      else if (smallest == top) circle->Move(0.0f, -(top + circle->Radius()));
+      else circle->Move(0.0f, bottom + circle->Radius());
+   }
+   return true;
+}
+
 //------------------------------------------------------
 // Handles collision between 2 points
 // This would be a very rare occasion!
@@ -342,31 +646,38 @@ bool HandlePointvCircle(Point* point, Circle* circle, float pushPercent)
 // and the box will be pushed the remainder 75%
 //------------------------------------------------------
 bool HandlePointvBox(Point* point, Box* box, float pushPercent) {
+   FrameAllocator& scratch = ThreadFrameAllocator();
+   FrameAllocator::Marker marker = scratch.GetMarker();
+   bool collided = HandlePointvBox(point, box, pushPercent, scratch);
+   scratch.Rewind(marker);
+   return collided;
+}
+
+//------------------------------------------------------
+// Point vs box, with the SAT arrays in scratch memory
+//------------------------------------------------------
+bool HandlePointvBox(Point* point, Box* box, float pushPercent, FrameAllocator& scratch) {
    // Useful variables
-   vector<Point> normals;
-   vector<Point> shapeA;
-   vector<Point> shapeB;
+   Point* normals = scratch.AllocateArray<Point>(2);
+   Point* shapeA = scratch.AllocateArray<Point>(4);
    Point finalNormal;
    float finalMin;
    float tempX, tempY;
 
    // Create Normal array
    box->Normal(0, tempX, tempY);
-   normals.push_back(Point(tempX, tempY));
+   normals[0] = Point(tempX, tempY);
    box->Normal(1, tempX, tempY);
-   normals.push_back(Point(tempX, tempY));
+   normals[1] = Point(tempX, tempY);
 
    // Create PointsA Array
-   shapeA.push_back(box->TL());
-   shapeA.push_back(box->TR());
-   shapeA.push_back(box->BL());
-   shapeA.push_back(box->BR());
-
-   // Create PointsB Array
-   shapeB.push_back(*point);
+   shapeA[0] = box->TL();
+   shapeA[1] = box->TR();
+   shapeA[2] = box->BL();
+   shapeA[3] = box->BR();
 
-   // If there is a collision
-   if (SatOverlap(normals, shapeA, shapeB, finalNormal, finalMin)) {
+   // If there is a collision (PointsB is just the point)
+   if (SatOverlap(normals, 2, shapeA, 4, point, 1, finalNormal, finalMin, scratch)) {
       // Push the shapes?
       if (pushPercent != -1.0f) {
          // Use the final Min & final Normal to push by percentage
@@ -393,65 +704,27 @@ bool HandleLinevLine(Line* lineA, Line* lineB, float pushPercent) {
    Point collideSpot;
    Point pushDir;
    float pushDist, temp;
-   float a1, a2, b1, b2, c1, c2;
-   float r1, r2, r3, r4;
-   float denom, offset, num;
-
-   a1 = lineA->End().Y() - lineA->Start().Y();
-   b1 = lineA->Start().X() - lineA->End().X();
-   c1 = (lineA->End().X() * lineA->Start().Y()) - (lineA->Start().X() * lineA->End().Y());
-
-   r3 = ((a1 * lineB->Start().X()) + (b1 * lineB->Start().Y()) + c1);
-   r4 = ((a1 * lineB->End().X()) + (b1 * lineB->End().Y()) + c1);
 
-   if ((r3 != 0) && (r4 != 0) && sameSign(r3, r4)) {
+   SegmentHit hit;
+   if (!IntersectSegments(lineA->StartX(), lineA->StartY(), lineA->EndX(), lineA->EndY(),
+      lineB->StartX(), lineB->StartY(), lineB->EndX(), lineB->EndY(), hit)) {
       return false;
    }
 
-   // Compute a2, b2, c2
-   a2 = lineB->End().Y() - lineB->Start().Y();
-   b2 = lineB->Start().X() - lineB->End().X();
-   c2 = (lineB->End().X() * lineB->Start().Y()) - (lineB->Start().X() * lineB->End().Y());
-   // Compute r1 and r2
-   r1 = (a2 * lineA->Start().X()) + (b2 * lineA->Start().Y()) + c2;
-   r2 = (a2 * lineA->End().X()) + (b2 * lineA->End().Y()) + c2;
-
-   if ((r1 != 0) && (r2 != 0) && (sameSign(r1, r2))) {
-      return false;
-   }
-
-   // Line segments intersect: compute intersection point.
-   denom = (a1 * b2) - (a2 * b1); 
-
-   // Same line? (collinear)
-   if (denom == 0) {
-      return false;
-   }
-
-   if (denom < 0) {
-      offset = -denom / 2;
-   }
-   else {
-      offset = denom / 2;
-   }
-
-   num = (b1 * c2) - (b2 * c1);
-   if (num < 0) {
-      collideSpot.X((num - offset) / denom);
-   }
-   else {
-      collideSpot.X((num + offset) / denom);
-   }
-
-   num = (a2 * c1) - (a1 * c2);
-
-   if (num < 0) {
-      
-      collideSpot.Y((num - offset) / denom);
-   }
-   else {
-      collideSpot.Y((num + offset) / denom);
+   // Lying along each other. Sliding apart would take the
+   // whole length they share, but they have no thickness,
+   // so sideways they're apart as soon as they move at all:
+   // just the clearance, along A's normal.
+   if (hit.collinear) {
+      if (pushPercent >= 0.0f) {
+         float normalX, normalY;
+         lineA->Normal(0, normalX, normalY);
+         lineA->Move(normalX * lineClearance * pushPercent, normalY * lineClearance * pushPercent);
+         lineB->Move(normalX * -lineClearance * (1.0f - pushPercent), normalY * -lineClearance * (1.0f - pushPercent));
+      }
+      return true;
    }
+   collideSpot = Point(hit.x, hit.y);
 
    // Determine smallest collide distance
    // A start
@@ -482,7 +755,7 @@ bool HandleLinevLine(Line* lineA, Line* lineB, float pushPercent) {
    // Now we have the smallest distance point, actually calculate the distance
    pushDir = collideSpot - pushDir;
    pushDist = pushDir.Length();
-   pushDist += 0.1f;
+   pushDist += lineClearance;
    pushDir.Normalize();
    pushDir *= pushDist;
 
@@ -529,34 +802,45 @@ bool HandleLinevCircle(Line* line, Circle* circle, float pushPercent) {
 }
 
 bool HandleLinevBox(Line* line, Box* box, float pushPercent) {
-   vector<Point> normals;
-   vector<Point> shapeA;
-   vector<Point> shapeB;
+   FrameAllocator& scratch = ThreadFrameAllocator();
+   FrameAllocator::Marker marker = scratch.GetMarker();
+   bool collided = HandleLinevBox(line, box, pushPercent, scratch);
+   scratch.Rewind(marker);
+   return collided;
+}
+
+//------------------------------------------------------
+// Line vs box, with the SAT arrays in scratch memory
+//------------------------------------------------------
+bool HandleLinevBox(Line* line, Box* box, float pushPercent, FrameAllocator& scratch) {
+   Point* normals = scratch.AllocateArray<Point>(3);
+   Point* shapeA = scratch.AllocateArray<Point>(2);
+   Point* shapeB = scratch.AllocateArray<Point>(4);
    Point overlapDir;
    float x, y, overlap;
 
    // Add box normals
    box->Normal(0, x, y);
-   normals.push_back(Point(x, y));
+   normals[0] = Point(x, y);
    box->Normal(1, x, y);
-   normals.push_back(Point(x, y));
-   
+   normals[1] = Point(x, y);
+
    // Add line normals
    line->Normal(0, x, y);
-   normals.push_back(Point(x, y));
+   normals[2] = Point(x, y);
 
    // Add line points
-   shapeA.push_back(line->Start());
-   shapeA.push_back(line->End());
+   shapeA[0] = line->Start();
+   shapeA[1] = line->End();
 
    // Add box points
-   shapeB.push_back(box->TL());
-   shapeB.push_back(box->TR());
-   shapeB.push_back(box->BL());
-   shapeB.push_back(box->BR());
+   shapeB[0] = box->TL();
+   shapeB[1] = box->TR();
+   shapeB[2] = box->BL();
+   shapeB[3] = box->BR();
 
    // If they collide
-   if (SatOverlap(normals, shapeA, shapeB, overlapDir, overlap)) {
+   if (SatOverlap(normals, 3, shapeA, 2, shapeB, 4, overlapDir, overlap, scratch)) {
       // Pushing?
       if (pushPercent != -1.0f) {
          // Push line
@@ -652,47 +936,66 @@ bool HandleBoxvPoint(Box* box, Point* point, float pushPercent) {
 	return HandlePointvBox(point, box, (pushPercent < 0.0f ? pushPercent : 1.0f - pushPercent));
 }
 
+bool HandleBoxvPoint(Box* box, Point* point, float pushPercent, FrameAllocator& scratch) {
+   return HandlePointvBox(point, box, (pushPercent < 0.0f ? pushPercent : 1.0f - pushPercent), scratch);
+}
+
 bool HandleBoxvLine(Box* box, Line* line, float pushPercent) {
 	return HandleLinevBox(line, box, (pushPercent < 0.0f ? pushPercent : 1.0f - pushPercent));
 }
 
+bool HandleBoxvLine(Box* box, Line* line, float pushPercent, FrameAllocator& scratch) {
+   return HandleLinevBox(line, box, (pushPercent < 0.0f ? pushPercent : 1.0f - pushPercent), scratch);
+}
+
 bool HandleBoxvCircle(Box* box, Circle* circle, float pushPercent) {
 	return HandleCirclevBox(circle, box, (pushPercent < 0.0f ? pushPercent : 1.0f - pushPercent));
 }
 
 bool HandleBoxvBox(Box* boxA, Box* boxB, float pushPercent) {
+   FrameAllocator& scratch = ThreadFrameAllocator();
+   FrameAllocator::Marker marker = scratch.GetMarker();
+   bool collided = HandleBoxvBox(boxA, boxB, pushPercent, scratch);
+   scratch.Rewind(marker);
+   return collided;
+}
+
+//------------------------------------------------------
+// Box vs box, with the SAT arrays in scratch memory
+//------------------------------------------------------
+bool HandleBoxvBox(Box* boxA, Box* boxB, float pushPercent, FrameAllocator& scratch) {
    // Declare useful variables
-   vector<Point> normals;
-   vector<Point> shapeA;
-   vector<Point> shapeB;
+   Point* normals = scratch.AllocateArray<Point>(4);
+   Point* shapeA = scratch.AllocateArray<Point>(4);
+   Point* shapeB = scratch.AllocateArray<Point>(4);
    Point overlapDir;
    float overlap, x, y;
 
    // Add box A normals
    boxA->Normal(0, x, y);
-   normals.push_back(Point(x, y));
+   normals[0] = Point(x, y);
    boxA->Normal(1, x, y);
-   normals.push_back(Point(x, y));
+   normals[1] = Point(x, y);
 
    // Add box b normals
    boxB->Normal(0, x, y);
-   normals.push_back(Point(x, y));
+   normals[2] = Point(x, y);
    boxB->Normal(1, x, y);
-   normals.push_back(Point(x, y));
+   normals[3] = Point(x, y);
 
    // Add box A points
-   shapeA.push_back(boxA->TL());
-   shapeA.push_back(boxA->TR());
-   shapeA.push_back(boxA->BL());
-   shapeA.push_back(boxA->BR());
-   
+   shapeA[0] = boxA->TL();
+   shapeA[1] = boxA->TR();
+   shapeA[2] = boxA->BL();
+   shapeA[3] = boxA->BR();
+
    // Add box B points
-   shapeB.push_back(boxB->TL());
-   shapeB.push_back(boxB->TR());
-   shapeB.push_back(boxB->BL());
-   shapeB.push_back(boxB->BR());
+   shapeB[0] = boxB->TL();
+   shapeB[1] = boxB->TR();
+   shapeB[2] = boxB->BL();
+   shapeB[3] = boxB->BR();
 
-   if (SatOverlap(normals, shapeA, shapeB, overlapDir, overlap))
+   if (SatOverlap(normals, 4, shapeA, 4, shapeB, 4, overlapDir, overlap, scratch))
    {
       // Push the other first
       Point movement = overlapDir * (overlap * pushPercent);
@@ -702,4 +1005,4 @@ bool HandleBoxvBox(Box* boxA, Box* boxB, float pushPercent) {
       return true;
    }
    return false;
-}
\ No newline at end of file
+}
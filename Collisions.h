@@ -1,12 +1,16 @@
+#ifndef COLLISIONS_H_
+#define COLLISIONS_H_
+
 #include "CollisionStruct.h"
+#include "FrameAllocator.h"
 #include <vector>
 using std::vector;
 
-Point ClosestPointOnLine(Line& theLine, Point& testPoint, bool pointOnSegment = true);
+Point ClosestPointOnLine(const Line& theLine, const Point& testPoint, bool pointOnSegment = true);
 
-Point ClosestPointOnLine(Point& startPoint, Point& endPoint, Point& testPoint, bool pointOnSegment = true);
+Point ClosestPointOnLine(const Point& startPoint, const Point& endPoint, const Point& testPoint, bool pointOnSegment = true);
 
-Point GetNormalBetweenPoints(Point& fromPoint, Point& toPoint);
+Point GetNormalBetweenPoints(const Point& fromPoint, const Point& toPoint);
 
 float absValue(float value);
 
@@ -22,14 +26,65 @@ float minDistance(float& distance, float& min, float& max);
 
 bool SatOverlap(vector<Point> normals, vector<Point> pointsA, vector<Point> pointsB, Point &overlapDir, float& overlap);
 
+// Same as above, but on plain arrays, with any temporary memory coming from scratch
+void MinMax(const Point& normal, const Point* points, int pointCount, float& min, float& max);
+
+bool SatOverlap(const Point* normals, int normalCount, const Point* pointsA, int pointCountA,
+   const Point* pointsB, int pointCountB, Point& overlapDir, float& overlap, FrameAllocator& scratch);
+
+// Do the two shapes' filters allow them to collide?
+bool ShouldCollide(const Shape* objA, const Shape* objB);
+
+/*
+  Gets the push percent to hand HandleCollision so that objA
+  moves shareA of the way out, and objB moves the rest.
+  (The circle/box and box/box handlers push B by the percent
+  instead of A, so those pairs get flipped)
+*/
+float PushPercentFor(const Shape* objA, const Shape* objB, float shareA);
+
+// Gets the axis aligned bounds of any shape
+AABB ShapeBounds(Shape* shape);
+
+// Gets a circle around the whole shape
+void BoundingCircle(Shape* shape, float& x, float& y, float& radius);
+
+// Can the pair be thrown out on bounds alone? (HandleCollision
+// checks this before any of the pair tests)
+bool BoundsReject(Shape* objA, Shape* objB);
+
+/*
+  Counts of pairs HandleCollision tested, and how many the
+  bounds test threw out, by the pair's shape types. Each
+  thread has its own.
+*/
+struct CollisionStats
+{
+   unsigned int tests[NUM_SHAPES][NUM_SHAPES];
+   unsigned int rejects[NUM_SHAPES][NUM_SHAPES];
+
+   CollisionStats() { Reset(); }
+   void Reset();
+   float RejectRate(ShapeType typeA, ShapeType typeB) const;
+};
+
+CollisionStats& ThreadCollisionStats();
+
 /*
   Handles collisions between any two shapes.
+  Pairs rejected by the shapes' collision filters, or whose
+  bounds don't touch, return false without running any of
+  the pair tests.
   For the push percent, 0.0f means nothing can stop A
   1.0f means nothing can push B
   -1.0f means NO PUSHING FOR EITHER SIDE (collisions off, basically)
 */
 bool HandleCollision(Shape* objA, Shape* objB, float pushPercent = -1.0f);
 
+// Pushes a circle fully out of a fixed axis aligned box.
+// (For level geometry, where the box can never move)
+bool PushCircleOutOfAABB(Circle* circle, const AABB& bounds);
+
 // Point collisions
 bool HandlePointvPoint(Point* pointA, Point* pointB, float pushPercent);
 
@@ -39,6 +94,8 @@ bool HandlePointvCircle(Point* point, Circle* circle, float pushPercent);
 
 bool HandlePointvBox(Point* point, Box* rectangle, float pushPercent);
 
+bool HandlePointvBox(Point* point, Box* box, float pushPercent, FrameAllocator& scratch);
+
 // Line collisions
 bool HandleLinevPoint(Line* line, Point* point, float pushPercent);
 
@@ -48,6 +105,8 @@ bool HandleLinevCircle(Line* line, Circle* circle, float pushPercent);
 
 bool HandleLinevBox(Line* line, Box* box, float pushPercent);
 
+bool HandleLinevBox(Line* line, Box* box, float pushPercent, FrameAllocator& scratch);
+
 // Circle collisions
 bool HandleCirclevPoint(Circle* circle, Point* point, float pushPercent);
 
@@ -66,3 +125,16 @@ bool HandleBoxvCircle(Box* box, Circle* circle, float pushPercent);
 
 bool HandleBoxvBox(Box* boxA, Box* boxB, float pushPercent);
 
+/*
+  The box handlers above that do SAT, with all their temporary
+  arrays coming from a frame allocator instead of the heap.
+  (The plain versions use the calling thread's frame allocator,
+  and give the memory back before they return)
+*/
+bool HandleBoxvPoint(Box* box, Point* point, float pushPercent, FrameAllocator& scratch);
+
+bool HandleBoxvLine(Box* box, Line* line, float pushPercent, FrameAllocator& scratch);
+
+bool HandleBoxvBox(Box* boxA, Box* boxB, float pushPercent, FrameAllocator& scratch);
+
+#endif // COLLISIONS_H_
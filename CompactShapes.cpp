@@ -0,0 +1,364 @@
+#include "CompactShapes.h"
+
+// For floorf, sqrtf, sinf, cosf, fmodf
+#include <cmath>
+
+// How many shapes get unpacked at a time
+const int blockSize = 64;
+
+// Radians in one step of a packed angle
+const float angleStep = 6.28318530718f / 65536.0f;
+
+//------------------------------------------------------
+// Constructor
+//------------------------------------------------------
+CompactCrowd::CompactCrowd(float cellSize, float originX, float originY)
+{
+   this->cellSize = cellSize;
+   this->originX = originX;
+   this->originY = originY;
+   this->step = cellSize / 65536.0f;
+}
+
+//------------------------------------------------------
+// Packs a position into a cell and 16 bit offsets.
+// Anything outside the crowd's area is clamped to it
+// (the cell only has 8 bits each way).
+//------------------------------------------------------
+void CompactCrowd::Encode(float x, float y, unsigned short& encodedX, unsigned short& encodedY, unsigned short& cell) const
+{
+   float cellsX = (x - originX) / cellSize;
+   float cellsY = (y - originY) / cellSize;
+   if (cellsX < 0.0f) cellsX = 0.0f;
+   if (cellsY < 0.0f) cellsY = 0.0f;
+   if (cellsX >= 256.0f) cellsX = 255.99998f;
+   if (cellsY >= 256.0f) cellsY = 255.99998f;
+
+   int cellX = (int)floorf(cellsX);
+   int cellY = (int)floorf(cellsY);
+   float offsetX = (cellsX - cellX) * 65536.0f + 0.5f;
+   float offsetY = (cellsY - cellY) * 65536.0f + 0.5f;
+   encodedX = (unsigned short)(offsetX > 65535.0f ? 65535 : (int)offsetX);
+   encodedY = (unsigned short)(offsetY > 65535.0f ? 65535 : (int)offsetY);
+   cell = (unsigned short)(cellX | (cellY << 8));
+}
+
+//------------------------------------------------------
+// Packs a radius/half size, in the same steps as positions
+//------------------------------------------------------
+unsigned short CompactCrowd::EncodeLength(float length) const
+{
+   float steps = length / step + 0.5f;
+   if (steps < 0.0f) return 0;
+   if (steps > 65535.0f) return 65535;
+   return (unsigned short)steps;
+}
+
+//------------------------------------------------------
+// Adds a circle
+//------------------------------------------------------
+int CompactCrowd::AddCircle(const Circle& circle)
+{
+   unsigned short x, y, cell;
+   Encode(circle.CenterX(), circle.CenterY(), x, y, cell);
+   circleX.push_back(x);
+   circleY.push_back(y);
+   circleCell.push_back(cell);
+   circleRadius.push_back(EncodeLength(circle.Radius()));
+   return (int)circleX.size() - 1;
+}
+
+//------------------------------------------------------
+// Adds a box
+//------------------------------------------------------
+int CompactCrowd::AddBox(const Box& box)
+{
+   unsigned short x, y, cell;
+   Encode(box.Center().X(), box.Center().Y(), x, y, cell);
+   boxX.push_back(x);
+   boxY.push_back(y);
+   boxCell.push_back(cell);
+   boxHalfWidth.push_back(EncodeLength(box.Width() * 0.5f));
+   boxHalfHeight.push_back(EncodeLength(box.Height() * 0.5f));
+
+   float degrees = fmodf(box.Rotation(), 360.0f);
+   if (degrees < 0.0f) degrees += 360.0f;
+   boxAngle.push_back((unsigned short)((int)(degrees / 360.0f * 65536.0f + 0.5f) & 0xFFFF));
+   float radians = boxAngle.back() * angleStep;
+   boxSine.push_back(sinf(radians));
+   boxCosine.push_back(cosf(radians));
+   return (int)boxX.size() - 1;
+}
+
+//------------------------------------------------------
+// Removes everything
+//------------------------------------------------------
+void CompactCrowd::Clear()
+{
+   circleX.clear();
+   circleY.clear();
+   circleRadius.clear();
+   circleCell.clear();
+   boxX.clear();
+   boxY.clear();
+   boxHalfWidth.clear();
+   boxHalfHeight.clear();
+   boxAngle.clear();
+   boxCell.clear();
+   boxSine.clear();
+   boxCosine.clear();
+}
+
+//------------------------------------------------------
+// Unpacks a circle's center
+//------------------------------------------------------
+Point CompactCrowd::CirclePosition(int index) const
+{
+   return Point(DecodeX(circleX[index], circleCell[index]), DecodeY(circleY[index], circleCell[index]));
+}
+
+//------------------------------------------------------
+// Unpacks a box's center
+//------------------------------------------------------
+Point CompactCrowd::BoxPosition(int index) const
+{
+   return Point(DecodeX(boxX[index], boxCell[index]), DecodeY(boxY[index], boxCell[index]));
+}
+
+//------------------------------------------------------
+// Bytes used by the packed shapes
+//------------------------------------------------------
+size_t CompactCrowd::MemoryBytes() const
+{
+   return (circleX.size() * 4 + boxX.size() * 6) * sizeof(unsigned short) + boxX.size() * 2 * sizeof(float);
+}
+
+//------------------------------------------------------
+// Unpacks a circle
+//------------------------------------------------------
+Circle CompactCrowd::GetCircle(int index) const
+{
+   return Circle(CirclePosition(index), circleRadius[index] * step);
+}
+
+//------------------------------------------------------
+// Unpacks a box
+//------------------------------------------------------
+Box CompactCrowd::GetBox(int index) const
+{
+   return Box(BoxPosition(index), boxHalfWidth[index] * step * 2.0f, boxHalfHeight[index] * step * 2.0f, boxAngle[index] * (360.0f / 65536.0f));
+}
+
+//------------------------------------------------------
+// Moves a circle to a new position
+//------------------------------------------------------
+void CompactCrowd::CirclePosition(int index, const Point& position)
+{
+   Encode(position.X(), position.Y(), circleX[index], circleY[index], circleCell[index]);
+}
+
+//------------------------------------------------------
+// Moves a box to a new position
+//------------------------------------------------------
+void CompactCrowd::BoxPosition(int index, const Point& position)
+{
+   Encode(position.X(), position.Y(), boxX[index], boxY[index], boxCell[index]);
+}
+
+//------------------------------------------------------
+// Moves a circle by an amount
+//------------------------------------------------------
+void CompactCrowd::MoveCircle(int index, float x, float y)
+{
+   Point position = CirclePosition(index);
+   Encode(position.X() + x, position.Y() + y, circleX[index], circleY[index], circleCell[index]);
+}
+
+//------------------------------------------------------
+// Tests the probe against every circle, a block at a time
+//------------------------------------------------------
+int CompactCrowd::OverlapCircles(const Circle& probe, vector<int>& hits) const
+{
+   float probeX = probe.CenterX();
+   float probeY = probe.CenterY();
+   float probeRadius = probe.Radius();
+   int found = 0;
+
+   float distanceSquared[blockSize];
+   float reachSquared[blockSize];
+   int total = CircleCount();
+   for (int first = 0; first < total; first += blockSize) {
+      int count = (total - first < blockSize ? total - first : blockSize);
+
+      // Unpack and test in straight loops, no branches
+      for (int ii = 0; ii < count; ++ii) {
+         unsigned short cell = circleCell[first + ii];
+         float dx = DecodeX(circleX[first + ii], cell) - probeX;
+         float dy = DecodeY(circleY[first + ii], cell) - probeY;
+         float reach = circleRadius[first + ii] * step + probeRadius;
+         distanceSquared[ii] = dx * dx + dy * dy;
+         reachSquared[ii] = reach * reach;
+      }
+      for (int ii = 0; ii < count; ++ii) {
+         if (distanceSquared[ii] <= reachSquared[ii]) {
+            hits.push_back(first + ii);
+            ++found;
+         }
+      }
+   }
+   return found;
+}
+
+//------------------------------------------------------
+// Tests the probe against some of the circles
+//------------------------------------------------------
+int CompactCrowd::OverlapCircles(const Circle& probe, const int* candidates, int candidateCount, vector<int>& hits) const
+{
+   float probeX = probe.CenterX();
+   float probeY = probe.CenterY();
+   float probeRadius = probe.Radius();
+   int found = 0;
+
+   float distanceSquared[blockSize];
+   float reachSquared[blockSize];
+   for (int first = 0; first < candidateCount; first += blockSize) {
+      int count = (candidateCount - first < blockSize ? candidateCount - first : blockSize);
+
+      for (int ii = 0; ii < count; ++ii) {
+         int index = candidates[first + ii];
+         unsigned short cell = circleCell[index];
+         float dx = DecodeX(circleX[index], cell) - probeX;
+         float dy = DecodeY(circleY[index], cell) - probeY;
+         float reach = circleRadius[index] * step + probeRadius;
+         distanceSquared[ii] = dx * dx + dy * dy;
+         reachSquared[ii] = reach * reach;
+      }
+      for (int ii = 0; ii < count; ++ii) {
+         if (distanceSquared[ii] <= reachSquared[ii]) {
+            hits.push_back(candidates[first + ii]);
+            ++found;
+         }
+      }
+   }
+   return found;
+}
+
+//------------------------------------------------------
+// Tests the probe against every box. The probe's center
+// is turned into each box's space, then clamped to it.
+//------------------------------------------------------
+int CompactCrowd::OverlapBoxes(const Circle& probe, vector<int>& hits) const
+{
+   float probeX = probe.CenterX();
+   float probeY = probe.CenterY();
+   float radiusSquared = probe.RadiusSquared();
+   int found = 0;
+
+   float distanceSquared[blockSize];
+   int total = BoxCount();
+   for (int first = 0; first < total; first += blockSize) {
+      int count = (total - first < blockSize ? total - first : blockSize);
+
+      for (int ii = 0; ii < count; ++ii) {
+         int index = first + ii;
+         unsigned short cell = boxCell[index];
+         float dx = probeX - DecodeX(boxX[index], cell);
+         float dy = probeY - DecodeY(boxY[index], cell);
+         float sine = boxSine[index];
+         float cosine = boxCosine[index];
+         float localX = dx * cosine + dy * sine;
+         float localY = dy * cosine - dx * sine;
+         float halfWidth = boxHalfWidth[index] * step;
+         float halfHeight = boxHalfHeight[index] * step;
+         float outsideX = fabsf(localX) - halfWidth;
+         float outsideY = fabsf(localY) - halfHeight;
+         if (outsideX < 0.0f) outsideX = 0.0f;
+         if (outsideY < 0.0f) outsideY = 0.0f;
+         distanceSquared[ii] = outsideX * outsideX + outsideY * outsideY;
+      }
+      for (int ii = 0; ii < count; ++ii) {
+         if (distanceSquared[ii] <= radiusSquared) {
+            hits.push_back(first + ii);
+            ++found;
+         }
+      }
+   }
+   return found;
+}
+
+//------------------------------------------------------
+// Finds what the probe hits, then pushes it out of each
+// one in turn
+//------------------------------------------------------
+bool CompactCrowd::CollideCircle(Circle* probe, vector<int>& scratch) const
+{
+   vector<int>& hits = scratch;
+   hits.clear();
+   OverlapCircles(*probe, hits);
+   bool hit = !hits.empty();
+   for (unsigned int ii = 0; ii < hits.size(); ++ii) {
+      Point center = CirclePosition(hits[ii]);
+      float dx = probe->CenterX() - center.X();
+      float dy = probe->CenterY() - center.Y();
+      float reach = circleRadius[hits[ii]] * step + probe->Radius();
+      float distance = sqrtf(dx * dx + dy * dy);
+      if (distance > reach) {
+         // An earlier push already moved it clear
+         continue;
+      }
+      if (distance > 0.0f) {
+         probe->Move(dx / distance * (reach - distance), dy / distance * (reach - distance));
+      }
+      else {
+         probe->Move(reach, 0.0f);
+      }
+   }
+
+   hits.clear();
+   OverlapBoxes(*probe, hits);
+   hit = hit || !hits.empty();
+   for (unsigned int ii = 0; ii < hits.size(); ++ii) {
+      int index = hits[ii];
+      Point center = BoxPosition(index);
+      float dx = probe->CenterX() - center.X();
+      float dy = probe->CenterY() - center.Y();
+      float sine = boxSine[index];
+      float cosine = boxCosine[index];
+      float localX = dx * cosine + dy * sine;
+      float localY = dy * cosine - dx * sine;
+      float halfWidth = boxHalfWidth[index] * step;
+      float halfHeight = boxHalfHeight[index] * step;
+
+      // Work out the push in the box's space
+      float pushX = 0.0f;
+      float pushY = 0.0f;
+      float closestX = (localX < -halfWidth ? -halfWidth : (localX > halfWidth ? halfWidth : localX));
+      float closestY = (localY < -halfHeight ? -halfHeight : (localY > halfHeight ? halfHeight : localY));
+      float awayX = localX - closestX;
+      float awayY = localY - closestY;
+      float distance = sqrtf(awayX * awayX + awayY * awayY);
+      if (distance > 0.0f) {
+         if (distance > probe->Radius()) {
+            continue;
+         }
+         pushX = awayX / distance * (probe->Radius() - distance);
+         pushY = awayY / distance * (probe->Radius() - distance);
+      }
+      else {
+         // Center is inside, leave through the closest side
+         float exitX = halfWidth - fabsf(localX);
+         float exitY = halfHeight - fabsf(localY);
+         if (exitX < exitY) {
+            pushX = (localX < 0.0f ? -1.0f : 1.0f) * (exitX + probe->Radius());
+         }
+         else {
+            pushY = (localY < 0.0f ? -1.0f : 1.0f) * (exitY + probe->Radius());
+         }
+      }
+
+      // Back to world space
+      probe->Move(pushX * cosine - pushY * sine, pushX * sine + pushY * cosine);
+   }
+
+   return hit;
+}
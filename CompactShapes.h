@@ -0,0 +1,96 @@
+#ifndef COMPACTSHAPES_H_
+#define COMPACTSHAPES_H_
+
+#include "Collisions.h"
+
+   //------------------------------------------------------
+   // Big crowds of circles and boxes, packed small.
+   //
+   // The world is split into square cells. Positions are
+   // 16 bits across a cell, plus which cell (8 bits of x
+   // and 8 bits of y, from the crowd's origin), so a
+   // position is good to cellSize / 65536. Radii and half
+   // sizes use the same steps, and box angles are 16 bits
+   // of a turn. Anything outside the crowd's 256 x 256
+   // cells is clamped onto its edge, so keep the crowd
+   // inside them.
+   //
+   // A circle is 8 bytes, a box 20 (12, plus the sine and
+   // cosine of its angle so the tests don't work them out
+   // every time), against 40+ for a Circle or Box.
+   // Everything is kept as arrays of each field, and the
+   // batch tests unpack a block at a time into plain float
+   // arrays, so sweeping the whole crowd reads far less
+   // memory and the loops vectorise.
+   //------------------------------------------------------
+   class CompactCrowd
+   {
+   private:
+      // Circles, 8 bytes each
+      vector<unsigned short> circleX;
+      vector<unsigned short> circleY;
+      vector<unsigned short> circleRadius;
+      vector<unsigned short> circleCell;
+
+      // Boxes, 20 bytes each
+      vector<unsigned short> boxX;
+      vector<unsigned short> boxY;
+      vector<unsigned short> boxHalfWidth;
+      vector<unsigned short> boxHalfHeight;
+      vector<unsigned short> boxAngle;
+      vector<unsigned short> boxCell;
+      vector<float> boxSine;
+      vector<float> boxCosine;
+
+      float originX;
+      float originY;
+      float cellSize;
+      float step;
+
+      void Encode(float x, float y, unsigned short& encodedX, unsigned short& encodedY, unsigned short& cell) const;
+      float DecodeX(unsigned short x, unsigned short cell) const { return originX + (cell & 0xFF) * cellSize + x * step; }
+      float DecodeY(unsigned short y, unsigned short cell) const { return originY + (cell >> 8) * cellSize + y * step; }
+      unsigned short EncodeLength(float length) const;
+
+   public:
+      // The crowd covers 256 x 256 cells from the origin
+      CompactCrowd(float cellSize = 1024.0f, float originX = 0.0f, float originY = 0.0f);
+
+      // Adds a shape, returns its index. Positions off the crowd are clamped onto it.
+      int AddCircle(const Circle& circle);
+      int AddBox(const Box& box);
+      void Clear();
+
+      // Accessors
+      int CircleCount() const { return (int)circleX.size(); }
+      int BoxCount() const { return (int)boxX.size(); }
+      float CellSize() const { return cellSize; }
+      float Precision() const { return step; }
+      Point CirclePosition(int index) const;
+      Point BoxPosition(int index) const;
+      size_t MemoryBytes() const;
+
+      // Unpacks into a full shape
+      Circle GetCircle(int index) const;
+      Box GetBox(int index) const;
+
+      // Mutators
+      void CirclePosition(int index, const Point& position);
+      void BoxPosition(int index, const Point& position);
+      void MoveCircle(int index, float x, float y);
+
+      // Batch narrowphase. Finds every crowd circle/box the
+      // probe overlaps. Returns how many were found.
+      int OverlapCircles(const Circle& probe, vector<int>& hits) const;
+      int OverlapBoxes(const Circle& probe, vector<int>& hits) const;
+      // The same, for just the candidates a broadphase found
+      int OverlapCircles(const Circle& probe, const int* candidates, int count, vector<int>& hits) const;
+
+      // Pushes the probe out of the crowd. The crowd doesn't
+      // move. Returns true if anything was hit. The hits go
+      // in scratch: keep one per thread and reuse it, and it
+      // stops allocating.
+      bool CollideCircle(Circle* probe, vector<int>& scratch) const;
+   };
+
+#endif // COMPACTSHAPES_H_
@@ -0,0 +1,506 @@
+#include "Compound.h"
+#include "DeterministicTrig.h"
+
+// For nth_element
+#include <algorithm>
+// For sqrtf, sin, cos
+#include <cmath>
+
+const float pi = 3.14159265358f;
+
+// How many children a leaf can hold
+const int compoundLeafSize = 2;
+
+//------------------------------------------------------
+// Where a shape is, as far as moving it goes: whatever
+// the handlers push (a line's start, everything else's
+// center)
+//------------------------------------------------------
+Point ShapeAnchor(Shape* shape)
+{
+   switch (shape->Type()) {
+      case SHAPE_POINT: return *static_cast<Point*>(shape);
+      case LINE: return static_cast<Line*>(shape)->Start();
+      case CIRCLE: return static_cast<Circle*>(shape)->Center();
+      case BOX: return static_cast<Box*>(shape)->Center();
+      default: return Point(0.0f, 0.0f);
+   }
+}
+
+//------------------------------------------------------
+// Grows the bounds to take in another box (the first one
+// replaces them)
+//------------------------------------------------------
+void GrowBounds(AABB& bounds, const AABB& current, bool& first)
+{
+   if (first) {
+      bounds = current;
+      first = false;
+      return;
+   }
+   if (current.minX < bounds.minX) bounds.minX = current.minX;
+   if (current.minY < bounds.minY) bounds.minY = current.minY;
+   if (current.maxX > bounds.maxX) bounds.maxX = current.maxX;
+   if (current.maxY > bounds.maxY) bounds.maxY = current.maxY;
+}
+
+//------------------------------------------------------
+// Constructor
+//------------------------------------------------------
+Compound::Compound(float x, float y, float rotation)
+   : x(x), y(y), rotation(rotation), boundingRadius(0.0f), treeDirty(true),
+     sine(0.0f), cosine(1.0f), cacheVersion(~0u)
+{
+   this->shapeType = COMPOUND;
+}
+
+//------------------------------------------------------
+// Copy Constructor. The version comes along too, so
+// whatever the other compound has worked out is still good.
+//------------------------------------------------------
+Compound::Compound(const Compound& rhs)
+   : Shape(rhs), x(rhs.x), y(rhs.y), rotation(rhs.rotation), children(rhs.children),
+     localPoints(rhs.localPoints), localLines(rhs.localLines), localCircles(rhs.localCircles), localBoxes(rhs.localBoxes),
+     childBounds(rhs.childBounds), order(rhs.order), nodes(rhs.nodes), boundingRadius(rhs.boundingRadius), treeDirty(rhs.treeDirty),
+     worldPoints(rhs.worldPoints), worldLines(rhs.worldLines), worldCircles(rhs.worldCircles), worldBoxes(rhs.worldBoxes),
+     sine(rhs.sine), cosine(rhs.cosine), bounds(rhs.bounds), cacheVersion(rhs.cacheVersion)
+{
+}
+
+//------------------------------------------------------
+// Assignment Operator. The version moves on, so the
+// world space cache only carries over if it was current.
+//------------------------------------------------------
+Compound& Compound::operator=(const Compound& rhs)
+{
+   if (this != &rhs) {
+      bool current = (rhs.cacheVersion == rhs.version);
+      Shape::operator=(rhs);
+      x = rhs.x;
+      y = rhs.y;
+      rotation = rhs.rotation;
+      children = rhs.children;
+      localPoints = rhs.localPoints;
+      localLines = rhs.localLines;
+      localCircles = rhs.localCircles;
+      localBoxes = rhs.localBoxes;
+      childBounds = rhs.childBounds;
+      order = rhs.order;
+      nodes = rhs.nodes;
+      boundingRadius = rhs.boundingRadius;
+      treeDirty = rhs.treeDirty;
+      worldPoints = rhs.worldPoints;
+      worldLines = rhs.worldLines;
+      worldCircles = rhs.worldCircles;
+      worldBoxes = rhs.worldBoxes;
+      sine = rhs.sine;
+      cosine = rhs.cosine;
+      bounds = rhs.bounds;
+      cacheVersion = (current ? version : ~0u);
+   }
+   return *this;
+}
+
+//------------------------------------------------------
+// Adding children
+//------------------------------------------------------
+void Compound::ChildAdded(ShapeType type, int slot)
+{
+   Child child;
+   child.type = type;
+   child.slot = slot;
+   children.push_back(child);
+   treeDirty = true;
+   Changed();
+}
+
+int Compound::AddChild(const Point& point)
+{
+   localPoints.push_back(point);
+   ChildAdded(SHAPE_POINT, (int)localPoints.size() - 1);
+   return ChildCount() - 1;
+}
+
+int Compound::AddChild(const Line& line)
+{
+   localLines.push_back(line);
+   ChildAdded(LINE, (int)localLines.size() - 1);
+   return ChildCount() - 1;
+}
+
+int Compound::AddChild(const Circle& circle)
+{
+   localCircles.push_back(circle);
+   ChildAdded(CIRCLE, (int)localCircles.size() - 1);
+   return ChildCount() - 1;
+}
+
+int Compound::AddChild(const Box& box)
+{
+   localBoxes.push_back(box);
+   ChildAdded(BOX, (int)localBoxes.size() - 1);
+   return ChildCount() - 1;
+}
+
+void Compound::ClearChildren()
+{
+   children.clear();
+   localPoints.clear();
+   localLines.clear();
+   localCircles.clear();
+   localBoxes.clear();
+   treeDirty = true;
+   Changed();
+}
+
+//------------------------------------------------------
+// Gets a child, in world space or as it was added
+//------------------------------------------------------
+Shape* Compound::GetChild(int index) const
+{
+   Refresh();
+   const Child& child = children[index];
+   switch (child.type) {
+      case SHAPE_POINT: return &worldPoints[child.slot];
+      case LINE: return &worldLines[child.slot];
+      case CIRCLE: return &worldCircles[child.slot];
+      case BOX: return &worldBoxes[child.slot];
+      default: return 0;
+   }
+}
+
+const Shape* Compound::GetLocalChild(int index) const
+{
+   const Child& child = children[index];
+   switch (child.type) {
+      case SHAPE_POINT: return &localPoints[child.slot];
+      case LINE: return &localLines[child.slot];
+      case CIRCLE: return &localCircles[child.slot];
+      case BOX: return &localBoxes[child.slot];
+      default: return 0;
+   }
+}
+
+//------------------------------------------------------
+// Sorts children along an axis by the middle of their bounds
+//------------------------------------------------------
+struct ChildCenterLess
+{
+   const vector<AABB>* bounds;
+   bool xAxis;
+   bool operator()(int a, int b) const {
+      const AABB& boundsA = (*bounds)[a];
+      const AABB& boundsB = (*bounds)[b];
+      return (xAxis ? (boundsA.minX + boundsA.maxX) < (boundsB.minX + boundsB.maxX)
+         : (boundsA.minY + boundsA.maxY) < (boundsB.minY + boundsB.maxY));
+   }
+};
+
+//------------------------------------------------------
+// Builds the tree over the children, in the compound's
+// own space, and the circle that holds them all
+//------------------------------------------------------
+void Compound::BuildTree() const
+{
+   childBounds.resize(children.size());
+   order.resize(children.size());
+   boundingRadius = 0.0f;
+   for (unsigned int ii = 0; ii < children.size(); ++ii) {
+      Shape* child = const_cast<Shape*>(GetLocalChild((int)ii));
+      childBounds[ii] = ShapeBounds(child);
+      order[ii] = (int)ii;
+
+      float childX, childY, childRadius;
+      BoundingCircle(child, childX, childY, childRadius);
+      float reach = sqrtf(childX * childX + childY * childY) + childRadius;
+      if (reach > boundingRadius) {
+         boundingRadius = reach;
+      }
+   }
+
+   nodes.clear();
+   if (children.size() > 0) {
+      nodes.reserve(children.size() * 2 / compoundLeafSize + 1);
+      BuildNode(0, (int)children.size());
+   }
+   treeDirty = false;
+}
+
+//------------------------------------------------------
+// Builds the node for a run of the child order (and all
+// of its children). Returns the node's index.
+//------------------------------------------------------
+int Compound::BuildNode(int first, int count) const
+{
+   int nodeIndex = (int)nodes.size();
+   nodes.push_back(CompoundNode());
+
+   AABB nodeBounds = childBounds[order[first]];
+   for (int ii = first + 1; ii < first + count; ++ii) {
+      const AABB& current = childBounds[order[ii]];
+      if (current.minX < nodeBounds.minX) nodeBounds.minX = current.minX;
+      if (current.minY < nodeBounds.minY) nodeBounds.minY = current.minY;
+      if (current.maxX > nodeBounds.maxX) nodeBounds.maxX = current.maxX;
+      if (current.maxY > nodeBounds.maxY) nodeBounds.maxY = current.maxY;
+   }
+   nodes[nodeIndex].bounds = nodeBounds;
+   nodes[nodeIndex].first = first;
+   nodes[nodeIndex].count = count;
+   nodes[nodeIndex].right = -1;
+
+   if (count > compoundLeafSize) {
+      // Split down the middle of the longest side
+      ChildCenterLess less;
+      less.bounds = &childBounds;
+      less.xAxis = (nodeBounds.maxX - nodeBounds.minX) >= (nodeBounds.maxY - nodeBounds.minY);
+      int half = count / 2;
+      std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, less);
+
+      // Left child is always the next node
+      BuildNode(first, half);
+      int right = BuildNode(first + half, count - half);
+      nodes[nodeIndex].right = right;
+   }
+   return nodeIndex;
+}
+
+//------------------------------------------------------
+// Puts every child where it is in the world. Growing the
+// bounds at the end asks every child for its own, so
+// their caches are all current when this is done.
+//------------------------------------------------------
+void Compound::UpdateCache() const
+{
+   if (treeDirty) {
+      BuildTree();
+   }
+
+#ifdef COLLISIONS_DETERMINISTIC
+   sine = DeterministicSin(rotation);
+   cosine = DeterministicCos(rotation);
+#else
+   float radians = rotation * pi / 180.0f;
+   sine = (float)sin(radians);
+   cosine = (float)cos(radians);
+#endif
+
+   worldPoints.resize(localPoints.size());
+   for (unsigned int ii = 0; ii < localPoints.size(); ++ii) {
+      const Point& local = localPoints[ii];
+      worldPoints[ii] = Point(x + local.X() * cosine - local.Y() * sine, y + local.X() * sine + local.Y() * cosine);
+   }
+
+   worldLines.resize(localLines.size());
+   for (unsigned int ii = 0; ii < localLines.size(); ++ii) {
+      const Line& local = localLines[ii];
+      worldLines[ii] = Line(x + local.StartX() * cosine - local.StartY() * sine, y + local.StartX() * sine + local.StartY() * cosine,
+         x + local.EndX() * cosine - local.EndY() * sine, y + local.EndX() * sine + local.EndY() * cosine);
+   }
+
+   worldCircles.resize(localCircles.size());
+   for (unsigned int ii = 0; ii < localCircles.size(); ++ii) {
+      const Circle& local = localCircles[ii];
+      worldCircles[ii] = Circle(x + local.CenterX() * cosine - local.CenterY() * sine,
+         y + local.CenterX() * sine + local.CenterY() * cosine, local.Radius());
+   }
+
+   // Unturned boxes are just slid along, so no trig is done for them
+   worldBoxes.resize(localBoxes.size());
+   for (unsigned int ii = 0; ii < localBoxes.size(); ++ii) {
+      const Box& local = localBoxes[ii];
+      if (rotation == 0.0f) {
+         worldBoxes[ii] = local;
+         worldBoxes[ii].Move(x, y);
+      }
+      else {
+         Point center = local.Center();
+         worldBoxes[ii] = Box(Point(x + center.X() * cosine - center.Y() * sine, y + center.X() * sine + center.Y() * cosine),
+            local.Width(), local.Height(), local.Rotation() + rotation);
+      }
+   }
+
+   // With no children, it's just a spot
+   bounds = AABB(x, y, x, y);
+   bool first = true;
+   for (unsigned int ii = 0; ii < worldPoints.size(); ++ii) GrowBounds(bounds, worldPoints[ii].Bounds(), first);
+   for (unsigned int ii = 0; ii < worldLines.size(); ++ii) GrowBounds(bounds, worldLines[ii].Bounds(), first);
+   for (unsigned int ii = 0; ii < worldCircles.size(); ++ii) GrowBounds(bounds, worldCircles[ii].Bounds(), first);
+   for (unsigned int ii = 0; ii < worldBoxes.size(); ++ii) GrowBounds(bounds, worldBoxes[ii].Bounds(), first);
+   cacheVersion = version;
+}
+
+//------------------------------------------------------
+// Slides the compound along. If the children were up to
+// date they're slid along too, instead of being worked
+// out again. Either way every child's own cache is left
+// current (asking for its bounds does that), so copies
+// read on other threads never have to fill one in.
+//------------------------------------------------------
+void Compound::Move(float x, float y)
+{
+   bool current = (cacheVersion == version);
+   this->x += x;
+   this->y += y;
+   Changed();
+
+   if (current) {
+      for (unsigned int ii = 0; ii < worldPoints.size(); ++ii) worldPoints[ii].Move(x, y);
+      for (unsigned int ii = 0; ii < worldLines.size(); ++ii) { worldLines[ii].Move(x, y); worldLines[ii].Bounds(); }
+      for (unsigned int ii = 0; ii < worldCircles.size(); ++ii) { worldCircles[ii].Move(x, y); worldCircles[ii].Bounds(); }
+      for (unsigned int ii = 0; ii < worldBoxes.size(); ++ii) { worldBoxes[ii].Move(x, y); worldBoxes[ii].Bounds(); }
+      bounds.minX += x;
+      bounds.minY += y;
+      bounds.maxX += x;
+      bounds.maxY += y;
+      cacheVersion = version;
+   }
+}
+
+//------------------------------------------------------
+// Into the compound's space: back off the position, then
+// turn the other way
+//------------------------------------------------------
+void Compound::ToLocal(float worldX, float worldY, float& localX, float& localY) const
+{
+   Refresh();
+   float dx = worldX - x;
+   float dy = worldY - y;
+   localX = dx * cosine + dy * sine;
+   localY = dy * cosine - dx * sine;
+}
+
+//------------------------------------------------------
+// The box around a turned box is as wide as both of its
+// sides' shadows on that axis
+//------------------------------------------------------
+AABB Compound::ToLocal(const AABB& area) const
+{
+   float centerX, centerY;
+   ToLocal((area.minX + area.maxX) * 0.5f, (area.minY + area.maxY) * 0.5f, centerX, centerY);
+   float halfWidth = (area.maxX - area.minX) * 0.5f;
+   float halfHeight = (area.maxY - area.minY) * 0.5f;
+   float absCosine = absValue(cosine);
+   float absSine = absValue(sine);
+   float localHalfWidth = halfWidth * absCosine + halfHeight * absSine;
+   float localHalfHeight = halfWidth * absSine + halfHeight * absCosine;
+   return AABB(centerX - localHalfWidth, centerY - localHalfHeight, centerX + localHalfWidth, centerY + localHalfHeight);
+}
+
+//------------------------------------------------------
+// Finds every child whose bounds touch the area
+//------------------------------------------------------
+void Compound::Query(const AABB& area, vector<int>& results) const
+{
+   if (NodeCount() == 0) {
+      return;
+   }
+
+   AABB localArea = ToLocal(area);
+   int stack[64];
+   int stackSize = 0;
+   stack[stackSize++] = 0;
+
+   while (stackSize > 0) {
+      int nodeIndex = stack[--stackSize];
+      const CompoundNode& node = nodes[nodeIndex];
+      if (!node.bounds.Overlaps(localArea)) {
+         continue;
+      }
+
+      if (node.right < 0) {
+         for (int ii = node.first; ii < node.first + node.count; ++ii) {
+            if (childBounds[order[ii]].Overlaps(localArea)) {
+               results.push_back(order[ii]);
+            }
+         }
+      }
+      else {
+         stack[stackSize++] = node.right;
+         stack[stackSize++] = nodeIndex + 1;
+      }
+   }
+}
+
+//------------------------------------------------------
+// One child against the shape. The test runs on a copy
+// of the child, and however far the copy got pushed, the
+// whole compound goes.
+//------------------------------------------------------
+bool CollideChild(Shape* shape, Compound* compound, int index, float pushPercent)
+{
+   Shape* child = compound->GetChild(index);
+   Point point;
+   Line line;
+   Circle circle;
+   Box box;
+   Shape* copy = 0;
+   switch (child->Type()) {
+      case SHAPE_POINT: point = *static_cast<Point*>(child); copy = &point; break;
+      case LINE: line = *static_cast<Line*>(child); copy = &line; break;
+      case CIRCLE: circle = *static_cast<Circle*>(child); copy = &circle; break;
+      case BOX: box = *static_cast<Box*>(child); copy = &box; break;
+      default: return false;
+   }
+   copy->Filter(compound->Filter());
+
+   Point before = ShapeAnchor(copy);
+   if (!HandleCollision(shape, copy, pushPercent < 0.0f ? pushPercent : PushPercentFor(shape, copy, pushPercent))) {
+      return false;
+   }
+
+   Point after = ShapeAnchor(copy);
+   if (after.X() != before.X() || after.Y() != before.Y()) {
+      compound->Move(after.X() - before.X(), after.Y() - before.Y());
+   }
+   return true;
+}
+
+//------------------------------------------------------
+// Walks the compound's tree with the shape's bounds
+// brought into its space, and collides the shape with each
+// child it reaches in turn
+//------------------------------------------------------
+bool HandleShapevCompound(Shape* shape, Compound* compound, float pushPercent)
+{
+   if (shape == 0 || compound == 0 || shape == compound || compound->NodeCount() == 0) {
+      return false;
+   }
+
+   AABB area = compound->ToLocal(ShapeBounds(shape));
+   int stack[64];
+   int stackSize = 0;
+   stack[stackSize++] = 0;
+
+   bool collided = false;
+   while (stackSize > 0) {
+      int nodeIndex = stack[--stackSize];
+      const CompoundNode& node = compound->Node(nodeIndex);
+      if (!node.bounds.Overlaps(area)) {
+         continue;
+      }
+
+      if (node.right >= 0) {
+         stack[stackSize++] = node.right;
+         stack[stackSize++] = nodeIndex + 1;
+         continue;
+      }
+
+      for (int ii = node.first; ii < node.first + node.count; ++ii) {
+         int child = compound->OrderedChild(ii);
+         if (!compound->LocalBounds(child).Overlaps(area)) {
+            continue;
+         }
+         if (!CollideChild(shape, compound, child, pushPercent)) {
+            continue;
+         }
+
+         collided = true;
+         if (pushPercent < 0.0f) {
+            return true;
+         }
+         // Later children see where this push left things
+         area = compound->ToLocal(ShapeBounds(shape));
+      }
+   }
+   return collided;
+}
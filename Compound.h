@@ -0,0 +1,144 @@
+#ifndef COMPOUND_H_
+#define COMPOUND_H_
+
+#include "Collisions.h"
+
+   //------------------------------------------------------
+   // A node in a compound's tree, in the compound's own
+   // space. Leaves point at a run of the child order, inner
+   // nodes at their two children (the left child is always
+   // right after its parent).
+   //------------------------------------------------------
+   struct CompoundNode
+   {
+      AABB bounds;
+      int first;
+      int count;
+      // Inner: the right child. Leaf: -1
+      int right;
+   };
+
+   //------------------------------------------------------
+   // A handful of shapes that always move together, like
+   // the boxes and circles making up a vehicle.
+   //
+   // Children are added in the compound's own space, around
+   // its origin, and the whole thing has one position and
+   // rotation (in degrees, like Box's). It's one proxy in the
+   // broadphase. The tree over the children is built in the
+   // compound's own space, so moving or turning it never
+   // touches the tree; other shapes are brought into that
+   // space instead, and only the children whose bounds they
+   // touch are ever tested.
+   //
+   // The children in world space are worked out when they're
+   // first asked for after a change. Moving only slides them
+   // along; turning works them all out again.
+   //
+   // Children can be points, lines, circles and boxes. They
+   // all collide with the compound's filter.
+   //------------------------------------------------------
+   class Compound : public Shape
+   {
+   private:
+      struct Child
+      {
+         ShapeType type;
+         // Where it is in its type's list
+         int slot;
+      };
+
+      float x;
+      float y;
+      float rotation;
+
+      vector<Child> children;
+      vector<Point> localPoints;
+      vector<Line> localLines;
+      vector<Circle> localCircles;
+      vector<Box> localBoxes;
+
+      // The tree, rebuilt when the children change
+      mutable vector<AABB> childBounds;
+      mutable vector<int> order;
+      mutable vector<CompoundNode> nodes;
+      mutable float boundingRadius;
+      mutable bool treeDirty;
+
+      // World space, rebuilt when the compound moves or turns
+      mutable vector<Point> worldPoints;
+      mutable vector<Line> worldLines;
+      mutable vector<Circle> worldCircles;
+      mutable vector<Box> worldBoxes;
+      mutable float sine;
+      mutable float cosine;
+      mutable AABB bounds;
+      mutable unsigned int cacheVersion;
+
+      void Refresh() const { if (cacheVersion != version) UpdateCache(); }
+      void UpdateCache() const;
+      void BuildTree() const;
+      int BuildNode(int first, int count) const;
+      void ChildAdded(ShapeType type, int slot);
+
+   public:
+      Compound(float x = 0.0f, float y = 0.0f, float rotation = 0.0f);
+
+      // Copy Constructor
+      Compound(const Compound& rhs);
+
+      // Assignment Operator
+      Compound& operator=(const Compound& rhs);
+
+      // Adding children, in the compound's space. Returns the child's index.
+      int AddChild(const Point& point);
+      int AddChild(const Line& line);
+      int AddChild(const Circle& circle);
+      int AddChild(const Box& box);
+      void ClearChildren();
+
+      // Accessors
+      float X() const { return x; }
+      float Y() const { return y; }
+      float Rotation() const { return rotation; }
+      int ChildCount() const { return (int)children.size(); }
+      // A child where it is in the world (don't move it)
+      Shape* GetChild(int index) const;
+      // A child as it was added
+      const Shape* GetLocalChild(int index) const;
+      const AABB& Bounds() const { Refresh(); return bounds; }
+      // Around the compound's position, taking in every child
+      float BoundingRadius() const { Refresh(); return boundingRadius; }
+      int NodeCount() const { Refresh(); return (int)nodes.size(); }
+      const CompoundNode& Node(int index) const { Refresh(); return nodes[index]; }
+      // Which child is at a spot in the tree's order, and its bounds in the compound's space
+      int OrderedChild(int index) const { Refresh(); return order[index]; }
+      const AABB& LocalBounds(int child) const { Refresh(); return childBounds[child]; }
+
+      // Brings a spot, or the box around an area, into the compound's space
+      void ToLocal(float worldX, float worldY, float& localX, float& localY) const;
+      AABB ToLocal(const AABB& area) const;
+
+      // Mutators
+      void Position(float x, float y) { this->x = x; this->y = y; Changed(); }
+      void Rotation(float rotation) { this->rotation = rotation; Changed(); }
+      void Move(float x, float y);
+
+      // Finds every child whose bounds touch the area (in world space)
+      void Query(const AABB& area, vector<int>& results) const;
+   };
+
+   /*
+     Collides a shape against a compound's children. The
+     shape moves pushPercent of the way out and the compound
+     the rest, as one (or nobody moves, for a negative
+     percent). Only children whose bounds touch the shape's
+     are tested, each with the usual pair test.
+   */
+   bool HandleShapevCompound(Shape* shape, Compound* compound, float pushPercent);
+
+   inline bool HandleCompoundvShape(Compound* compound, Shape* shape, float pushPercent) {
+      return HandleShapevCompound(shape, compound, pushPercent < 0.0f ? pushPercent : 1.0f - pushPercent);
+   }
+
+#endif // COMPOUND_H_
@@ -0,0 +1,127 @@
+#include "ContactEvents.h"
+
+// For memcpy
+#include <cstring>
+
+//------------------------------------------------------
+// Constructor. Every slot starts out "never written".
+//------------------------------------------------------
+ContactEventRing::ContactEventRing(int capacity)
+{
+   unsigned long long size = 1;
+   while (size < (unsigned long long)capacity) {
+      size <<= 1;
+   }
+   mask = size - 1;
+   slots = new Slot[size];
+   for (unsigned long long ii = 0; ii < size; ++ii) {
+      slots[ii].sequence.store(0, std::memory_order_relaxed);
+   }
+   published.store(0, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------
+// Destructor
+//------------------------------------------------------
+ContactEventRing::~ContactEventRing()
+{
+   delete[] slots;
+}
+
+//------------------------------------------------------
+// Writes the event into the next slot. A slot holding
+// event n has sequence 2n + 2, and 2n + 1 while it's
+// being written.
+//------------------------------------------------------
+void ContactEventRing::Publish(const ContactEvent& event)
+{
+   unsigned long long sequence = published.load(std::memory_order_relaxed);
+   Slot& slot = slots[sequence & mask];
+
+   unsigned int words[eventWords] = {};
+   memcpy(words, &event, sizeof(ContactEvent));
+
+   slot.sequence.store(2 * sequence + 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+   for (int ii = 0; ii < eventWords; ++ii) {
+      slot.words[ii].store(words[ii], std::memory_order_relaxed);
+   }
+   slot.sequence.store(2 * sequence + 2, std::memory_order_release);
+   published.store(sequence + 1, std::memory_order_release);
+}
+
+//------------------------------------------------------
+// Copies an event out, then checks the slot wasn't
+// touched while it was being copied
+//------------------------------------------------------
+bool ContactEventRing::Read(unsigned long long sequence, ContactEvent& event) const
+{
+   const Slot& slot = slots[sequence & mask];
+   unsigned long long before = slot.sequence.load(std::memory_order_acquire);
+   if (before != 2 * sequence + 2) {
+      return false;
+   }
+
+   unsigned int words[eventWords];
+   for (int ii = 0; ii < eventWords; ++ii) {
+      words[ii] = slot.words[ii].load(std::memory_order_relaxed);
+   }
+   std::atomic_thread_fence(std::memory_order_acquire);
+   if (slot.sequence.load(std::memory_order_relaxed) != before) {
+      return false;
+   }
+
+   memcpy(&event, words, sizeof(ContactEvent));
+   return true;
+}
+
+//------------------------------------------------------
+// Constructor
+//------------------------------------------------------
+ContactEventReader::ContactEventReader(const ContactEventRing& ring)
+{
+   this->ring = &ring;
+   this->next = ring.Published();
+   this->missed = 0;
+}
+
+//------------------------------------------------------
+// Gets the next event. If the writer has lapped us,
+// skips to the oldest event still in the ring.
+//------------------------------------------------------
+bool ContactEventReader::Next(ContactEvent& event)
+{
+   while (true) {
+      unsigned long long published = ring->Published();
+      if (next >= published) {
+         return false;
+      }
+
+      unsigned long long oldest = (published > (unsigned long long)ring->Capacity() ? published - ring->Capacity() : 0);
+      if (next < oldest) {
+         missed += oldest - next;
+         next = oldest;
+      }
+
+      if (ring->Read(next, event)) {
+         ++next;
+         return true;
+      }
+
+      // Written over while we were reading it
+      ++missed;
+      ++next;
+   }
+}
+
+//------------------------------------------------------
+// Reads a bunch of events at once
+//------------------------------------------------------
+int ContactEventReader::Read(ContactEvent* events, int maxEvents)
+{
+   int count = 0;
+   while (count < maxEvents && Next(events[count])) {
+      ++count;
+   }
+   return count;
+}
@@ -0,0 +1,106 @@
+#ifndef CONTACTEVENTS_H_
+#define CONTACTEVENTS_H_
+
+#include <atomic>
+
+   //------------------------------------------------------
+   // Two shapes started or stopped touching
+   //------------------------------------------------------
+   struct ContactEvent
+   {
+      // Proxy ids in the world, proxyA < proxyB
+      int proxyA;
+      int proxyB;
+      // true when they start touching, false when they stop
+      bool began;
+      // For began events: how far, and which way (from A to B),
+      // the pair had to be pushed apart. There are no masses or
+      // velocities in the world, so the push is also the best
+      // estimate of how hard they hit. Zero for end events.
+      float normalX;
+      float normalY;
+      float depth;
+
+      ContactEvent(int proxyA = -1, int proxyB = -1, bool began = false)
+         : proxyA(proxyA), proxyB(proxyB), began(began), normalX(0.0f), normalY(0.0f), depth(0.0f) {}
+   };
+
+   //------------------------------------------------------
+   // A fixed size ring of contact events, written by one
+   // thread (the one stepping the world) and read by any
+   // number of others. Every reader sees every event.
+   //
+   // Nothing locks and the writer never waits. If a reader
+   // falls more than Capacity() events behind, the oldest
+   // ones are written over, and the reader skips ahead and
+   // counts what it missed.
+   //
+   // Each slot has a sequence number that's odd while the
+   // slot is being written, so a reader can tell if an event
+   // changed under it while it was copying it out.
+   //------------------------------------------------------
+   class ContactEventRing
+   {
+   private:
+      // Events are stored as words, so copying one in or out
+      // while the other side is busy isn't a data race
+      static const int eventWords = (sizeof(ContactEvent) + sizeof(unsigned int) - 1) / sizeof(unsigned int);
+
+      struct Slot
+      {
+         std::atomic<unsigned long long> sequence;
+         std::atomic<unsigned int> words[eventWords];
+      };
+
+      Slot* slots;
+      unsigned long long mask;
+      // How many events have ever been published
+      std::atomic<unsigned long long> published;
+
+      ContactEventRing(const ContactEventRing&) = delete;
+      ContactEventRing& operator=(const ContactEventRing&) = delete;
+
+   public:
+      // The capacity gets rounded up to a power of 2
+      ContactEventRing(int capacity = 4096);
+      ~ContactEventRing();
+
+      int Capacity() const { return (int)(mask + 1); }
+      unsigned long long Published() const { return published.load(std::memory_order_acquire); }
+
+      // Writer only
+      void Publish(const ContactEvent& event);
+
+      /*
+        Reads event number `sequence`. Returns false if it
+        hasn't been published yet, or has been written over
+        (then sequence < Published() - Capacity()).
+      */
+      bool Read(unsigned long long sequence, ContactEvent& event) const;
+   };
+
+   //------------------------------------------------------
+   // One reader's place in a ring. Give each consuming
+   // thread its own. Starts at the next event published.
+   //------------------------------------------------------
+   class ContactEventReader
+   {
+   private:
+      const ContactEventRing* ring;
+      unsigned long long next;
+      unsigned long long missed;
+
+   public:
+      ContactEventReader(const ContactEventRing& ring);
+
+      // Gets the next event, false if there isn't one yet
+      bool Next(ContactEvent& event);
+
+      // Reads up to maxEvents, returns how many
+      int Read(ContactEvent* events, int maxEvents);
+
+      // How many events were written over before this reader got to them
+      unsigned long long Missed() const { return missed; }
+   };
+
+#endif // CONTACTEVENTS_H_
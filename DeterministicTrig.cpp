@@ -0,0 +1,123 @@
+#include "DeterministicTrig.h"
+
+// For floorf, fmodf
+#include <cmath>
+
+// The tables are Q16.16: 16 bits after the point
+const int fixedBits = 16;
+const int fixedOne = 1 << fixedBits;
+// Table steps in a full turn, and in a quarter turn
+const int sineSteps = 4096;
+const int quarterSteps = sineSteps / 4;
+
+//------------------------------------------------------
+// A quarter turn of sine in Q16.16. It's worked out with
+// a Taylor series in Q30 integers rather than sin(), so
+// it comes out the same everywhere.
+//------------------------------------------------------
+namespace
+{
+   struct SineTable
+   {
+      int values[quarterSteps + 1];
+
+      SineTable()
+      {
+         // pi / 2 in Q30
+         const long long halfPi = 1686629713LL;
+         const long long q30 = 1LL << 30;
+
+         for (int ii = 0; ii <= quarterSteps; ++ii) {
+            long long x = halfPi * ii / quarterSteps;
+            long long xSquared = x * x / q30;
+
+            // sin x = x - x^3/3! + x^5/5! - ...
+            long long term = x;
+            long long sum = x;
+            for (int n = 1; n <= 7; ++n) {
+               term = term * xSquared / q30 / ((2 * n) * (2 * n + 1));
+               sum += (n & 1) ? -term : term;
+            }
+
+            // Q30 to Q16, rounded
+            values[ii] = (int)((sum + (1 << 13)) / (1 << 14));
+         }
+      }
+   };
+}
+
+//------------------------------------------------------
+// Built the first time it's needed
+//------------------------------------------------------
+static const SineTable& GetSineTable()
+{
+   static const SineTable table;
+   return table;
+}
+
+//------------------------------------------------------
+// Sine at a whole table step, using the quarter turn
+// table for every quadrant
+//------------------------------------------------------
+static int SineAtStep(int step)
+{
+   const SineTable& table = GetSineTable();
+   step &= sineSteps - 1;
+   int quadrant = step / quarterSteps;
+   int offset = step % quarterSteps;
+
+   switch (quadrant) {
+   case 0: return table.values[offset];
+   case 1: return table.values[quarterSteps - offset];
+   case 2: return -table.values[offset];
+   default: return -table.values[quarterSteps - offset];
+   }
+}
+
+//------------------------------------------------------
+// Sine of an angle in Q16.16 degrees, blended between the
+// two closest table steps. Also Q16.16.
+//------------------------------------------------------
+static int TableSin(int degrees)
+{
+   const long long fullTurn = 360LL * fixedOne;
+   long long angle = degrees % fullTurn;
+   if (angle < 0) {
+      angle += fullTurn;
+   }
+
+   // Where the angle is in table steps, in Q16.16
+   long long position = angle * sineSteps / 360;
+   int step = (int)(position >> fixedBits);
+   long long fraction = position & (fixedOne - 1);
+
+   long long from = SineAtStep(step);
+   long long to = SineAtStep(step + 1);
+   return (int)(from + (to - from) * fraction / fixedOne);
+}
+
+//------------------------------------------------------
+// A float angle to the nearest Q16.16. fmodf is exact,
+// so big angles don't lose anything to the range, and
+// scaling by a power of two is exact too.
+//------------------------------------------------------
+static int TableAngle(float degrees)
+{
+   return (int)floorf(fmodf(degrees, 360.0f) * (float)fixedOne + 0.5f);
+}
+
+//------------------------------------------------------
+// Float sine through the table
+//------------------------------------------------------
+float DeterministicSin(float degrees)
+{
+   return (float)TableSin(TableAngle(degrees)) / (float)fixedOne;
+}
+
+//------------------------------------------------------
+// Float cosine through the table
+//------------------------------------------------------
+float DeterministicCos(float degrees)
+{
+   return (float)TableSin(TableAngle(degrees) + 90 * fixedOne) / (float)fixedOne;
+}
@@ -0,0 +1,23 @@
+#ifndef DETERMINISTICTRIG_H_
+#define DETERMINISTICTRIG_H_
+
+   //------------------------------------------------------
+   // Deterministic math for lockstep games.
+   //
+   // +, -, *, / and sqrtf are exact to the bit on every IEEE
+   // machine, but sin/cos come from each compiler's maths
+   // library and don't agree. Building with
+   // COLLISIONS_DETERMINISTIC defined swaps them for lookup
+   // tables that are worked out with integer maths, so every
+   // machine gets the same boxes. (The compiler must also be
+   // told not to fuse or reorder float maths: /fp:precise
+   // on MSVC, -ffp-contract=off and no -ffast-math on GCC
+   // and Clang.)
+   //
+   // These are the tables' sine and cosine, for angles in
+   // degrees like Box::Rotation.
+   //------------------------------------------------------
+   float DeterministicSin(float degrees);
+   float DeterministicCos(float degrees);
+
+#endif // DETERMINISTICTRIG_H_
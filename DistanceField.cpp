@@ -0,0 +1,371 @@
+#include "DistanceField.h"
+
+// For sort
+#include <algorithm>
+// For sqrtf, floorf
+#include <cmath>
+
+// Distance used before anything has been found
+const float farAway = 1e30f;
+
+// How many cells around a line get exact distances before
+// the rest of the grid is filled in from neighbours
+const int exactBand = 2;
+
+//------------------------------------------------------
+// Constructor. The field is empty until Build()
+//------------------------------------------------------
+DistanceField::DistanceField()
+{
+   columns = rows = 0;
+   cellSize = 1.0f;
+   originX = originY = 0.0f;
+}
+
+//------------------------------------------------------
+// Adds an outline line
+//------------------------------------------------------
+void DistanceField::AddLine(const Line& line)
+{
+   FieldSegment segment;
+   segment.ax = line.StartX();
+   segment.ay = line.StartY();
+   segment.bx = line.EndX();
+   segment.by = line.EndY();
+   segment.boxSide = false;
+   segments.push_back(segment);
+}
+
+//------------------------------------------------------
+// Adds a solid box. Its sides are measured for distance,
+// and everything inside it counts as inside the terrain.
+//------------------------------------------------------
+void DistanceField::AddBox(const Box& box)
+{
+   FieldBox fieldBox;
+   fieldBox.centerX = box.Center().X();
+   fieldBox.centerY = box.Center().Y();
+   box.Normal(0, fieldBox.axisX[0], fieldBox.axisY[0]);
+   box.Normal(1, fieldBox.axisX[1], fieldBox.axisY[1]);
+   fieldBox.halfWidth = box.HalfWidth();
+   fieldBox.halfHeight = box.HalfHeight();
+   boxes.push_back(fieldBox);
+
+   for (int side = 0; side < Box::MAX_SIDES; ++side) {
+      Line edge = box.Line((Box::SIDE)side);
+      FieldSegment segment;
+      segment.ax = edge.StartX();
+      segment.ay = edge.StartY();
+      segment.bx = edge.EndX();
+      segment.by = edge.EndY();
+      segment.boxSide = true;
+      segments.push_back(segment);
+   }
+}
+
+//------------------------------------------------------
+// Throws away the outlines
+//------------------------------------------------------
+void DistanceField::ClearOutlines()
+{
+   segments.clear();
+   boxes.clear();
+}
+
+//------------------------------------------------------
+// Is a spot inside one of the boxes?
+//------------------------------------------------------
+bool DistanceField::InsideBox(const FieldBox& box, float x, float y) const
+{
+   float dx = x - box.centerX;
+   float dy = y - box.centerY;
+   return absValue(dx * box.axisX[0] + dy * box.axisY[0]) <= box.halfWidth
+      && absValue(dx * box.axisX[1] + dy * box.axisY[1]) <= box.halfHeight;
+}
+
+//------------------------------------------------------
+// Builds the grid.
+//
+// 1) Samples near each line get the exact distance, and
+//    remember which spot on the line was closest.
+// 2) Two sweeps over the grid hand those closest spots on
+//    to neighbours that are further away.
+// 3) Each row counts outline crossings (box sides left
+//    out) to decide which samples are inside, along with
+//    the boxes, and those get flipped negative.
+//------------------------------------------------------
+void DistanceField::Build(float originX, float originY, int columns, int rows, float cellSize)
+{
+   this->originX = originX;
+   this->originY = originY;
+   this->columns = (columns > 0 ? columns : 0);
+   this->rows = (rows > 0 ? rows : 0);
+   this->cellSize = (cellSize > 0.0f ? cellSize : 1.0f);
+
+   int count = this->columns * this->rows;
+   samples.assign(count, farAway);
+   vector<float> closestX(count, 0.0f);
+   vector<float> closestY(count, 0.0f);
+   vector<bool> found(count, false);
+
+   // 1) Exact distances near the lines
+   for (unsigned int ii = 0; ii < segments.size(); ++ii) {
+      const FieldSegment& segment = segments[ii];
+      float dx = segment.bx - segment.ax;
+      float dy = segment.by - segment.ay;
+      float lengthSquared = dx * dx + dy * dy;
+
+      int firstColumn = (int)floorf(((segment.ax < segment.bx ? segment.ax : segment.bx) - originX) / this->cellSize) - exactBand;
+      int lastColumn = (int)floorf(((segment.ax < segment.bx ? segment.bx : segment.ax) - originX) / this->cellSize) + exactBand + 1;
+      int firstRow = (int)floorf(((segment.ay < segment.by ? segment.ay : segment.by) - originY) / this->cellSize) - exactBand;
+      int lastRow = (int)floorf(((segment.ay < segment.by ? segment.by : segment.ay) - originY) / this->cellSize) + exactBand + 1;
+      if (firstColumn < 0) firstColumn = 0;
+      if (firstRow < 0) firstRow = 0;
+      if (lastColumn >= this->columns) lastColumn = this->columns - 1;
+      if (lastRow >= this->rows) lastRow = this->rows - 1;
+
+      for (int row = firstRow; row <= lastRow; ++row) {
+         for (int column = firstColumn; column <= lastColumn; ++column) {
+            float x = originX + column * this->cellSize;
+            float y = originY + row * this->cellSize;
+
+            // Closest spot on the segment
+            float t = 0.0f;
+            if (lengthSquared > 0.0f) {
+               t = ((x - segment.ax) * dx + (y - segment.ay) * dy) / lengthSquared;
+               t = (t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t));
+            }
+            float spotX = segment.ax + dx * t;
+            float spotY = segment.ay + dy * t;
+            float distance = sqrtf((x - spotX) * (x - spotX) + (y - spotY) * (y - spotY));
+
+            int index = row * this->columns + column;
+            if (distance < samples[index]) {
+               samples[index] = distance;
+               closestX[index] = spotX;
+               closestY[index] = spotY;
+               found[index] = true;
+            }
+         }
+      }
+   }
+
+   // 2) Pass closest spots along, forwards then backwards
+   const int forwardOffsets[4][2] = { { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+   const int backwardOffsets[4][2] = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 } };
+   for (int pass = 0; pass < 2; ++pass) {
+      const int (*offsets)[2] = (pass == 0 ? forwardOffsets : backwardOffsets);
+      for (int step = 0; step < count; ++step) {
+         int index = (pass == 0 ? step : count - 1 - step);
+         int row = index / this->columns;
+         int column = index % this->columns;
+         float x = originX + column * this->cellSize;
+         float y = originY + row * this->cellSize;
+
+         for (int ii = 0; ii < 4; ++ii) {
+            int otherColumn = column + offsets[ii][0];
+            int otherRow = row + offsets[ii][1];
+            if (otherColumn < 0 || otherRow < 0 || otherColumn >= this->columns || otherRow >= this->rows) {
+               continue;
+            }
+            int other = otherRow * this->columns + otherColumn;
+            if (!found[other]) {
+               continue;
+            }
+            float spotX = closestX[other];
+            float spotY = closestY[other];
+            float distance = sqrtf((x - spotX) * (x - spotX) + (y - spotY) * (y - spotY));
+            if (distance < samples[index]) {
+               samples[index] = distance;
+               closestX[index] = spotX;
+               closestY[index] = spotY;
+               found[index] = true;
+            }
+         }
+      }
+   }
+
+   // 3) Inside or outside? Count crossings along each row.
+   vector<float> crossings;
+   for (int row = 0; row < this->rows; ++row) {
+      float y = originY + row * this->cellSize;
+      crossings.clear();
+      for (unsigned int ii = 0; ii < segments.size(); ++ii) {
+         const FieldSegment& segment = segments[ii];
+         if (segment.boxSide) {
+            continue;
+         }
+         // Half open, so a shared end point only counts once
+         if ((segment.ay <= y && segment.by > y) || (segment.by <= y && segment.ay > y)) {
+            float t = (y - segment.ay) / (segment.by - segment.ay);
+            crossings.push_back(segment.ax + (segment.bx - segment.ax) * t);
+         }
+      }
+      std::sort(crossings.begin(), crossings.end());
+
+      unsigned int passed = 0;
+      for (int column = 0; column < this->columns; ++column) {
+         float x = originX + column * this->cellSize;
+         while (passed < crossings.size() && crossings[passed] < x) {
+            ++passed;
+         }
+
+         bool inside = (passed % 2) == 1;
+         for (unsigned int ii = 0; ii < boxes.size() && !inside; ++ii) {
+            inside = InsideBox(boxes[ii], x, y);
+         }
+         if (inside) {
+            samples[row * this->columns + column] *= -1.0f;
+         }
+      }
+   }
+
+   ClearOutlines();
+}
+
+//------------------------------------------------------
+// Gets a sample, clamped to the grid
+//------------------------------------------------------
+float DistanceField::Sample(int column, int row) const
+{
+   if (column < 0) column = 0;
+   if (row < 0) row = 0;
+   if (column >= columns) column = columns - 1;
+   if (row >= rows) row = rows - 1;
+   return samples[row * columns + column];
+}
+
+//------------------------------------------------------
+// Blends the 4 closest samples for the distance, and
+// uses the slope of the blend for the normal
+//------------------------------------------------------
+float DistanceField::Query(float x, float y, Point& normal) const
+{
+   if (samples.size() == 0) {
+      normal = Point(0.0f, 0.0f);
+      return farAway;
+   }
+
+   float gridX = (x - originX) / cellSize;
+   float gridY = (y - originY) / cellSize;
+   int column = (int)floorf(gridX);
+   int row = (int)floorf(gridY);
+   float fractionX = gridX - column;
+   float fractionY = gridY - row;
+
+   float topLeft = Sample(column, row);
+   float topRight = Sample(column + 1, row);
+   float bottomLeft = Sample(column, row + 1);
+   float bottomRight = Sample(column + 1, row + 1);
+
+   float top = topLeft + (topRight - topLeft) * fractionX;
+   float bottom = bottomLeft + (bottomRight - bottomLeft) * fractionX;
+
+   // Slope of the blend, in each direction
+   float slopeX = ((topRight - topLeft) * (1.0f - fractionY) + (bottomRight - bottomLeft) * fractionY);
+   float slopeY = bottom - top;
+   normal = Point(slopeX, slopeY);
+   normal.Normalize();
+
+   return top + (bottom - top) * fractionY;
+}
+
+//------------------------------------------------------
+// Distance to the terrain at a spot
+//------------------------------------------------------
+float DistanceField::Distance(float x, float y) const
+{
+   Point unused;
+   return Query(x, y, unused);
+}
+
+//------------------------------------------------------
+// Pushes a circle out of the terrain
+//------------------------------------------------------
+bool DistanceField::CollideCircle(Circle* circle) const
+{
+   Point normal;
+   float distance = Query(circle->CenterX(), circle->CenterY(), normal);
+   if (distance >= circle->Radius()) {
+      return false;
+   }
+
+   float push = circle->Radius() - distance;
+   circle->Move(normal.X() * push, normal.Y() * push);
+   return true;
+}
+
+//------------------------------------------------------
+// Pushes a point out of the terrain
+//------------------------------------------------------
+bool DistanceField::CollidePoint(Point* point) const
+{
+   Point normal;
+   float distance = Query(point->X(), point->Y(), normal);
+   if (distance >= 0.0f) {
+      return false;
+   }
+
+   point->Move(normal.X() * -distance, normal.Y() * -distance);
+   return true;
+}
+
+//------------------------------------------------------
+// Collides any shape against the terrain.
+// Boxes and Lines push out their deepest corner/end.
+//------------------------------------------------------
+bool DistanceField::Collide(Shape* shape) const
+{
+   if (shape == 0 || !ShouldCollide(shape->Filter(), filter)) {
+      return false;
+   }
+
+   switch (shape->Type()) {
+      case SHAPE_POINT:
+         return CollidePoint(dynamic_cast<Point*>(shape));
+      case CIRCLE:
+         return CollideCircle(dynamic_cast<Circle*>(shape));
+      case LINE:
+      case BOX:
+      {
+         Point corners[4];
+         int cornerCount = 0;
+         if (shape->Type() == LINE) {
+            Line* line = dynamic_cast<Line*>(shape);
+            corners[cornerCount++] = line->Start();
+            corners[cornerCount++] = line->End();
+         }
+         else {
+            Box* box = dynamic_cast<Box*>(shape);
+            for (int ii = 0; ii < Box::MAX_DIAGONALS; ++ii) {
+               corners[cornerCount++] = box->Corner((Box::DIAGONAL)ii);
+            }
+         }
+
+         // Find the deepest one
+         float deepest = 0.0f;
+         Point deepestNormal;
+         for (int ii = 0; ii < cornerCount; ++ii) {
+            Point normal;
+            float distance = Query(corners[ii].X(), corners[ii].Y(), normal);
+            if (distance < deepest) {
+               deepest = distance;
+               deepestNormal = normal;
+            }
+         }
+         if (deepest >= 0.0f) {
+            return false;
+         }
+
+         if (shape->Type() == LINE) {
+            dynamic_cast<Line*>(shape)->Move(deepestNormal.X() * -deepest, deepestNormal.Y() * -deepest);
+         }
+         else {
+            dynamic_cast<Box*>(shape)->Move(deepestNormal.X() * -deepest, deepestNormal.Y() * -deepest);
+         }
+         return true;
+      }
+      default:
+         return false;
+   };
+}
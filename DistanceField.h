@@ -0,0 +1,91 @@
+#ifndef DISTANCEFIELD_H_
+#define DISTANCEFIELD_H_
+
+#include "Collisions.h"
+
+   //------------------------------------------------------
+   // A signed distance field for big static terrain.
+   //
+   // The field is a grid of samples, each one the distance
+   // to the nearest terrain edge (negative inside terrain).
+   // Lookups blend the 4 nearest samples (bilinear), and the
+   // normal comes from the slope of that blend, so a circle
+   // vs terrain test is one lookup no matter how many lines
+   // made up the outline.
+   //
+   // Build it by adding the outline Lines (which must form
+   // closed loops, inside is decided by crossing count) and
+   // any Boxes, then calling Build().
+   //------------------------------------------------------
+   class DistanceField
+   {
+   private:
+      // Outline pieces kept around until Build()
+      struct FieldSegment
+      {
+         float ax, ay, bx, by;
+         // Box sides only count for distance. Boxes decide
+         // their own inside, so they stay out of the crossing count.
+         bool boxSide;
+      };
+      struct FieldBox
+      {
+         float centerX, centerY;
+         float axisX[2];
+         float axisY[2];
+         float halfWidth, halfHeight;
+      };
+
+      vector<FieldSegment> segments;
+      vector<FieldBox> boxes;
+
+      // Samples, row by row
+      vector<float> samples;
+      int columns;
+      int rows;
+      float cellSize;
+      float originX;
+      float originY;
+      CollisionFilter filter;
+
+      float Sample(int column, int row) const;
+      bool InsideBox(const FieldBox& box, float x, float y) const;
+
+   public:
+      DistanceField();
+
+      // Adding outlines (used by the next Build)
+      void AddLine(const Line& line);
+      void AddBox(const Box& box);
+      void ClearOutlines();
+
+      // Samples the outlines into a columns x rows grid of
+      // samples, cellSize apart, starting at the origin.
+      // The outlines are thrown away afterwards.
+      void Build(float originX, float originY, int columns, int rows, float cellSize);
+
+      // Accessors
+      int Columns() const { return columns; }
+      int Rows() const { return rows; }
+      float CellSize() const { return cellSize; }
+      const CollisionFilter& Filter() const { return filter; }
+
+      // Mutators
+      void Filter(const CollisionFilter& filter) { this->filter = filter; }
+
+      // Distance to the terrain at a spot (negative means inside).
+      // Spots outside the grid use the closest edge of the grid.
+      float Distance(float x, float y) const;
+
+      // Distance and the direction out of the terrain, in one lookup
+      float Query(float x, float y, Point& normal) const;
+
+      // Pushes shapes out of the terrain. The terrain never moves.
+      // Boxes and Lines only test their corners/ends, so they
+      // can still clip thin bits of terrain.
+      bool CollideCircle(Circle* circle) const;
+      bool CollidePoint(Point* point) const;
+      bool Collide(Shape* shape) const;
+   };
+
+#endif // DISTANCEFIELD_H_
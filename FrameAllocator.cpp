@@ -0,0 +1,115 @@
+#include "FrameAllocator.h"
+
+//------------------------------------------------------
+// Constructor. The first block is made on first use.
+//------------------------------------------------------
+FrameAllocator::FrameAllocator(size_t blockSize)
+{
+   currentBlock = 0;
+   offset = 0;
+   defaultBlockSize = blockSize;
+}
+
+//------------------------------------------------------
+// Destructor. Frees every block.
+//------------------------------------------------------
+FrameAllocator::~FrameAllocator()
+{
+   for (unsigned int ii = 0; ii < blocks.size(); ++ii) {
+      delete[] blocks[ii].memory;
+   }
+}
+
+//------------------------------------------------------
+// Bumps the pointer. Moves on to the next block (or
+// makes one) if this one is full.
+//------------------------------------------------------
+void* FrameAllocator::Allocate(size_t bytes, size_t alignment)
+{
+   while (currentBlock < blocks.size()) {
+      Block& block = blocks[currentBlock];
+      size_t address = (size_t)(block.memory + offset);
+      size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+      if (offset + padding + bytes <= block.size) {
+         void* memory = block.memory + offset + padding;
+         offset += padding + bytes;
+         return memory;
+      }
+
+      // Doesn't fit, try the next block
+      ++currentBlock;
+      offset = 0;
+   }
+
+   // Out of blocks, make a new one big enough
+   Block block;
+   block.size = (bytes + alignment > defaultBlockSize ? bytes + alignment : defaultBlockSize);
+   block.memory = new unsigned char[block.size];
+   blocks.push_back(block);
+   currentBlock = blocks.size() - 1;
+   offset = 0;
+   return Allocate(bytes, alignment);
+}
+
+//------------------------------------------------------
+// Gives back everything. If the last frame spilled into
+// more than one block, they get merged into one.
+//------------------------------------------------------
+void FrameAllocator::Reset()
+{
+   if (blocks.size() > 1) {
+      size_t total = Capacity();
+      for (unsigned int ii = 0; ii < blocks.size(); ++ii) {
+         delete[] blocks[ii].memory;
+      }
+      blocks.clear();
+
+      Block block;
+      block.size = total;
+      block.memory = new unsigned char[total];
+      blocks.push_back(block);
+   }
+   currentBlock = 0;
+   offset = 0;
+}
+
+//------------------------------------------------------
+// Remembers where the allocator is up to
+//------------------------------------------------------
+FrameAllocator::Marker FrameAllocator::GetMarker() const
+{
+   Marker marker;
+   marker.block = currentBlock;
+   marker.offset = offset;
+   return marker;
+}
+
+//------------------------------------------------------
+// Goes back to a marker
+//------------------------------------------------------
+void FrameAllocator::Rewind(const Marker& marker)
+{
+   currentBlock = marker.block;
+   offset = marker.offset;
+}
+
+//------------------------------------------------------
+// Adds up the size of every block
+//------------------------------------------------------
+size_t FrameAllocator::Capacity() const
+{
+   size_t total = 0;
+   for (unsigned int ii = 0; ii < blocks.size(); ++ii) {
+      total += blocks[ii].size;
+   }
+   return total;
+}
+
+//------------------------------------------------------
+// Each thread gets its own, so no locking is needed
+//------------------------------------------------------
+FrameAllocator& ThreadFrameAllocator()
+{
+   static thread_local FrameAllocator allocator;
+   return allocator;
+}
@@ -0,0 +1,106 @@
+#ifndef FRAMEALLOCATOR_H_
+#define FRAMEALLOCATOR_H_
+
+// For size_t
+#include <cstddef>
+// For placement new
+#include <new>
+#include <vector>
+using std::vector;
+
+   //------------------------------------------------------
+   // A bump allocator for memory that only lives for one
+   // frame/tick. Allocating is just moving a pointer, and
+   // nothing is freed on its own. Call Reset() at the end
+   // of the frame, or Rewind() to a Marker() to give back
+   // everything allocated since the marker.
+   //
+   // When a frame needs more than one block, Reset() swaps
+   // the blocks for one block big enough for all of them,
+   // so after a frame or two it stops calling new at all.
+   //------------------------------------------------------
+   class FrameAllocator
+   {
+   public:
+      struct Marker
+      {
+         size_t block;
+         size_t offset;
+      };
+
+   private:
+      struct Block
+      {
+         unsigned char* memory;
+         size_t size;
+      };
+
+      vector<Block> blocks;
+      size_t currentBlock;
+      size_t offset;
+      size_t defaultBlockSize;
+
+      FrameAllocator(const FrameAllocator&) = delete;
+      FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+   public:
+      FrameAllocator(size_t blockSize = 64 * 1024);
+      ~FrameAllocator();
+
+      // Gets some memory. Alignment must be a power of 2.
+      void* Allocate(size_t bytes, size_t alignment = 16);
+
+      // Gets (default constructed) room for count things
+      template <class T>
+      T* AllocateArray(size_t count) {
+         T* memory = static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+         for (size_t ii = 0; ii < count; ++ii) {
+            new (memory + ii) T();
+         }
+         return memory;
+      }
+
+      // Gives back everything
+      void Reset();
+
+      // Gives back everything allocated since the marker
+      Marker GetMarker() const;
+      void Rewind(const Marker& marker);
+
+      // How many bytes the blocks hold altogether
+      size_t Capacity() const;
+   };
+
+   // The frame allocator for the calling thread
+   FrameAllocator& ThreadFrameAllocator();
+
+   //------------------------------------------------------
+   // Lets std containers use a FrameAllocator.
+   // Deallocating does nothing, the memory goes back when
+   // the frame allocator is reset.
+   //------------------------------------------------------
+   template <class T>
+   class FrameStlAllocator
+   {
+   public:
+      typedef T value_type;
+      FrameAllocator* frame;
+
+      FrameStlAllocator(FrameAllocator& frame) : frame(&frame) {}
+      template <class U>
+      FrameStlAllocator(const FrameStlAllocator<U>& rhs) : frame(rhs.frame) {}
+
+      T* allocate(size_t count) { return static_cast<T*>(frame->Allocate(sizeof(T) * count, alignof(T))); }
+      void deallocate(T*, size_t) {}
+
+      template <class U>
+      bool operator==(const FrameStlAllocator<U>& rhs) const { return frame == rhs.frame; }
+      template <class U>
+      bool operator!=(const FrameStlAllocator<U>& rhs) const { return frame != rhs.frame; }
+   };
+
+   // A vector that lives in a frame allocator
+   template <class T>
+   using FrameVector = vector<T, FrameStlAllocator<T> >;
+
+#endif // FRAMEALLOCATOR_H_
@@ -0,0 +1,510 @@
+#include "ParallelBroadphase.h"
+
+#include <thread>
+#include <algorithm>
+#include <cfloat>    // For FLT_MAX
+
+// Below this many items per thread, threads cost more than they save
+const int minItemsPerThread = 512;
+const int radixBits = 8;
+const int radixBuckets = 1 << radixBits;
+
+//------------------------------------------------------
+// Spreads the low 16 bits out to the even bits
+//------------------------------------------------------
+unsigned int SpreadBits(unsigned int value)
+{
+   value &= 0x0000ffff;
+   value = (value | (value << 8)) & 0x00ff00ff;
+   value = (value | (value << 4)) & 0x0f0f0f0f;
+   value = (value | (value << 2)) & 0x33333333;
+   value = (value | (value << 1)) & 0x55555555;
+   return value;
+}
+
+//------------------------------------------------------
+// How many zero bits before the first set one
+//------------------------------------------------------
+int LeadingZeros(unsigned int value)
+{
+   if (value == 0) {
+      return 32;
+   }
+   int zeros = 0;
+   if ((value & 0xffff0000) == 0) { zeros += 16; value <<= 16; }
+   if ((value & 0xff000000) == 0) { zeros += 8; value <<= 8; }
+   if ((value & 0xf0000000) == 0) { zeros += 4; value <<= 4; }
+   if ((value & 0xc0000000) == 0) { zeros += 2; value <<= 2; }
+   if ((value & 0x80000000) == 0) { zeros += 1; }
+   return zeros;
+}
+
+//------------------------------------------------------
+// Grows a box to hold another
+//------------------------------------------------------
+AABB MergeBounds(const AABB& a, const AABB& b)
+{
+   return AABB(a.minX < b.minX ? a.minX : b.minX,
+               a.minY < b.minY ? a.minY : b.minY,
+               a.maxX > b.maxX ? a.maxX : b.maxX,
+               a.maxY > b.maxY ? a.maxY : b.maxY);
+}
+
+//------------------------------------------------------
+// Constructor
+//------------------------------------------------------
+ParallelBroadphase::ParallelBroadphase(int threadCount)
+{
+   this->count = 0;
+   this->arrivals = 0;
+   this->arrivalCapacity = 0;
+   this->threadCount = 0;
+   this->job = 0;
+   this->jobWork = 0;
+   this->jobCount = 0;
+   this->jobThreads = 0;
+   this->jobNumber = 0;
+   this->busyWorkers = 0;
+   this->stopping = false;
+   ThreadCount(threadCount);
+}
+
+//------------------------------------------------------
+// Destructor
+//------------------------------------------------------
+ParallelBroadphase::~ParallelBroadphase()
+{
+   StopWorkers();
+   delete[] arrivals;
+}
+
+//------------------------------------------------------
+// Sets how many threads to use. 0 means one per core.
+// The workers are started over to match.
+//------------------------------------------------------
+void ParallelBroadphase::ThreadCount(int threadCount)
+{
+   if (threadCount <= 0) {
+      threadCount = (int)std::thread::hardware_concurrency();
+   }
+   if (threadCount <= 0) {
+      threadCount = 1;
+   }
+   if (threadCount == this->threadCount) {
+      return;
+   }
+
+   StopWorkers();
+   this->threadCount = threadCount;
+   StartWorkers();
+}
+
+//------------------------------------------------------
+// Starts a worker for every thread but the caller's
+//------------------------------------------------------
+void ParallelBroadphase::StartWorkers()
+{
+   stopping = false;
+   for (int tt = 1; tt < threadCount; ++tt) {
+      workers.push_back(std::thread(&ParallelBroadphase::WorkerLoop, this, tt));
+   }
+}
+
+//------------------------------------------------------
+// Tells the workers to quit, and waits for them
+//------------------------------------------------------
+void ParallelBroadphase::StopWorkers()
+{
+   {
+      std::lock_guard<std::mutex> guard(poolLock);
+      stopping = true;
+   }
+   startWork.notify_all();
+   for (unsigned int ii = 0; ii < workers.size(); ++ii) {
+      workers[ii].join();
+   }
+   workers.clear();
+}
+
+//------------------------------------------------------
+// A worker. Waits for a phase, does its chunk of it (if
+// the phase needs this many threads), and says when it's
+// done.
+//------------------------------------------------------
+void ParallelBroadphase::WorkerLoop(int thread)
+{
+   std::unique_lock<std::mutex> guard(poolLock);
+   unsigned int lastJob = jobNumber;
+   while (true) {
+      while (!stopping && jobNumber == lastJob) {
+         startWork.wait(guard);
+      }
+      if (stopping) {
+         return;
+      }
+      lastJob = jobNumber;
+      if (thread >= jobThreads) {
+         continue;
+      }
+
+      // Same chunks the caller works out
+      int chunkSize = (jobCount + jobThreads - 1) / jobThreads;
+      int first = thread * chunkSize;
+      int last = (first + chunkSize < jobCount ? first + chunkSize : jobCount);
+      void (*work)(void*, int, int, int) = job;
+      void* context = jobWork;
+
+      // Don't hold the lock while working
+      guard.unlock();
+      work(context, first, last, thread);
+      guard.lock();
+
+      if (--busyWorkers == 0) {
+         workDone.notify_one();
+      }
+   }
+}
+
+//------------------------------------------------------
+// Runs one phase: hands the workers their chunks, does
+// the first chunk here, then waits for the rest
+//------------------------------------------------------
+void ParallelBroadphase::RunJob(void (*job)(void*, int, int, int), void* work, int threads, int count) const
+{
+   if (threads > (int)workers.size() + 1) {
+      threads = (int)workers.size() + 1;
+   }
+   if (threads <= 1) {
+      job(work, 0, count, 0);
+      return;
+   }
+
+   int chunkSize = (count + threads - 1) / threads;
+   {
+      std::lock_guard<std::mutex> guard(poolLock);
+      this->job = job;
+      this->jobWork = work;
+      this->jobCount = count;
+      this->jobThreads = threads;
+      this->busyWorkers = threads - 1;
+      ++jobNumber;
+   }
+   startWork.notify_all();
+
+   job(work, 0, (chunkSize < count ? chunkSize : count), 0);
+
+   std::unique_lock<std::mutex> guard(poolLock);
+   while (busyWorkers > 0) {
+      workDone.wait(guard);
+   }
+}
+
+//------------------------------------------------------
+// How many threads are worth starting for this many items
+//------------------------------------------------------
+int ParallelBroadphase::ThreadsFor(int items) const
+{
+   int threads = 1 + items / minItemsPerThread;
+   return (threads < threadCount ? threads : threadCount);
+}
+
+//------------------------------------------------------
+// Length of the common prefix of two leaves' codes. Equal
+// codes fall back to comparing the leaf indices, so every
+// key is unique. -1 if jj is off the end.
+//------------------------------------------------------
+int ParallelBroadphase::CommonPrefix(int ii, int jj) const
+{
+   if (jj < 0 || jj >= count) {
+      return -1;
+   }
+   if (codes[ii] == codes[jj]) {
+      return 32 + LeadingZeros((unsigned int)(ii ^ jj));
+   }
+   return LeadingZeros(codes[ii] ^ codes[jj]);
+}
+
+//------------------------------------------------------
+// Works out which range of leaves inner node ii covers,
+// and where that range splits (Karras 2012). Needs
+// nothing but the sorted codes, so every inner node can
+// be built at the same time.
+//------------------------------------------------------
+void ParallelBroadphase::BuildInnerNode(int ii)
+{
+   // Which way does the range go?
+   int direction = (CommonPrefix(ii, ii + 1) - CommonPrefix(ii, ii - 1) > 0 ? 1 : -1);
+
+   // Find the far end: double the step until the prefix gets
+   // too short, then binary search back
+   int minPrefix = CommonPrefix(ii, ii - direction);
+   int maxLength = 2;
+   while (CommonPrefix(ii, ii + maxLength * direction) > minPrefix) {
+      maxLength *= 2;
+   }
+   int length = 0;
+   for (int step = maxLength / 2; step >= 1; step /= 2) {
+      if (CommonPrefix(ii, ii + (length + step) * direction) > minPrefix) {
+         length += step;
+      }
+   }
+   int jj = ii + length * direction;
+
+   // Binary search for where the range splits
+   int nodePrefix = CommonPrefix(ii, jj);
+   int split = 0;
+   for (int divisor = 2; ; divisor *= 2) {
+      int step = (length + divisor - 1) / divisor;
+      if (CommonPrefix(ii, ii + (split + step) * direction) > nodePrefix) {
+         split += step;
+      }
+      if (step <= 1) {
+         break;
+      }
+   }
+   int gamma = ii + split * direction + (direction < 0 ? -1 : 0);
+
+   int first = (ii < jj ? ii : jj);
+   int last = (ii < jj ? jj : ii);
+   Node& node = nodes[ii];
+   node.left = (first == gamma ? LeafNode(gamma) : gamma);
+   node.right = (last == gamma + 1 ? LeafNode(gamma + 1) : gamma + 1);
+   node.item = -1;
+   nodes[node.left].parent = ii;
+   nodes[node.right].parent = ii;
+}
+
+//------------------------------------------------------
+// LSD radix sort of the codes (carrying the items along).
+// Each pass, every thread counts the digits in its chunk,
+// the counts are turned into where each thread's share of
+// each digit starts, and every thread scatters its chunk.
+// Keeping chunk order keeps the sort stable.
+//------------------------------------------------------
+void ParallelBroadphase::SortCodes()
+{
+   int threads = ThreadsFor(count);
+
+   swapCodes.resize(count);
+   swapItems.resize(count);
+   histograms.resize(threads * radixBuckets);
+
+   for (int shift = 0; shift < 32; shift += radixBits) {
+      std::fill(histograms.begin(), histograms.end(), 0);
+
+      ParallelChunks(threads, count, [&](int first, int last, int thread) {
+         int* histogram = &histograms[thread * radixBuckets];
+         for (int ii = first; ii < last; ++ii) {
+            ++histogram[(codes[ii] >> shift) & (radixBuckets - 1)];
+         }
+      });
+
+      // Digit major, thread minor, so thread 0's 3s come before thread 1's 3s
+      int offset = 0;
+      for (int bucket = 0; bucket < radixBuckets; ++bucket) {
+         for (int tt = 0; tt < threads; ++tt) {
+            int digitCount = histograms[tt * radixBuckets + bucket];
+            histograms[tt * radixBuckets + bucket] = offset;
+            offset += digitCount;
+         }
+      }
+
+      ParallelChunks(threads, count, [&](int first, int last, int thread) {
+         int* next = &histograms[thread * radixBuckets];
+         for (int ii = first; ii < last; ++ii) {
+            int target = next[(codes[ii] >> shift) & (radixBuckets - 1)]++;
+            swapCodes[target] = codes[ii];
+            swapItems[target] = sortedItems[ii];
+         }
+      });
+
+      codes.swap(swapCodes);
+      sortedItems.swap(swapItems);
+   }
+}
+
+//------------------------------------------------------
+// Rebuilds the tree around a new set of bounds
+//------------------------------------------------------
+void ParallelBroadphase::Build(const AABB* bounds, int count)
+{
+   this->count = count;
+   itemBounds.assign(bounds, bounds + count);
+   nodes.resize(count > 0 ? 2 * count - 1 : 0);
+   if (count == 0) {
+      return;
+   }
+
+   int threads = ThreadsFor(count);
+
+   // Bounds of the whole scene, one piece per thread
+   vector<AABB> sceneParts(threads, AABB(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX));
+   ParallelChunks(threads, count, [&](int first, int last, int thread) {
+      AABB part = sceneParts[thread];
+      for (int ii = first; ii < last; ++ii) {
+         float x = (itemBounds[ii].minX + itemBounds[ii].maxX) * 0.5f;
+         float y = (itemBounds[ii].minY + itemBounds[ii].maxY) * 0.5f;
+         part = MergeBounds(part, AABB(x, y, x, y));
+      }
+      sceneParts[thread] = part;
+   });
+   AABB scene = sceneParts[0];
+   for (int tt = 1; tt < threads; ++tt) {
+      scene = MergeBounds(scene, sceneParts[tt]);
+   }
+
+   // Morton codes: 16 bits of x and 16 bits of y, interleaved
+   float width = scene.maxX - scene.minX;
+   float height = scene.maxY - scene.minY;
+   float scaleX = (width > 0.0f ? 65535.0f / width : 0.0f);
+   float scaleY = (height > 0.0f ? 65535.0f / height : 0.0f);
+   codes.resize(count);
+   sortedItems.resize(count);
+   ParallelChunks(threads, count, [&](int first, int last, int) {
+      for (int ii = first; ii < last; ++ii) {
+         float x = (itemBounds[ii].minX + itemBounds[ii].maxX) * 0.5f;
+         float y = (itemBounds[ii].minY + itemBounds[ii].maxY) * 0.5f;
+         unsigned int cellX = (unsigned int)((x - scene.minX) * scaleX);
+         unsigned int cellY = (unsigned int)((y - scene.minY) * scaleY);
+         codes[ii] = SpreadBits(cellX) | (SpreadBits(cellY) << 1);
+         sortedItems[ii] = ii;
+      }
+   });
+
+   SortCodes();
+
+   // Leaves
+   ParallelChunks(threads, count, [&](int first, int last, int) {
+      for (int ii = first; ii < last; ++ii) {
+         Node& leaf = nodes[LeafNode(ii)];
+         leaf.item = sortedItems[ii];
+         leaf.bounds = itemBounds[leaf.item];
+         leaf.left = -1;
+         leaf.right = -1;
+      }
+   });
+   nodes[0].parent = -1;
+   if (count == 1) {
+      return;
+   }
+
+   // Inner nodes, all at once
+   ParallelChunks(threads, count - 1, [&](int first, int last, int) {
+      for (int ii = first; ii < last; ++ii) {
+         BuildInnerNode(ii);
+      }
+   });
+
+   // Bounds, bottom up. Each leaf climbs until it reaches a
+   // node whose other child isn't done yet; whoever gets there
+   // second merges the two and carries on.
+   if (arrivalCapacity < count - 1) {
+      delete[] arrivals;
+      arrivalCapacity = count - 1;
+      arrivals = new std::atomic<int>[arrivalCapacity];
+   }
+   for (int ii = 0; ii < count - 1; ++ii) {
+      arrivals[ii].store(0, std::memory_order_relaxed);
+   }
+   ParallelChunks(threads, count, [&](int first, int last, int) {
+      for (int ii = first; ii < last; ++ii) {
+         int node = nodes[LeafNode(ii)].parent;
+         while (node >= 0) {
+            if (arrivals[node].fetch_add(1, std::memory_order_acq_rel) == 0) {
+               break;
+            }
+            nodes[node].bounds = MergeBounds(nodes[nodes[node].left].bounds, nodes[nodes[node].right].bounds);
+            node = nodes[node].parent;
+         }
+      }
+   });
+}
+
+//------------------------------------------------------
+// Each thread takes a run of leaves and walks the tree
+// for each of them, keeping its own list of pairs. A pair
+// is only kept by the leaf that sorted first (unless only
+// the other one is active).
+//------------------------------------------------------
+void ParallelBroadphase::FindPairs(vector<ProxyPair>& pairs, const unsigned char* active) const
+{
+   pairs.clear();
+   if (count < 2) {
+      return;
+   }
+
+   int threads = ThreadsFor(count);
+
+   vector<vector<ProxyPair> > found(threads);
+   ParallelChunks(threads, count, [&](int first, int last, int thread) {
+      vector<ProxyPair>& threadPairs = found[thread];
+      vector<int> stack;
+      for (int ii = first; ii < last; ++ii) {
+         int item = sortedItems[ii];
+         if (active != 0 && !active[item]) {
+            continue;
+         }
+         const AABB& bounds = itemBounds[item];
+
+         stack.clear();
+         stack.push_back(0);
+         while (!stack.empty()) {
+            int nodeIndex = stack.back();
+            stack.pop_back();
+            const Node& node = nodes[nodeIndex];
+            if (!node.bounds.Overlaps(bounds)) {
+               continue;
+            }
+
+            if (IsLeaf(nodeIndex)) {
+               int other = nodeIndex - (count - 1);
+               if (other == ii) {
+                  continue;
+               }
+               bool otherActive = (active == 0 || active[node.item]);
+               if (other > ii || !otherActive) {
+                  threadPairs.push_back(ProxyPair(item, node.item));
+               }
+            }
+            else {
+               stack.push_back(node.left);
+               stack.push_back(node.right);
+            }
+         }
+      }
+   });
+
+   for (int tt = 0; tt < threads; ++tt) {
+      pairs.insert(pairs.end(), found[tt].begin(), found[tt].end());
+   }
+}
+
+//------------------------------------------------------
+// Every item whose bounds overlap the area
+//------------------------------------------------------
+void ParallelBroadphase::Query(const AABB& area, vector<int>& hits) const
+{
+   hits.clear();
+   if (count == 0) {
+      return;
+   }
+
+   vector<int> stack;
+   stack.push_back(0);
+   while (!stack.empty()) {
+      int nodeIndex = stack.back();
+      stack.pop_back();
+      const Node& node = nodes[nodeIndex];
+      if (!node.bounds.Overlaps(area)) {
+         continue;
+      }
+
+      if (IsLeaf(nodeIndex)) {
+         hits.push_back(node.item);
+      }
+      else {
+         stack.push_back(node.left);
+         stack.push_back(node.right);
+      }
+   }
+}
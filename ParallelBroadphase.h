@@ -0,0 +1,132 @@
+#ifndef PARALLELBROADPHASE_H_
+#define PARALLELBROADPHASE_H_
+
+#include "CollisionWorld.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+   //------------------------------------------------------
+   // A broadphase for very big worlds, built on every core.
+   //
+   // Build() takes everyone's bounds and:
+   //    1. gives each one a Morton code from its center
+   //       (nearby things get nearby codes)
+   //    2. radix sorts the codes, 8 bits a pass, with each
+   //       thread counting and scattering its own chunk
+   //    3. builds a linear BVH from the sorted codes. Every
+   //       inner node can be worked out on its own (Karras
+   //       2012), and the bounds are filled in bottom up,
+   //       the second thread to reach a node doing it.
+   // FindPairs() then splits the leaves between the threads,
+   // and each one walks the tree for its leaves.
+   //
+   // The threads are started once, with the broadphase (or
+   // when the thread count changes), and wait between
+   // phases, so a rebuild every step doesn't start any.
+   //
+   // Items are known by their index in the bounds passed to
+   // Build().
+   //------------------------------------------------------
+   class ParallelBroadphase
+   {
+   private:
+      struct Node
+      {
+         AABB bounds;
+         // Children. Leaves are numbered after the inner nodes.
+         int left;
+         int right;
+         int parent;
+         // For leaves, which item it is
+         int item;
+      };
+
+      int threadCount;
+      int count;
+      vector<AABB> itemBounds;
+      vector<unsigned int> codes;
+      vector<int> sortedItems;
+      vector<unsigned int> swapCodes;
+      vector<int> swapItems;
+      vector<int> histograms;
+      vector<Node> nodes;
+      // Bottom up build: how many children have reached each inner node
+      std::atomic<int>* arrivals;
+      int arrivalCapacity;
+
+      // The workers (threadCount - 1 of them; the caller is
+      // thread 0) and the phase they're working on
+      vector<std::thread> workers;
+      mutable std::mutex poolLock;
+      mutable std::condition_variable startWork;
+      mutable std::condition_variable workDone;
+      mutable void (*job)(void* work, int first, int last, int thread);
+      mutable void* jobWork;
+      mutable int jobCount;
+      mutable int jobThreads;
+      mutable unsigned int jobNumber;
+      mutable int busyWorkers;
+      bool stopping;
+
+      void StartWorkers();
+      void StopWorkers();
+      void WorkerLoop(int thread);
+      void RunJob(void (*job)(void*, int, int, int), void* work, int threads, int count) const;
+
+      template <class Work>
+      static void CallWork(void* work, int first, int last, int thread) { (*static_cast<Work*>(work))(first, last, thread); }
+
+      // Splits [0, count) into one chunk per thread and runs
+      // work(first, last, threadIndex) on each
+      template <class Work>
+      void ParallelChunks(int threads, int count, Work work) const { RunJob(&CallWork<Work>, &work, threads, count); }
+
+      // The root is always node 0 (the only leaf, when there's one item)
+      int LeafNode(int sortedIndex) const { return count - 1 + sortedIndex; }
+      int ThreadsFor(int items) const;
+      int CommonPrefix(int ii, int jj) const;
+      void BuildInnerNode(int ii);
+      void SortCodes();
+
+      ParallelBroadphase(const ParallelBroadphase&) = delete;
+      ParallelBroadphase& operator=(const ParallelBroadphase&) = delete;
+
+   public:
+      // 0 threads means one per core
+      ParallelBroadphase(int threadCount = 0);
+      ~ParallelBroadphase();
+
+      // Accessors
+      int ThreadCount() const { return threadCount; }
+      int Count() const { return count; }
+      int NodeCount() const { return (int)nodes.size(); }
+
+      // Mutators
+      void ThreadCount(int threadCount);
+
+      // Rebuilds the whole thing
+      void Build(const AABB* bounds, int count);
+      void Build(const vector<AABB>& bounds) { Build(bounds.empty() ? 0 : &bounds[0], (int)bounds.size()); }
+
+      // Every overlapping pair of items, each once. If active
+      // is given, pairs where neither item is active are skipped
+      // (and only active items walk the tree).
+      void FindPairs(vector<ProxyPair>& pairs, const unsigned char* active = 0) const;
+
+      // Every item whose bounds overlap the area
+      void Query(const AABB& area, vector<int>& hits) const;
+
+      // For walking the tree yourself. Node 0 is the root
+      // (if there are any items). Leaves have an item and no
+      // children, inner nodes the other way round.
+      bool IsLeaf(int node) const { return node >= count - 1; }
+      const AABB& NodeBounds(int node) const { return nodes[node].bounds; }
+      int LeftChild(int node) const { return nodes[node].left; }
+      int RightChild(int node) const { return nodes[node].right; }
+      int NodeItem(int node) const { return nodes[node].item; }
+   };
+
+#endif // PARALLELBROADPHASE_H_
@@ -0,0 +1,183 @@
+#include "QueryService.h"
+#include "ShapeDistance.h"
+
+#include <atomic>
+#include <thread>
+
+// Not worth starting a thread for fewer queries than this
+const int minQueriesPerThread = 32;
+// Workers grab this many queries at a time. Queries vary a
+// lot in cost, so small grabs keep everyone busy to the end.
+const int queriesPerGrab = 8;
+
+//------------------------------------------------------
+// Runs work(ii) for every ii below count, sharing them
+// out between whoever calls this at the same time
+//------------------------------------------------------
+template <typename Work>
+void DrainBatch(std::atomic<int>& next, int count, Work work)
+{
+   while (true) {
+      int first = next.fetch_add(queriesPerGrab);
+      if (first >= count) {
+         return;
+      }
+      int last = (first + queriesPerGrab < count ? first + queriesPerGrab : count);
+      for (int ii = first; ii < last; ++ii) {
+         work(ii);
+      }
+   }
+}
+
+//------------------------------------------------------
+// Constructor
+//------------------------------------------------------
+QueryService::QueryService(SnapshotPublisher& publisher, int threadCount)
+{
+   this->publisher = &publisher;
+   ThreadCount(threadCount);
+}
+
+//------------------------------------------------------
+// Sets how many threads to use. 0 means one per core.
+//------------------------------------------------------
+void QueryService::ThreadCount(int threadCount)
+{
+   if (threadCount <= 0) {
+      threadCount = (int)std::thread::hardware_concurrency();
+   }
+   this->threadCount = (threadCount > 0 ? threadCount : 1);
+}
+
+//------------------------------------------------------
+// Queues a ray cast
+//------------------------------------------------------
+std::future<CastHit> QueryService::RayCast(const Point& start, const Point& end)
+{
+   std::lock_guard<std::mutex> guard(pendingLock);
+   rays.push_back(RayQuery());
+   rays.back().start = start;
+   rays.back().end = end;
+   return rays.back().result.get_future();
+}
+
+//------------------------------------------------------
+// Queues an overlap test
+//------------------------------------------------------
+std::future<vector<int> > QueryService::Overlaps(Shape* probe)
+{
+   std::lock_guard<std::mutex> guard(pendingLock);
+   overlaps.push_back(OverlapQuery());
+   overlaps.back().probe = probe;
+   return overlaps.back().result.get_future();
+}
+
+//------------------------------------------------------
+// Queues a nearest query
+//------------------------------------------------------
+std::future<vector<NearestHit> > QueryService::Nearest(const Point& spot, int k, float maxDistance)
+{
+   std::lock_guard<std::mutex> guard(pendingLock);
+   nearest.push_back(NearestQuery());
+   nearest.back().spot = spot;
+   nearest.back().k = k;
+   nearest.back().maxDistance = maxDistance;
+   return nearest.back().result.get_future();
+}
+
+//------------------------------------------------------
+// How many queries are queued
+//------------------------------------------------------
+int QueryService::Pending()
+{
+   std::lock_guard<std::mutex> guard(pendingLock);
+   return (int)(rays.size() + overlaps.size() + nearest.size());
+}
+
+//------------------------------------------------------
+// Takes everything queued and answers it. One snapshot
+// and one set of threads serve the whole lot, and each
+// worker goes through the ray casts, then the overlaps,
+// then the nearest queries, so it keeps running the same
+// code over the same parts of the tree.
+//------------------------------------------------------
+int QueryService::Flush()
+{
+   vector<RayQuery> rays;
+   vector<OverlapQuery> overlaps;
+   vector<NearestQuery> nearest;
+   {
+      std::lock_guard<std::mutex> guard(pendingLock);
+      rays.swap(this->rays);
+      overlaps.swap(this->overlaps);
+      nearest.swap(this->nearest);
+   }
+
+   int total = (int)(rays.size() + overlaps.size() + nearest.size());
+   if (total == 0) {
+      return 0;
+   }
+
+   // Probes can fill in lazy caches the first time they're
+   // measured, so get that out of the way on this thread
+   for (unsigned int ii = 0; ii < overlaps.size(); ++ii) {
+      ShapeBounds(overlaps[ii].probe);
+   }
+
+   SnapshotRef snapshot(*publisher);
+   const WorldSnapshot* world = snapshot.Get();
+
+   std::atomic<int> nextRay(0);
+   std::atomic<int> nextOverlap(0);
+   std::atomic<int> nextNearest(0);
+
+   auto work = [&]() {
+      DrainBatch(nextRay, (int)rays.size(), [&](int ii) {
+         CastHit hit;
+         if (world != 0 && world->RayCast(rays[ii].start, rays[ii].end, hit)) {
+            hit.index = world->ProxyId(hit.index);
+         }
+         hit.shape = 0;
+         rays[ii].result.set_value(hit);
+      });
+
+      DrainBatch(nextOverlap, (int)overlaps.size(), [&](int ii) {
+         vector<int> hits;
+         if (world != 0) {
+            world->Overlaps(overlaps[ii].probe, hits);
+            for (unsigned int hh = 0; hh < hits.size(); ++hh) {
+               hits[hh] = world->ProxyId(hits[hh]);
+            }
+         }
+         overlaps[ii].result.set_value(hits);
+      });
+
+      DrainBatch(nextNearest, (int)nearest.size(), [&](int ii) {
+         vector<NearestHit> hits;
+         if (world != 0) {
+            NearestQuery& query = nearest[ii];
+            world->Index().Nearest(&query.spot, query.k, query.maxDistance, hits);
+            for (unsigned int hh = 0; hh < hits.size(); ++hh) {
+               hits[hh].index = world->ProxyId(hits[hh].index);
+               hits[hh].shape = 0;
+            }
+         }
+         nearest[ii].result.set_value(hits);
+      });
+   };
+
+   int threads = 1 + total / minQueriesPerThread;
+   if (threads > threadCount) {
+      threads = threadCount;
+   }
+   vector<std::thread> workers;
+   for (int tt = 1; tt < threads; ++tt) {
+      workers.push_back(std::thread(work));
+   }
+   work();
+   for (unsigned int ii = 0; ii < workers.size(); ++ii) {
+      workers[ii].join();
+   }
+
+   return total;
+}
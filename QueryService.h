@@ -0,0 +1,92 @@
+#ifndef QUERYSERVICE_H_
+#define QUERYSERVICE_H_
+
+#include "WorldSnapshot.h"
+
+#include <future>
+#include <mutex>
+
+   //------------------------------------------------------
+   // Answers queries in batches instead of one at a time.
+   //
+   // Any thread can ask for a ray cast, overlap test or
+   // nearest shapes and gets a std::future back right away.
+   // Nothing runs until Flush() (once a frame, say): then
+   // everything asked for so far is run against the current
+   // snapshot, each kind of query as its own batch, spread
+   // over the worker threads, and every future is filled in.
+   //
+   // Snapshot shapes don't last past the batch, so results
+   // name shapes by world proxy id: CastHit::index and
+   // NearestHit::index are proxy ids, and their shape
+   // pointers are always 0.
+   //------------------------------------------------------
+   class QueryService
+   {
+   private:
+      struct RayQuery
+      {
+         Point start;
+         Point end;
+         std::promise<CastHit> result;
+      };
+
+      struct OverlapQuery
+      {
+         Shape* probe;
+         std::promise<vector<int> > result;
+      };
+
+      struct NearestQuery
+      {
+         Point spot;
+         int k;
+         float maxDistance;
+         std::promise<vector<NearestHit> > result;
+      };
+
+      SnapshotPublisher* publisher;
+      int threadCount;
+
+      // Asked for since the last Flush()
+      std::mutex pendingLock;
+      vector<RayQuery> rays;
+      vector<OverlapQuery> overlaps;
+      vector<NearestQuery> nearest;
+
+      QueryService(const QueryService&) = delete;
+      QueryService& operator=(const QueryService&) = delete;
+
+   public:
+      // Threads used by Flush(). 0 means one per core.
+      QueryService(SnapshotPublisher& publisher, int threadCount = 0);
+
+      int ThreadCount() const { return threadCount; }
+      void ThreadCount(int threadCount);
+
+      // Any thread. The first thing a ray from start to end hits
+      // (hit.index < 0 if nothing).
+      std::future<CastHit> RayCast(const Point& start, const Point& end);
+
+      // Any thread. Proxy ids of everything the probe overlaps.
+      // The probe has to stay put until the future is ready.
+      std::future<vector<int> > Overlaps(Shape* probe);
+
+      // Any thread. Up to k shapes within maxDistance of the spot,
+      // closest first.
+      std::future<vector<NearestHit> > Nearest(const Point& spot, int k, float maxDistance);
+
+      // How many queries are waiting for the next Flush()
+      int Pending();
+
+      /*
+        Runs everything asked for so far against the current
+        snapshot and fills in the futures. Queries asked for
+        while this runs wait for the next one. Before anything
+        is published, every query comes back empty. Returns
+        how many queries were answered.
+      */
+      int Flush();
+   };
+
+#endif // QUERYSERVICE_H_
@@ -0,0 +1,562 @@
+#include "SceneFile.h"
+
+// For nth_element
+#include <algorithm>
+// For fopen/fwrite
+#include <cstdio>
+// For memcpy
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// How many shapes a BVH leaf can hold
+const int sceneLeafSize = 4;
+
+//------------------------------------------------------
+// The file is raw little endian, so the host has to be too
+//------------------------------------------------------
+bool HostIsLittleEndian() {
+   unsigned int one = 1;
+   return *(unsigned char*)&one == 1;
+}
+
+//------------------------------------------------------
+// Pads a buffer out to the next 16 bytes
+//------------------------------------------------------
+void AlignBuffer(vector<unsigned char>& buffer) {
+   while (buffer.size() % 16 != 0) {
+      buffer.push_back(0);
+   }
+}
+
+//------------------------------------------------------
+// Appends raw data to a buffer
+//------------------------------------------------------
+void AppendBytes(vector<unsigned char>& buffer, const void* data, size_t bytes) {
+   if (bytes > 0) {
+      size_t start = buffer.size();
+      buffer.resize(start + bytes);
+      memcpy(&buffer[start], data, bytes);
+   }
+}
+
+template <class T>
+void AppendArray(vector<unsigned char>& buffer, const vector<T>& values) {
+   AppendBytes(buffer, values.size() > 0 ? &values[0] : 0, values.size() * sizeof(T));
+}
+
+//------------------------------------------------------
+// A shape while the BVH is being built
+//------------------------------------------------------
+struct SceneItem
+{
+   AABB bounds;
+   unsigned int ref;
+};
+
+struct SceneItemLess
+{
+   bool xAxis;
+   bool operator()(const SceneItem& a, const SceneItem& b) const {
+      return (xAxis ? (a.bounds.minX + a.bounds.maxX) < (b.bounds.minX + b.bounds.maxX)
+         : (a.bounds.minY + a.bounds.maxY) < (b.bounds.minY + b.bounds.maxY));
+   }
+};
+
+//------------------------------------------------------
+// Builds a BVH node (same layout as StaticMesh's), with
+// the left child right after its parent
+//------------------------------------------------------
+int BuildSceneNode(vector<StaticNode>& nodes, vector<SceneItem>& items, int first, int count) {
+   int nodeIndex = (int)nodes.size();
+   nodes.push_back(StaticNode());
+
+   AABB bounds = items[first].bounds;
+   for (int ii = first + 1; ii < first + count; ++ii) {
+      const AABB& current = items[ii].bounds;
+      if (current.minX < bounds.minX) bounds.minX = current.minX;
+      if (current.minY < bounds.minY) bounds.minY = current.minY;
+      if (current.maxX > bounds.maxX) bounds.maxX = current.maxX;
+      if (current.maxY > bounds.maxY) bounds.maxY = current.maxY;
+   }
+   nodes[nodeIndex].bounds = bounds;
+   nodes[nodeIndex].pad[0] = nodes[nodeIndex].pad[1] = 0;
+
+   if (count <= sceneLeafSize) {
+      nodes[nodeIndex].index = first;
+      nodes[nodeIndex].count = count;
+      return nodeIndex;
+   }
+
+   SceneItemLess less;
+   less.xAxis = (bounds.maxX - bounds.minX) >= (bounds.maxY - bounds.minY);
+   int half = count / 2;
+   std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count, less);
+
+   BuildSceneNode(nodes, items, first, half);
+   int right = BuildSceneNode(nodes, items, first + half, count - half);
+   nodes[nodeIndex].index = right;
+   nodes[nodeIndex].count = 0;
+   return nodeIndex;
+}
+
+//------------------------------------------------------
+// Writes shapes out to a scene file. Chains and compounds
+// have no section, so rather than leave them out of the
+// file without a word, nothing gets written.
+//------------------------------------------------------
+bool WriteScene(const char* path, const vector<Shape*>& shapes, bool includeBvh)
+{
+   if (!HostIsLittleEndian()) {
+      return false;
+   }
+
+   // Sort the shapes by type
+   vector<Point*> pointShapes;
+   vector<Line*> lineShapes;
+   vector<Circle*> circleShapes;
+   vector<Box*> boxShapes;
+   for (unsigned int ii = 0; ii < shapes.size(); ++ii) {
+      if (shapes[ii] == 0) continue;
+      switch (shapes[ii]->Type()) {
+         case SHAPE_POINT: pointShapes.push_back(dynamic_cast<Point*>(shapes[ii])); break;
+         case LINE: lineShapes.push_back(dynamic_cast<Line*>(shapes[ii])); break;
+         case CIRCLE: circleShapes.push_back(dynamic_cast<Circle*>(shapes[ii])); break;
+         case BOX: boxShapes.push_back(dynamic_cast<Box*>(shapes[ii])); break;
+         default: return false;
+      };
+   }
+
+   SceneHeader header;
+   memset(&header, 0, sizeof(header));
+   header.magic = sceneMagic;
+   header.version = sceneVersion;
+   header.pointCount = (unsigned int)pointShapes.size();
+   header.lineCount = (unsigned int)lineShapes.size();
+   header.circleCount = (unsigned int)circleShapes.size();
+   header.boxCount = (unsigned int)boxShapes.size();
+
+   vector<unsigned char> buffer(sizeof(SceneHeader), 0);
+   vector<float> field;
+   vector<unsigned short> categories;
+   vector<unsigned short> masks;
+   vector<short> groups;
+   vector<SceneItem> items;
+
+   // Points
+   AlignBuffer(buffer);
+   header.pointOffset = (unsigned int)buffer.size();
+   for (int axis = 0; axis < 2; ++axis) {
+      field.clear();
+      for (unsigned int ii = 0; ii < pointShapes.size(); ++ii) {
+         field.push_back(axis == 0 ? pointShapes[ii]->X() : pointShapes[ii]->Y());
+      }
+      AppendArray(buffer, field);
+   }
+
+   // Lines
+   AlignBuffer(buffer);
+   header.lineOffset = (unsigned int)buffer.size();
+   for (int which = 0; which < 4; ++which) {
+      field.clear();
+      for (unsigned int ii = 0; ii < lineShapes.size(); ++ii) {
+         Line* line = lineShapes[ii];
+         field.push_back(which == 0 ? line->StartX() : (which == 1 ? line->StartY() : (which == 2 ? line->EndX() : line->EndY())));
+      }
+      AppendArray(buffer, field);
+   }
+
+   // Circles
+   AlignBuffer(buffer);
+   header.circleOffset = (unsigned int)buffer.size();
+   for (int which = 0; which < 3; ++which) {
+      field.clear();
+      for (unsigned int ii = 0; ii < circleShapes.size(); ++ii) {
+         Circle* circle = circleShapes[ii];
+         field.push_back(which == 0 ? circle->CenterX() : (which == 1 ? circle->CenterY() : circle->Radius()));
+      }
+      AppendArray(buffer, field);
+   }
+
+   // Boxes, with everything already worked out
+   AlignBuffer(buffer);
+   header.boxOffset = (unsigned int)buffer.size();
+   vector<AABB> boxBounds;
+   for (unsigned int ii = 0; ii < boxShapes.size(); ++ii) {
+      boxBounds.push_back(ShapeBounds(boxShapes[ii]));
+   }
+   for (int which = 0; which < SceneBoxes::MAX_FIELDS; ++which) {
+      field.clear();
+      for (unsigned int ii = 0; ii < boxShapes.size(); ++ii) {
+         Box* box = boxShapes[ii];
+         float x, y;
+         float value = 0.0f;
+         switch (which) {
+            case SceneBoxes::CENTER_X: value = box->Center().X(); break;
+            case SceneBoxes::CENTER_Y: value = box->Center().Y(); break;
+            case SceneBoxes::WIDTH: value = box->Width(); break;
+            case SceneBoxes::HEIGHT: value = box->Height(); break;
+            case SceneBoxes::ROTATION: value = box->Rotation(); break;
+            case SceneBoxes::DIAGONAL_LENGTH: value = box->DiagonalLength(); break;
+            case SceneBoxes::TOPLEFT_X: value = box->Diagonal(Box::TOPLEFT).X(); break;
+            case SceneBoxes::TOPLEFT_Y: value = box->Diagonal(Box::TOPLEFT).Y(); break;
+            case SceneBoxes::TOPRIGHT_X: value = box->Diagonal(Box::TOPRIGHT).X(); break;
+            case SceneBoxes::TOPRIGHT_Y: value = box->Diagonal(Box::TOPRIGHT).Y(); break;
+            case SceneBoxes::NORMAL0_X: box->Normal(0, x, y); value = x; break;
+            case SceneBoxes::NORMAL0_Y: box->Normal(0, x, y); value = y; break;
+            case SceneBoxes::NORMAL1_X: box->Normal(1, x, y); value = x; break;
+            case SceneBoxes::NORMAL1_Y: box->Normal(1, x, y); value = y; break;
+            case SceneBoxes::MIN_X: value = boxBounds[ii].minX; break;
+            case SceneBoxes::MIN_Y: value = boxBounds[ii].minY; break;
+            case SceneBoxes::MAX_X: value = boxBounds[ii].maxX; break;
+            case SceneBoxes::MAX_Y: value = boxBounds[ii].maxY; break;
+            default: break;
+         };
+         field.push_back(value);
+      }
+      AppendArray(buffer, field);
+   }
+
+   // Filters (and BVH items), in section order
+   for (unsigned int ii = 0; ii < pointShapes.size(); ++ii) {
+      categories.push_back(pointShapes[ii]->CategoryBits());
+      masks.push_back(pointShapes[ii]->MaskBits());
+      groups.push_back(pointShapes[ii]->GroupIndex());
+      SceneItem item = { ShapeBounds(pointShapes[ii]), SceneRef(SHAPE_POINT, ii) };
+      items.push_back(item);
+   }
+   for (unsigned int ii = 0; ii < lineShapes.size(); ++ii) {
+      categories.push_back(lineShapes[ii]->CategoryBits());
+      masks.push_back(lineShapes[ii]->MaskBits());
+      groups.push_back(lineShapes[ii]->GroupIndex());
+      SceneItem item = { ShapeBounds(lineShapes[ii]), SceneRef(LINE, ii) };
+      items.push_back(item);
+   }
+   for (unsigned int ii = 0; ii < circleShapes.size(); ++ii) {
+      categories.push_back(circleShapes[ii]->CategoryBits());
+      masks.push_back(circleShapes[ii]->MaskBits());
+      groups.push_back(circleShapes[ii]->GroupIndex());
+      SceneItem item = { ShapeBounds(circleShapes[ii]), SceneRef(CIRCLE, ii) };
+      items.push_back(item);
+   }
+   for (unsigned int ii = 0; ii < boxShapes.size(); ++ii) {
+      categories.push_back(boxShapes[ii]->CategoryBits());
+      masks.push_back(boxShapes[ii]->MaskBits());
+      groups.push_back(boxShapes[ii]->GroupIndex());
+      SceneItem item = { boxBounds[ii], SceneRef(BOX, ii) };
+      items.push_back(item);
+   }
+   AlignBuffer(buffer);
+   header.filterOffset = (unsigned int)buffer.size();
+   AppendArray(buffer, categories);
+   AppendArray(buffer, masks);
+   AppendArray(buffer, groups);
+
+   // The BVH
+   if (includeBvh && items.size() > 0) {
+      vector<StaticNode> nodes;
+      nodes.reserve(items.size() * 2 / sceneLeafSize + 1);
+      BuildSceneNode(nodes, items, 0, (int)items.size());
+
+      vector<unsigned int> refs;
+      for (unsigned int ii = 0; ii < items.size(); ++ii) {
+         refs.push_back(items[ii].ref);
+      }
+
+      AlignBuffer(buffer);
+      header.nodeOffset = (unsigned int)buffer.size();
+      header.nodeCount = (unsigned int)nodes.size();
+      AppendArray(buffer, nodes);
+      AlignBuffer(buffer);
+      header.refOffset = (unsigned int)buffer.size();
+      AppendArray(buffer, refs);
+   }
+
+   AlignBuffer(buffer);
+   header.fileSize = (unsigned int)buffer.size();
+   memcpy(&buffer[0], &header, sizeof(header));
+
+   FILE* file = fopen(path, "wb");
+   if (file == 0) {
+      return false;
+   }
+   bool written = fwrite(&buffer[0], 1, buffer.size(), file) == buffer.size();
+   written = (fclose(file) == 0) && written;
+   return written;
+}
+
+//------------------------------------------------------
+// Constructor. Nothing is open yet.
+//------------------------------------------------------
+SceneView::SceneView()
+{
+   data = 0;
+   size = 0;
+   fileHandle = 0;
+   mappingHandle = 0;
+   memset(&header, 0, sizeof(header));
+}
+
+//------------------------------------------------------
+// Maps a scene file into memory, and points the views at it
+//------------------------------------------------------
+bool SceneView::Open(const char* path)
+{
+   Close();
+   if (!HostIsLittleEndian()) {
+      return false;
+   }
+
+#ifdef _WIN32
+   HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+   if (file == INVALID_HANDLE_VALUE) {
+      return false;
+   }
+   LARGE_INTEGER fileSize;
+   if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+      CloseHandle(file);
+      return false;
+   }
+   HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+   if (mapping == 0) {
+      CloseHandle(file);
+      return false;
+   }
+   data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   if (data == 0) {
+      CloseHandle(mapping);
+      CloseHandle(file);
+      return false;
+   }
+   fileHandle = file;
+   mappingHandle = mapping;
+   size = (size_t)fileSize.QuadPart;
+#else
+   int file = open(path, O_RDONLY);
+   if (file < 0) {
+      return false;
+   }
+   struct stat info;
+   if (fstat(file, &info) != 0 || info.st_size == 0) {
+      close(file);
+      return false;
+   }
+   void* mapped = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+   // The mapping stays good after the file is closed
+   close(file);
+   if (mapped == MAP_FAILED) {
+      return false;
+   }
+   data = (const unsigned char*)mapped;
+   size = (size_t)info.st_size;
+#endif
+
+   if (!Validate()) {
+      Close();
+      return false;
+   }
+   return true;
+}
+
+//------------------------------------------------------
+// Unmaps the file. Every view becomes bad.
+//------------------------------------------------------
+void SceneView::Close()
+{
+   if (data != 0) {
+#ifdef _WIN32
+      UnmapViewOfFile(data);
+      CloseHandle((HANDLE)mappingHandle);
+      CloseHandle((HANDLE)fileHandle);
+#else
+      munmap((void*)data, size);
+#endif
+   }
+   data = 0;
+   size = 0;
+   fileHandle = 0;
+   mappingHandle = 0;
+   memset(&header, 0, sizeof(header));
+}
+
+//------------------------------------------------------
+// Checks the header, and that every section fits in the
+// file, then points the views at the sections. The BVH is
+// checked too, so a bad file can't send a walk of it off
+// the end of anything.
+//------------------------------------------------------
+bool SceneView::Validate()
+{
+   if (size < sizeof(SceneHeader)) {
+      return false;
+   }
+   memcpy(&header, data, sizeof(header));
+   if (header.magic != sceneMagic || header.version != sceneVersion || header.fileSize > size) {
+      return false;
+   }
+
+   // Refs only have 28 bits for the index
+   if (header.pointCount > 0x0FFFFFFF || header.lineCount > 0x0FFFFFFF
+      || header.circleCount > 0x0FFFFFFF || header.boxCount > 0x0FFFFFFF) {
+      return false;
+   }
+
+   unsigned long long total = (unsigned long long)header.pointCount + header.lineCount + header.circleCount + header.boxCount;
+   struct Section { unsigned int offset; unsigned long long bytes; } sections[] = {
+      { header.pointOffset, 2ull * header.pointCount * sizeof(float) },
+      { header.lineOffset, 4ull * header.lineCount * sizeof(float) },
+      { header.circleOffset, 3ull * header.circleCount * sizeof(float) },
+      { header.boxOffset, (unsigned long long)SceneBoxes::MAX_FIELDS * header.boxCount * sizeof(float) },
+      { header.filterOffset, 3ull * total * sizeof(unsigned short) },
+      { header.nodeOffset, (unsigned long long)header.nodeCount * sizeof(StaticNode) },
+      { header.refOffset, (header.nodeCount > 0 ? total * sizeof(unsigned int) : 0ull) }
+   };
+   for (unsigned int ii = 0; ii < sizeof(sections) / sizeof(sections[0]); ++ii) {
+      if (sections[ii].offset % 4 != 0 || sections[ii].offset + sections[ii].bytes > header.fileSize) {
+         return false;
+      }
+   }
+
+   const float* floats = (const float*)(data + header.pointOffset);
+   points.count = header.pointCount;
+   points.x = floats;
+   points.y = floats + header.pointCount;
+
+   floats = (const float*)(data + header.lineOffset);
+   lines.count = header.lineCount;
+   lines.startX = floats;
+   lines.startY = floats + header.lineCount;
+   lines.endX = floats + header.lineCount * 2;
+   lines.endY = floats + header.lineCount * 3;
+
+   floats = (const float*)(data + header.circleOffset);
+   circles.count = header.circleCount;
+   circles.centerX = floats;
+   circles.centerY = floats + header.circleCount;
+   circles.radius = floats + header.circleCount * 2;
+
+   floats = (const float*)(data + header.boxOffset);
+   boxes.count = header.boxCount;
+   for (int ii = 0; ii < SceneBoxes::MAX_FIELDS; ++ii) {
+      boxes.fields[ii] = floats + header.boxCount * ii;
+   }
+
+   const unsigned short* shorts = (const unsigned short*)(data + header.filterOffset);
+   filters.category = shorts;
+   filters.mask = shorts + total;
+   filters.group = (const short*)(shorts + total * 2);
+
+   // Every node's children come after it (so walking the
+   // tree can't loop), every leaf's refs are in the file,
+   // and every ref names a shape that's there
+   const StaticNode* nodes = Nodes();
+   for (unsigned int ii = 0; ii < header.nodeCount; ++ii) {
+      const StaticNode& node = nodes[ii];
+      if (node.count < 0 || node.index < 0) {
+         return false;
+      }
+      if (node.count == 0) {
+         if (ii + 1 >= header.nodeCount || (unsigned int)node.index <= ii || (unsigned int)node.index >= header.nodeCount) {
+            return false;
+         }
+      }
+      else if ((unsigned long long)node.index + node.count > total) {
+         return false;
+      }
+   }
+
+   const unsigned int* refs = Refs();
+   unsigned int counts[BOX + 1] = { header.pointCount, header.lineCount, header.circleCount, header.boxCount };
+   for (unsigned int ii = 0; refs != 0 && ii < total; ++ii) {
+      // The type bits are checked raw, since not every 4 bit value is a ShapeType
+      if ((refs[ii] >> 28) > BOX || SceneRefIndex(refs[ii]) >= counts[SceneRefType(refs[ii])]) {
+         return false;
+      }
+   }
+   return true;
+}
+
+//------------------------------------------------------
+// Where a shape's filter lives in the filter arrays
+//------------------------------------------------------
+unsigned int SceneView::FilterIndex(ShapeType type, unsigned int index) const
+{
+   switch (type) {
+      case SHAPE_POINT: return index;
+      case LINE: return header.pointCount + index;
+      case CIRCLE: return header.pointCount + header.lineCount + index;
+      case BOX:
+      default: return header.pointCount + header.lineCount + header.circleCount + index;
+   };
+}
+
+//------------------------------------------------------
+// Gets the filter of a shape in the file
+//------------------------------------------------------
+CollisionFilter SceneView::Filter(ShapeType type, unsigned int index) const
+{
+   unsigned int filterIndex = FilterIndex(type, index);
+   return CollisionFilter(filters.category[filterIndex], filters.mask[filterIndex], filters.group[filterIndex]);
+}
+
+//------------------------------------------------------
+// BVH accessors
+//------------------------------------------------------
+const StaticNode* SceneView::Nodes() const
+{
+   return (header.nodeCount > 0 ? (const StaticNode*)(data + header.nodeOffset) : 0);
+}
+
+const unsigned int* SceneView::Refs() const
+{
+   return (header.nodeCount > 0 ? (const unsigned int*)(data + header.refOffset) : 0);
+}
+
+//------------------------------------------------------
+// Live shape makers
+//------------------------------------------------------
+Point SceneView::MakePoint(unsigned int index) const
+{
+   Point point(points.x[index], points.y[index]);
+   point.Filter(Filter(SHAPE_POINT, index));
+   return point;
+}
+
+Line SceneView::MakeLine(unsigned int index) const
+{
+   Line line(lines.startX[index], lines.startY[index], lines.endX[index], lines.endY[index]);
+   line.Filter(Filter(LINE, index));
+   return line;
+}
+
+Circle SceneView::MakeCircle(unsigned int index) const
+{
+   Circle circle(circles.centerX[index], circles.centerY[index], circles.radius[index]);
+   circle.Filter(Filter(CIRCLE, index));
+   return circle;
+}
+
+//------------------------------------------------------
+// Makes a box from the saved diagonals/normals (no trig)
+//------------------------------------------------------
+Box SceneView::MakeBox(unsigned int index) const
+{
+   const float* const* field = boxes.fields;
+   Box box(Point(field[SceneBoxes::CENTER_X][index], field[SceneBoxes::CENTER_Y][index]),
+      field[SceneBoxes::WIDTH][index], field[SceneBoxes::HEIGHT][index], field[SceneBoxes::ROTATION][index],
+      field[SceneBoxes::DIAGONAL_LENGTH][index],
+      Point(field[SceneBoxes::TOPLEFT_X][index], field[SceneBoxes::TOPLEFT_Y][index]),
+      Point(field[SceneBoxes::TOPRIGHT_X][index], field[SceneBoxes::TOPRIGHT_Y][index]),
+      Point(field[SceneBoxes::NORMAL0_X][index], field[SceneBoxes::NORMAL0_Y][index]),
+      Point(field[SceneBoxes::NORMAL1_X][index], field[SceneBoxes::NORMAL1_Y][index]));
+   box.Filter(Filter(BOX, index));
+   return box;
+}
@@ -0,0 +1,177 @@
+#ifndef SCENEFILE_H_
+#define SCENEFILE_H_
+
+#include "Collisions.h"
+#include "StaticMesh.h"
+
+   //------------------------------------------------------
+   // Binary scene files.
+   //
+   // Everything is little endian. The file is a 64 byte
+   // header followed by sections, each starting on a 16
+   // byte boundary. Shapes are stored as arrays of each
+   // field (all the x's, then all the y's...) so a loaded
+   // file can be used straight out of memory. Boxes store
+   // everything CalculateDiagonals works out, plus their
+   // bounds, so nothing gets recalculated on load.
+   //
+   // Sections, in order:
+   //    points:  x, y
+   //    lines:   startX, startY, endX, endY
+   //    circles: centerX, centerY, radius
+   //    boxes:   see SceneBoxes
+   //    filters: category, mask, group for every shape
+   //             (points, then lines, circles, boxes)
+   //    BVH nodes and the shape refs they point at (optional)
+   //------------------------------------------------------
+   const unsigned int sceneMagic = 0x53443243; // "C2DS"
+   const unsigned int sceneVersion = 1;
+
+   struct SceneHeader
+   {
+      unsigned int magic;
+      unsigned int version;
+      unsigned int flags;
+      unsigned int pointCount;
+      unsigned int lineCount;
+      unsigned int circleCount;
+      unsigned int boxCount;
+      unsigned int nodeCount;
+      unsigned int pointOffset;
+      unsigned int lineOffset;
+      unsigned int circleOffset;
+      unsigned int boxOffset;
+      unsigned int filterOffset;
+      unsigned int nodeOffset;
+      unsigned int refOffset;
+      unsigned int fileSize;
+   };
+
+   // A BVH ref is the shape type in the top 4 bits, and its index in the rest
+   inline unsigned int SceneRef(ShapeType type, unsigned int index) { return ((unsigned int)type << 28) | index; }
+   inline ShapeType SceneRefType(unsigned int ref) { return (ShapeType)(ref >> 28); }
+   inline unsigned int SceneRefIndex(unsigned int ref) { return ref & 0x0FFFFFFF; }
+
+   //------------------------------------------------------
+   // Views straight into a loaded file
+   //------------------------------------------------------
+   struct ScenePoints
+   {
+      unsigned int count;
+      const float* x;
+      const float* y;
+   };
+
+   struct SceneLines
+   {
+      unsigned int count;
+      const float* startX;
+      const float* startY;
+      const float* endX;
+      const float* endY;
+   };
+
+   struct SceneCircles
+   {
+      unsigned int count;
+      const float* centerX;
+      const float* centerY;
+      const float* radius;
+   };
+
+   struct SceneBoxes
+   {
+      enum FIELD {
+         CENTER_X = 0,
+         CENTER_Y,
+         WIDTH,
+         HEIGHT,
+         ROTATION,
+         DIAGONAL_LENGTH,
+         TOPLEFT_X,
+         TOPLEFT_Y,
+         TOPRIGHT_X,
+         TOPRIGHT_Y,
+         NORMAL0_X,
+         NORMAL0_Y,
+         NORMAL1_X,
+         NORMAL1_Y,
+         MIN_X,
+         MIN_Y,
+         MAX_X,
+         MAX_Y,
+         MAX_FIELDS
+      };
+
+      unsigned int count;
+      const float* fields[MAX_FIELDS];
+   };
+
+   struct SceneFilters
+   {
+      const unsigned short* category;
+      const unsigned short* mask;
+      const short* group;
+   };
+
+   // Writes a scene file from live shapes. Returns false if it couldn't,
+   // or if there's a chain or compound (the format has no room for them).
+   bool WriteScene(const char* path, const vector<Shape*>& shapes, bool includeBvh = true);
+
+   //------------------------------------------------------
+   // A scene file mapped into memory. Nothing is parsed or
+   // copied: the views point right into the mapping, and
+   // stay good until Close().
+   //------------------------------------------------------
+   class SceneView
+   {
+   private:
+      const unsigned char* data;
+      size_t size;
+      // Platform handles for the mapping
+      void* fileHandle;
+      void* mappingHandle;
+
+      SceneHeader header;
+      ScenePoints points;
+      SceneLines lines;
+      SceneCircles circles;
+      SceneBoxes boxes;
+      SceneFilters filters;
+
+      bool Validate();
+      unsigned int FilterIndex(ShapeType type, unsigned int index) const;
+
+      SceneView(const SceneView&) = delete;
+      SceneView& operator=(const SceneView&) = delete;
+
+   public:
+      SceneView();
+      ~SceneView() { Close(); }
+
+      // Maps the file. Returns false if it isn't a valid scene.
+      bool Open(const char* path);
+      void Close();
+      bool IsOpen() const { return data != 0; }
+
+      // Accessors
+      const SceneHeader& Header() const { return header; }
+      const ScenePoints& Points() const { return points; }
+      const SceneLines& Lines() const { return lines; }
+      const SceneCircles& Circles() const { return circles; }
+      const SceneBoxes& Boxes() const { return boxes; }
+      CollisionFilter Filter(ShapeType type, unsigned int index) const;
+
+      // The BVH (0 if the file was written without one)
+      unsigned int NodeCount() const { return header.nodeCount; }
+      const StaticNode* Nodes() const;
+      const unsigned int* Refs() const;
+
+      // Makes live shapes, when a real Shape is needed
+      Point MakePoint(unsigned int index) const;
+      Line MakeLine(unsigned int index) const;
+      Circle MakeCircle(unsigned int index) const;
+      Box MakeBox(unsigned int index) const;
+   };
+
+#endif // SCENEFILE_H_
@@ -0,0 +1,355 @@
+#include "SegmentIntersect.h"
+
+// For sort
+#include <algorithm>
+// For fabs, fabsf
+#include <cmath>
+
+// How many segments of b get tested against one of a at a time
+const int segmentBlock = 64;
+
+// Rounding error of the double orientation is always less than
+// this times the size of its terms (Shewchuk's ccwerrboundA)
+const double orientationBound = 3.3306690738754716e-16;
+
+//------------------------------------------------------
+// -1, 0 or 1, with no branches
+//------------------------------------------------------
+inline int SignOf(float value)
+{
+   return (value > 0.0f) - (value < 0.0f);
+}
+
+inline int SignOf(double value)
+{
+   return (value > 0.0) - (value < 0.0);
+}
+
+//------------------------------------------------------
+// Twice the signed area of a, b, c
+//------------------------------------------------------
+inline float Area(float ax, float ay, float bx, float by, float cx, float cy)
+{
+   return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+
+//------------------------------------------------------
+// Orientation, rounding and all
+//------------------------------------------------------
+int Orientation(float ax, float ay, float bx, float by, float cx, float cy)
+{
+   return SignOf(Area(ax, ay, bx, by, cx, cy));
+}
+
+//------------------------------------------------------
+// Adds a and b. sum is the rounded answer and error is
+// exactly what the rounding lost.
+//------------------------------------------------------
+inline void TwoSum(double a, double b, double& sum, double& error)
+{
+   sum = a + b;
+   double bVirtual = sum - a;
+   double aVirtual = sum - bVirtual;
+   error = (a - aVirtual) + (b - bVirtual);
+}
+
+//------------------------------------------------------
+// Exact orientation. Two floats multiply exactly into a
+// double, so the determinant is six exact products, and
+// those get added into an expansion (a list of doubles,
+// smallest first, that add up to the answer exactly).
+// The answer's sign is the sign of the biggest one.
+//------------------------------------------------------
+int ExactOrientation(float ax, float ay, float bx, float by, float cx, float cy)
+{
+   // Doubles first, which settles nearly everything
+   double left = ((double)ax - cx) * ((double)by - cy);
+   double right = ((double)ay - cy) * ((double)bx - cx);
+   double determinant = left - right;
+   double bound = orientationBound * (fabs(left) + fabs(right));
+   if (determinant > bound || -determinant > bound) {
+      return SignOf(determinant);
+   }
+
+   // (ax - cx)(by - cy) - (ay - cy)(bx - cx), multiplied out
+   double terms[6] = {
+      (double)ax * by, -(double)ax * cy, -(double)cx * by,
+      -(double)ay * bx, (double)ay * cx, (double)cy * bx
+   };
+
+   double expansion[6];
+   int length = 0;
+   for (int tt = 0; tt < 6; ++tt) {
+      double carry = terms[tt];
+      for (int ee = 0; ee < length; ++ee) {
+         TwoSum(carry, expansion[ee], carry, expansion[ee]);
+      }
+      expansion[length++] = carry;
+   }
+
+   for (int ee = length - 1; ee >= 0; --ee) {
+      if (expansion[ee] != 0.0) {
+         return SignOf(expansion[ee]);
+      }
+   }
+   return 0;
+}
+
+//------------------------------------------------------
+// Adds a segment
+//------------------------------------------------------
+void SegmentSet::Add(float startX, float startY, float endX, float endY)
+{
+   this->startX.push_back(startX);
+   this->startY.push_back(startY);
+   this->endX.push_back(endX);
+   this->endY.push_back(endY);
+}
+
+//------------------------------------------------------
+// Empties the set
+//------------------------------------------------------
+void SegmentSet::Clear()
+{
+   startX.clear();
+   startY.clear();
+   endX.clear();
+   endY.clear();
+}
+
+//------------------------------------------------------
+// The middle of the part two segments on the same line
+// share. Everything is measured along the longer one.
+//------------------------------------------------------
+bool SharedMiddle(float startXA, float startYA, float endXA, float endYA,
+   float startXB, float startYB, float endXB, float endYB, float& x, float& y)
+{
+   float dxA = endXA - startXA, dyA = endYA - startYA;
+   float dxB = endXB - startXB, dyB = endYB - startYB;
+   bool alongA = (dxA * dxA + dyA * dyA >= dxB * dxB + dyB * dyB);
+   float originX = (alongA ? startXA : startXB);
+   float originY = (alongA ? startYA : startYB);
+   float dx = (alongA ? dxA : dxB);
+   float dy = (alongA ? dyA : dyB);
+   float lengthSquared = dx * dx + dy * dy;
+   if (lengthSquared == 0.0f) {
+      // Both are points, and the same point
+      x = startXA;
+      y = startYA;
+      return true;
+   }
+
+   float a0 = (startXA - originX) * dx + (startYA - originY) * dy;
+   float a1 = (endXA - originX) * dx + (endYA - originY) * dy;
+   float b0 = (startXB - originX) * dx + (startYB - originY) * dy;
+   float b1 = (endXB - originX) * dx + (endYB - originY) * dy;
+   float low = std::max(std::min(a0, a1), std::min(b0, b1));
+   float high = std::min(std::max(a0, a1), std::max(b0, b1));
+   if (low > high) {
+      return false;
+   }
+
+   float middle = (low + high) * 0.5f / lengthSquared;
+   x = originX + dx * middle;
+   y = originY + dy * middle;
+   return true;
+}
+
+//------------------------------------------------------
+// One pair. The signs say whether they meet; the areas
+// say where, measured along whichever segment the other
+// one crosses most squarely.
+//------------------------------------------------------
+bool IntersectSegments(float startXA, float startYA, float endXA, float endYA,
+   float startXB, float startYB, float endXB, float endYB, SegmentHit& hit, bool exact)
+{
+   // Bounds first: the signs alone can't tell collinear
+   // segments that overlap from ones that don't
+   if (std::max(startXA, endXA) < std::min(startXB, endXB) || std::max(startXB, endXB) < std::min(startXA, endXA)
+      || std::max(startYA, endYA) < std::min(startYB, endYB) || std::max(startYB, endYB) < std::min(startYA, endYA)) {
+      return false;
+   }
+
+   int (*orientation)(float, float, float, float, float, float) = (exact ? ExactOrientation : Orientation);
+   int sideStartB = orientation(startXA, startYA, endXA, endYA, startXB, startYB);
+   int sideEndB = orientation(startXA, startYA, endXA, endYA, endXB, endYB);
+   int sideStartA = orientation(startXB, startYB, endXB, endYB, startXA, startYA);
+   int sideEndA = orientation(startXB, startYB, endXB, endYB, endXA, endYA);
+   if (sideStartB * sideEndB > 0 || sideStartA * sideEndA > 0) {
+      return false;
+   }
+
+   if ((sideStartB == 0 && sideEndB == 0) || (sideStartA == 0 && sideEndA == 0)) {
+      // On the same line (or one of them is a point on the other)
+      hit.collinear = true;
+      return SharedMiddle(startXA, startYA, endXA, endYA, startXB, startYB, endXB, endYB, hit.x, hit.y);
+   }
+
+   float areaStartA = Area(startXB, startYB, endXB, endYB, startXA, startYA);
+   float areaEndA = Area(startXB, startYB, endXB, endYB, endXA, endYA);
+   float areaStartB = Area(startXA, startYA, endXA, endYA, startXB, startYB);
+   float areaEndB = Area(startXA, startYA, endXA, endYA, endXB, endYB);
+   float acrossA = areaStartA - areaEndA;
+   float acrossB = areaStartB - areaEndB;
+
+   hit.collinear = false;
+   if (fabsf(acrossA) >= fabsf(acrossB) && acrossA != 0.0f) {
+      float along = std::min(std::max(areaStartA / acrossA, 0.0f), 1.0f);
+      hit.x = startXA + (endXA - startXA) * along;
+      hit.y = startYA + (endYA - startYA) * along;
+   }
+   else if (acrossB != 0.0f) {
+      float along = std::min(std::max(areaStartB / acrossB, 0.0f), 1.0f);
+      hit.x = startXB + (endXB - startXB) * along;
+      hit.y = startYB + (endYB - startYB) * along;
+   }
+   else {
+      // The exact signs say they cross, but too close to
+      // parallel for floats to say where. Anywhere on both will do.
+      hit.x = (std::max(std::min(startXA, endXA), std::min(startXB, endXB)) + std::min(std::max(startXA, endXA), std::max(startXB, endXB))) * 0.5f;
+      hit.y = (std::max(std::min(startYA, endYA), std::min(startYB, endYB)) + std::min(std::max(startYA, endYA), std::max(startYB, endYB))) * 0.5f;
+   }
+   return true;
+}
+
+//------------------------------------------------------
+// a against b, one block of b at a time
+//------------------------------------------------------
+int IntersectSegments(const SegmentSet& a, const SegmentSet& b, vector<SegmentHit>& hits, bool exact)
+{
+   hits.clear();
+   int countA = a.Count();
+   int countB = b.Count();
+
+   unsigned char maybe[segmentBlock];
+   for (int ii = 0; ii < countA; ++ii) {
+      float startXA = a.startX[ii], startYA = a.startY[ii];
+      float endXA = a.endX[ii], endYA = a.endY[ii];
+      float minXA = std::min(startXA, endXA), maxXA = std::max(startXA, endXA);
+      float minYA = std::min(startYA, endYA), maxYA = std::max(startYA, endYA);
+
+      for (int first = 0; first < countB; first += segmentBlock) {
+         int count = std::min(countB - first, segmentBlock);
+         const float* startXB = &b.startX[first];
+         const float* startYB = &b.startY[first];
+         const float* endXB = &b.endX[first];
+         const float* endYB = &b.endY[first];
+
+         // Straight through, no branches, so it vectorises
+         for (int jj = 0; jj < count; ++jj) {
+            bool boundsTouch = (std::min(startXB[jj], endXB[jj]) <= maxXA) & (std::max(startXB[jj], endXB[jj]) >= minXA)
+               & (std::min(startYB[jj], endYB[jj]) <= maxYA) & (std::max(startYB[jj], endYB[jj]) >= minYA);
+            int sideStartB = SignOf(Area(startXA, startYA, endXA, endYA, startXB[jj], startYB[jj]));
+            int sideEndB = SignOf(Area(startXA, startYA, endXA, endYA, endXB[jj], endYB[jj]));
+            int sideStartA = SignOf(Area(startXB[jj], startYB[jj], endXB[jj], endYB[jj], startXA, startYA));
+            int sideEndA = SignOf(Area(startXB[jj], startYB[jj], endXB[jj], endYB[jj], endXA, endYA));
+            bool straddles = (sideStartB * sideEndB <= 0) & (sideStartA * sideEndA <= 0);
+            // Rounded signs can't rule anything out when asked to be exact
+            maybe[jj] = (unsigned char)(boundsTouch & (straddles | exact));
+         }
+
+         for (int jj = 0; jj < count; ++jj) {
+            if (!maybe[jj]) {
+               continue;
+            }
+            SegmentHit hit(ii, first + jj);
+            if (IntersectSegments(startXA, startYA, endXA, endYA,
+               startXB[jj], startYB[jj], endXB[jj], endYB[jj], hit, exact)) {
+               hits.push_back(hit);
+            }
+         }
+      }
+   }
+   return (int)hits.size();
+}
+
+//------------------------------------------------------
+// Sweep order: by start along the sweep axis
+//------------------------------------------------------
+struct SweepStart
+{
+   const vector<float>* low;
+   bool operator()(int a, int b) const { return (*low)[a] < (*low)[b] || ((*low)[a] == (*low)[b] && a < b); }
+};
+
+bool EarlierHit(const SegmentHit& a, const SegmentHit& b)
+{
+   return a.segmentA < b.segmentA || (a.segmentA == b.segmentA && a.segmentB < b.segmentB);
+}
+
+//------------------------------------------------------
+// Every pair in one set, by sweeping
+//------------------------------------------------------
+int IntersectSegments(const SegmentSet& segments, vector<SegmentHit>& hits, bool exact)
+{
+   hits.clear();
+   int count = segments.Count();
+   if (count < 2) {
+      return 0;
+   }
+
+   // Sweep along the axis the segments are shortest on,
+   // compared to how far they spread out along it
+   float spanX = 0.0f, spanY = 0.0f;
+   float minX = segments.startX[0], maxX = minX, minY = segments.startY[0], maxY = minY;
+   for (int ii = 0; ii < count; ++ii) {
+      spanX += fabsf(segments.endX[ii] - segments.startX[ii]);
+      spanY += fabsf(segments.endY[ii] - segments.startY[ii]);
+      minX = std::min(minX, std::min(segments.startX[ii], segments.endX[ii]));
+      maxX = std::max(maxX, std::max(segments.startX[ii], segments.endX[ii]));
+      minY = std::min(minY, std::min(segments.startY[ii], segments.endY[ii]));
+      maxY = std::max(maxY, std::max(segments.startY[ii], segments.endY[ii]));
+   }
+   bool sweepX = (spanX * (maxY - minY) <= spanY * (maxX - minX));
+   const vector<float>& sweepStart = (sweepX ? segments.startX : segments.startY);
+   const vector<float>& sweepEnd = (sweepX ? segments.endX : segments.endY);
+   const vector<float>& crossStart = (sweepX ? segments.startY : segments.startX);
+   const vector<float>& crossEnd = (sweepX ? segments.endY : segments.endX);
+
+   vector<float> low(count), high(count), crossLow(count), crossHigh(count);
+   for (int ii = 0; ii < count; ++ii) {
+      low[ii] = std::min(sweepStart[ii], sweepEnd[ii]);
+      high[ii] = std::max(sweepStart[ii], sweepEnd[ii]);
+      crossLow[ii] = std::min(crossStart[ii], crossEnd[ii]);
+      crossHigh[ii] = std::max(crossStart[ii], crossEnd[ii]);
+   }
+
+   vector<int> order(count);
+   for (int ii = 0; ii < count; ++ii) {
+      order[ii] = ii;
+   }
+   SweepStart byStart;
+   byStart.low = &low;
+   std::sort(order.begin(), order.end(), byStart);
+
+   vector<int> open;
+   for (int oo = 0; oo < count; ++oo) {
+      int current = order[oo];
+
+      for (unsigned int kk = 0; kk < open.size();) {
+         int other = open[kk];
+         if (high[other] < low[current]) {
+            // Finished before this one started
+            open[kk] = open.back();
+            open.pop_back();
+            continue;
+         }
+         ++kk;
+
+         if (crossHigh[other] < crossLow[current] || crossHigh[current] < crossLow[other]) {
+            continue;
+         }
+         int first = std::min(current, other);
+         int second = std::max(current, other);
+         SegmentHit hit(first, second);
+         if (IntersectSegments(segments.startX[first], segments.startY[first], segments.endX[first], segments.endY[first],
+            segments.startX[second], segments.startY[second], segments.endX[second], segments.endY[second], hit, exact)) {
+            hits.push_back(hit);
+         }
+      }
+      open.push_back(current);
+   }
+
+   std::sort(hits.begin(), hits.end(), EarlierHit);
+   return (int)hits.size();
+}
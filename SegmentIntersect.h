@@ -0,0 +1,87 @@
+#ifndef SEGMENTINTERSECT_H_
+#define SEGMENTINTERSECT_H_
+
+#include "Collisions.h"
+
+   /*
+     Which side of the line a -> b the point c is on: 1 for
+     the left (counterclockwise), -1 for the right, 0 for on
+     it. The plain test can get the sign wrong when c is
+     within rounding error of the line. The exact one never
+     does: it uses doubles when they're clearly good enough,
+     and falls back to adding up the terms with no rounding
+     at all when they aren't.
+   */
+   int Orientation(float ax, float ay, float bx, float by, float cx, float cy);
+   int ExactOrientation(float ax, float ay, float bx, float by, float cx, float cy);
+
+   //------------------------------------------------------
+   // Where two segments meet
+   //------------------------------------------------------
+   struct SegmentHit
+   {
+      // Which segments (for a pair within one set, segmentA < segmentB)
+      int segmentA;
+      int segmentB;
+      // Where they cross. Segments lying along each other give
+      // the middle of the part they share.
+      float x;
+      float y;
+      bool collinear;
+
+      SegmentHit(int segmentA = -1, int segmentB = -1) : segmentA(segmentA), segmentB(segmentB), x(0.0f), y(0.0f), collinear(false) {}
+   };
+
+   //------------------------------------------------------
+   // Lots of segments, stored as arrays of each field so
+   // the batch tests run straight down them
+   //------------------------------------------------------
+   struct SegmentSet
+   {
+      vector<float> startX;
+      vector<float> startY;
+      vector<float> endX;
+      vector<float> endY;
+
+      int Count() const { return (int)startX.size(); }
+      void Add(float startX, float startY, float endX, float endY);
+      void Add(const Line& line) { Add(line.StartX(), line.StartY(), line.EndX(), line.EndY()); }
+      void Clear();
+   };
+
+   /*
+     Tests one pair of segments. Touching counts, and so do
+     segments lying along each other. Fills in the hit's
+     point and collinear flag (not which segments).
+   */
+   bool IntersectSegments(float startXA, float startYA, float endXA, float endYA,
+      float startXB, float startYB, float endXB, float endYB, SegmentHit& hit, bool exact = false);
+
+   /*
+     Every segment in a against every one in b. Runs through
+     b a block at a time, working out the four orientations
+     and the bounds test for the whole block in one straight
+     loop with no branches, then only looks closer at the
+     pairs that passed. Hits are in a order, then b order.
+     Returns how many there were.
+   */
+   int IntersectSegments(const SegmentSet& a, const SegmentSet& b, vector<SegmentHit>& hits, bool exact = false);
+
+   /*
+     Every pair within one set that meets, sorted by
+     segmentA then segmentB.
+
+     This is a sweep, not Bentley-Ottmann: segments are
+     sorted by where they start along whichever axis they
+     overlap least on, and each is tested against the ones
+     still open when it starts (and whose other axis
+     overlaps too). Bentley-Ottmann keeps the open segments
+     ordered and only tests neighbours, but that order
+     comes from rounded crossing points, and when those
+     round the wrong way it misses crossings. This never
+     does, and costs about the same unless lots of long
+     segments run side by side along the sweep.
+   */
+   int IntersectSegments(const SegmentSet& segments, vector<SegmentHit>& hits, bool exact = false);
+
+#endif // SEGMENTINTERSECT_H_
@@ -0,0 +1,492 @@
+#include "ShapeDistance.h"
+#include "Chain.h"
+#include "Compound.h"
+
+// For FLT_MAX
+#include <cfloat>
+// For sqrtf
+#include <cmath>
+
+//------------------------------------------------------
+// Distance from a point to a line segment, and the spot
+// on the segment it's closest to
+//------------------------------------------------------
+float SegmentClosest(Point point, Point start, Point end, Point& onSegment)
+{
+   onSegment = ClosestPointOnLine(start, end, point);
+   return Point(point - onSegment).Length();
+}
+
+//------------------------------------------------------
+// Closest spots between two line segments. If they cross,
+// both spots are the crossing and the distance is 0.
+// Otherwise the closest spot always involves one of the
+// four end points.
+//------------------------------------------------------
+float SegmentClosest(Point startA, Point endA, Point startB, Point endB, Point& onA, Point& onB)
+{
+   Point alongA = endA - startA;
+   Point alongB = endB - startB;
+   Point startBFromA = startB - startA;
+   Point endBFromA = endB - startA;
+   Point startAFromB = startA - startB;
+   Point endAFromB = endA - startB;
+   float sideStartB = alongA.X() * startBFromA.Y() - alongA.Y() * startBFromA.X();
+   float sideEndB = alongA.X() * endBFromA.Y() - alongA.Y() * endBFromA.X();
+   float sideStartA = alongB.X() * startAFromB.Y() - alongB.Y() * startAFromB.X();
+   float sideEndA = alongB.X() * endAFromB.Y() - alongB.Y() * endAFromB.X();
+   if (sideStartB * sideEndB < 0.0f && sideStartA * sideEndA < 0.0f) {
+      onA = startB + alongB * (sideStartB / (sideStartB - sideEndB));
+      onB = onA;
+      return 0.0f;
+   }
+
+   Point onSegment;
+   float distance = SegmentClosest(startA, startB, endB, onSegment);
+   onA = startA;
+   onB = onSegment;
+   float other = SegmentClosest(endA, startB, endB, onSegment);
+   if (other < distance) {
+      distance = other;
+      onA = endA;
+      onB = onSegment;
+   }
+   other = SegmentClosest(startB, startA, endA, onSegment);
+   if (other < distance) {
+      distance = other;
+      onA = onSegment;
+      onB = startB;
+   }
+   other = SegmentClosest(endB, startA, endA, onSegment);
+   if (other < distance) {
+      distance = other;
+      onA = onSegment;
+      onB = endB;
+   }
+   return distance;
+}
+
+//------------------------------------------------------
+// Is the point inside (or on the edge of) the box?
+//------------------------------------------------------
+bool BoxContains(Box* box, Point point)
+{
+   Point fromCenter = point - box->Center();
+   float normalX, normalY;
+   box->Normal(0, normalX, normalY);
+   float alongWidth = fromCenter.Dot(Point(normalX, normalY));
+   box->Normal(1, normalX, normalY);
+   float alongHeight = fromCenter.Dot(Point(normalX, normalY));
+   return (fabsf(alongWidth) <= box->HalfWidth() && fabsf(alongHeight) <= box->HalfHeight());
+}
+
+//------------------------------------------------------
+// Closest spots between a segment and the outline of a box
+//------------------------------------------------------
+float OutlineClosest(Box* box, Point start, Point end, Point& onSegment, Point& onBox)
+{
+   Point corners[4] = { box->TL(), box->TR(), box->BR(), box->BL() };
+   float distance = SegmentClosest(start, end, corners[3], corners[0], onSegment, onBox);
+   for (int ii = 0; ii < 3; ++ii) {
+      Point segmentSpot, boxSpot;
+      float other = SegmentClosest(start, end, corners[ii], corners[ii + 1], segmentSpot, boxSpot);
+      if (other < distance) {
+         distance = other;
+         onSegment = segmentSpot;
+         onBox = boxSpot;
+      }
+   }
+   return distance;
+}
+
+//------------------------------------------------------
+// Pulls a spot found for a circle's center out to its
+// edge, toward the other shape. Returns the new distance.
+//------------------------------------------------------
+float ToCircleEdge(Circle* circle, float centerDistance, const Point& onOther, Point& onCircle)
+{
+   float distance = centerDistance - circle->Radius();
+   if (distance <= 0.0f) {
+      onCircle = onOther;
+      return 0.0f;
+   }
+   onCircle = circle->Center() + (onOther - circle->Center()) * (circle->Radius() / centerDistance);
+   return distance;
+}
+
+//------------------------------------------------------
+// Closest spots for each pair of types
+//------------------------------------------------------
+float ClosestPointvLine(Point* point, Line* line, Point& onPoint, Point& onLine)
+{
+   onPoint = *point;
+   return SegmentClosest(*point, line->Start(), line->End(), onLine);
+}
+
+float ClosestPointvCircle(Point* point, Circle* circle, Point& onPoint, Point& onCircle)
+{
+   onPoint = *point;
+   return ToCircleEdge(circle, Point(*point - circle->Center()).Length(), *point, onCircle);
+}
+
+float ClosestPointvBox(Point* point, Box* box, Point& onPoint, Point& onBox)
+{
+   onPoint = *point;
+   if (BoxContains(box, *point)) {
+      onBox = *point;
+      return 0.0f;
+   }
+   Point unused;
+   return OutlineClosest(box, *point, *point, unused, onBox);
+}
+
+float ClosestLinevCircle(Line* line, Circle* circle, Point& onLine, Point& onCircle)
+{
+   float centerDistance = SegmentClosest(circle->Center(), line->Start(), line->End(), onLine);
+   return ToCircleEdge(circle, centerDistance, onLine, onCircle);
+}
+
+float ClosestLinevBox(Line* line, Box* box, Point& onLine, Point& onBox)
+{
+   // A line all the way inside never gets near the outline
+   if (BoxContains(box, line->Start())) {
+      onLine = line->Start();
+      onBox = onLine;
+      return 0.0f;
+   }
+   return OutlineClosest(box, line->Start(), line->End(), onLine, onBox);
+}
+
+float ClosestCirclevCircle(Circle* circleA, Circle* circleB, Point& onA, Point& onB)
+{
+   Point centerA = circleA->Center();
+   Point centerB = circleB->Center();
+   float centerDistance = Point(centerB - centerA).Length();
+   float distance = centerDistance - circleA->Radius() - circleB->Radius();
+   if (centerDistance == 0.0f) {
+      onA = onB = centerA;
+      return 0.0f;
+   }
+   Point toB = (centerB - centerA) / centerDistance;
+   if (distance <= 0.0f) {
+      // The spot on the way to B that's just inside B
+      float intoB = centerDistance - circleB->Radius();
+      onA = onB = centerA + toB * (intoB > 0.0f ? intoB : 0.0f);
+      return 0.0f;
+   }
+   onA = centerA + toB * circleA->Radius();
+   onB = centerB - toB * circleB->Radius();
+   return distance;
+}
+
+float ClosestCirclevBox(Circle* circle, Box* box, Point& onCircle, Point& onBox)
+{
+   Point center = circle->Center();
+   Point unused;
+   float centerDistance = ClosestPointvBox(&center, box, unused, onBox);
+   return ToCircleEdge(circle, centerDistance, onBox, onCircle);
+}
+
+//------------------------------------------------------
+// Two boxes overlap if their outlines cross, or one
+// holds the other (and then it holds a corner).
+//------------------------------------------------------
+float ClosestBoxvBox(Box* boxA, Box* boxB, Point& onA, Point& onB)
+{
+   if (BoxContains(boxB, boxA->TL())) {
+      onA = onB = boxA->TL();
+      return 0.0f;
+   }
+   if (BoxContains(boxA, boxB->TL())) {
+      onA = onB = boxB->TL();
+      return 0.0f;
+   }
+
+   Point corners[4] = { boxA->TL(), boxA->TR(), boxA->BR(), boxA->BL() };
+   float distance = OutlineClosest(boxB, corners[3], corners[0], onA, onB);
+   for (int ii = 0; ii < 3; ++ii) {
+      Point spotA, spotB;
+      float other = OutlineClosest(boxB, corners[ii], corners[ii + 1], spotA, spotB);
+      if (other < distance) {
+         distance = other;
+         onA = spotA;
+         onB = spotB;
+      }
+   }
+   return distance;
+}
+
+//------------------------------------------------------
+// Walks the chain's tree, nearest node first, skipping
+// any node further off than the best edge so far. An
+// empty chain is infinitely far away.
+//------------------------------------------------------
+float ClosestShapevChain(Shape* shape, Chain* chain, Point& onShape, Point& onChain)
+{
+   float best = FLT_MAX;
+   if (chain->NodeCount() == 0) {
+      return best;
+   }
+
+   AABB bounds = ShapeBounds(shape);
+   int stack[64];
+   int stackSize = 0;
+   stack[stackSize++] = 0;
+
+   while (stackSize > 0) {
+      int nodeIndex = stack[--stackSize];
+      const ChainNode& node = chain->Node(nodeIndex);
+      if (BoundsDistance(node.bounds, bounds) >= best) {
+         continue;
+      }
+
+      if (node.right < 0) {
+         for (int ii = node.firstEdge; ii < node.firstEdge + node.edgeCount; ++ii) {
+            Line edge = chain->Edge(ii);
+            Point spotShape, spotChain;
+            float distance = ClosestPoints(shape, &edge, spotShape, spotChain);
+            if (distance < best) {
+               best = distance;
+               onShape = spotShape;
+               onChain = spotChain;
+            }
+         }
+         if (best <= 0.0f) {
+            break;
+         }
+         continue;
+      }
+
+      // The nearer child goes on top
+      int left = nodeIndex + 1;
+      bool leftNearer = BoundsDistance(chain->Node(left).bounds, bounds) <= BoundsDistance(chain->Node(node.right).bounds, bounds);
+      stack[stackSize++] = (leftNearer ? node.right : left);
+      stack[stackSize++] = (leftNearer ? left : node.right);
+   }
+   return best;
+}
+
+//------------------------------------------------------
+// Each edge of one chain against the other's tree
+//------------------------------------------------------
+float ClosestChainvChain(Chain* chainA, Chain* chainB, Point& onA, Point& onB)
+{
+   float best = FLT_MAX;
+   AABB boundsB = chainB->Bounds();
+   for (int ii = 0; ii < chainA->EdgeCount() && best > 0.0f; ++ii) {
+      Line edge = chainA->Edge(ii);
+      if (BoundsDistance(edge.Bounds(), boundsB) >= best) {
+         continue;
+      }
+      Point spotA, spotB;
+      float distance = ClosestShapevChain(&edge, chainB, spotA, spotB);
+      if (distance < best) {
+         best = distance;
+         onA = spotA;
+         onB = spotB;
+      }
+   }
+   return best;
+}
+
+//------------------------------------------------------
+// The closest of a compound's children, skipping any
+// whose bounds are further off than the best so far. An
+// empty compound is infinitely far away.
+//------------------------------------------------------
+float ClosestShapevCompound(Shape* shape, Compound* compound, Point& onShape, Point& onCompound)
+{
+   float best = FLT_MAX;
+   AABB bounds = ShapeBounds(shape);
+   for (int ii = 0; ii < compound->ChildCount() && best > 0.0f; ++ii) {
+      Shape* child = compound->GetChild(ii);
+      if (BoundsDistance(ShapeBounds(child), bounds) >= best) {
+         continue;
+      }
+      Point spotShape, spotChild;
+      float distance = ClosestPoints(shape, child, spotShape, spotChild);
+      if (distance < best) {
+         best = distance;
+         onShape = spotShape;
+         onCompound = spotChild;
+      }
+   }
+   return best;
+}
+
+//------------------------------------------------------
+// Closest spots between any two shapes
+//------------------------------------------------------
+float ClosestPoints(Shape* objA, Shape* objB, Point& onA, Point& onB)
+{
+   // Order them so only half the pairs need handling
+   if (objB->Type() < objA->Type()) {
+      return ClosestPoints(objB, objA, onB, onA);
+   }
+
+   // Anything against a compound is the closest of its children
+   if (objB->Type() == COMPOUND) {
+      return ClosestShapevCompound(objA, static_cast<Compound*>(objB), onA, onB);
+   }
+
+   // Anything against a chain is the closest of its edges
+   if (objB->Type() == CHAIN) {
+      if (objA->Type() == CHAIN) {
+         return ClosestChainvChain(static_cast<Chain*>(objA), static_cast<Chain*>(objB), onA, onB);
+      }
+      return ClosestShapevChain(objA, static_cast<Chain*>(objB), onA, onB);
+   }
+
+   switch (objA->Type()) {
+   case SHAPE_POINT:
+      switch (objB->Type()) {
+      case SHAPE_POINT:
+         onA = *static_cast<Point*>(objA);
+         onB = *static_cast<Point*>(objB);
+         return Point(onA - onB).Length();
+      case LINE: return ClosestPointvLine(static_cast<Point*>(objA), static_cast<Line*>(objB), onA, onB);
+      case CIRCLE: return ClosestPointvCircle(static_cast<Point*>(objA), static_cast<Circle*>(objB), onA, onB);
+      case BOX: return ClosestPointvBox(static_cast<Point*>(objA), static_cast<Box*>(objB), onA, onB);
+      default: break;
+      }
+      break;
+   case LINE:
+      switch (objB->Type()) {
+      case LINE:
+         return SegmentClosest(static_cast<Line*>(objA)->Start(), static_cast<Line*>(objA)->End(),
+            static_cast<Line*>(objB)->Start(), static_cast<Line*>(objB)->End(), onA, onB);
+      case CIRCLE: return ClosestLinevCircle(static_cast<Line*>(objA), static_cast<Circle*>(objB), onA, onB);
+      case BOX: return ClosestLinevBox(static_cast<Line*>(objA), static_cast<Box*>(objB), onA, onB);
+      default: break;
+      }
+      break;
+   case CIRCLE:
+      switch (objB->Type()) {
+      case CIRCLE: return ClosestCirclevCircle(static_cast<Circle*>(objA), static_cast<Circle*>(objB), onA, onB);
+      case BOX: return ClosestCirclevBox(static_cast<Circle*>(objA), static_cast<Box*>(objB), onA, onB);
+      default: break;
+      }
+      break;
+   case BOX:
+      if (objB->Type() == BOX) {
+         return ClosestBoxvBox(static_cast<Box*>(objA), static_cast<Box*>(objB), onA, onB);
+      }
+      break;
+   default:
+      break;
+   }
+   return 0.0f;
+}
+
+//------------------------------------------------------
+// Distance between any two shapes
+//------------------------------------------------------
+float ShapeDistance(Shape* objA, Shape* objB)
+{
+   Point onA, onB;
+   return ClosestPoints(objA, objB, onA, onB);
+}
+
+//------------------------------------------------------
+// Distance from a spot to any shape
+//------------------------------------------------------
+float ShapeDistance(Shape* shape, float x, float y)
+{
+   Point point(x, y);
+   return ShapeDistance(&point, shape);
+}
+
+//------------------------------------------------------
+// Distance from a spot to an axis aligned box
+//------------------------------------------------------
+float BoundsDistance(const AABB& bounds, float x, float y)
+{
+   float dx = (x < bounds.minX ? bounds.minX - x : (x > bounds.maxX ? x - bounds.maxX : 0.0f));
+   float dy = (y < bounds.minY ? bounds.minY - y : (y > bounds.maxY ? y - bounds.maxY : 0.0f));
+   return sqrtf(dx * dx + dy * dy);
+}
+
+//------------------------------------------------------
+// Gap between two axis aligned boxes
+//------------------------------------------------------
+float BoundsDistance(const AABB& boundsA, const AABB& boundsB)
+{
+   float dx = 0.0f;
+   if (boundsB.minX > boundsA.maxX) dx = boundsB.minX - boundsA.maxX;
+   else if (boundsA.minX > boundsB.maxX) dx = boundsA.minX - boundsB.maxX;
+   float dy = 0.0f;
+   if (boundsB.minY > boundsA.maxY) dy = boundsB.minY - boundsA.maxY;
+   else if (boundsA.minY > boundsB.maxY) dy = boundsA.minY - boundsB.maxY;
+   return sqrtf(dx * dx + dy * dy);
+}
+
+//------------------------------------------------------
+// Point distances
+//------------------------------------------------------
+float DistancePointvPoint(Point* pointA, Point* pointB)
+{
+   return Point(*pointA - *pointB).Length();
+}
+
+float DistancePointvLine(Point* point, Line* line)
+{
+   Point onPoint, onLine;
+   return ClosestPointvLine(point, line, onPoint, onLine);
+}
+
+float DistancePointvCircle(Point* point, Circle* circle)
+{
+   float distance = Point(*point - circle->Center()).Length() - circle->Radius();
+   return (distance > 0.0f ? distance : 0.0f);
+}
+
+float DistancePointvBox(Point* point, Box* box)
+{
+   Point onPoint, onBox;
+   return ClosestPointvBox(point, box, onPoint, onBox);
+}
+
+//------------------------------------------------------
+// Line distances
+//------------------------------------------------------
+float DistanceLinevLine(Line* lineA, Line* lineB)
+{
+   Point onA, onB;
+   return SegmentClosest(lineA->Start(), lineA->End(), lineB->Start(), lineB->End(), onA, onB);
+}
+
+float DistanceLinevCircle(Line* line, Circle* circle)
+{
+   Point onLine, onCircle;
+   return ClosestLinevCircle(line, circle, onLine, onCircle);
+}
+
+float DistanceLinevBox(Line* line, Box* box)
+{
+   Point onLine, onBox;
+   return ClosestLinevBox(line, box, onLine, onBox);
+}
+
+//------------------------------------------------------
+// Circle distances
+//------------------------------------------------------
+float DistanceCirclevCircle(Circle* circleA, Circle* circleB)
+{
+   float distance = Point(circleA->Center() - circleB->Center()).Length() - circleA->Radius() - circleB->Radius();
+   return (distance > 0.0f ? distance : 0.0f);
+}
+
+float DistanceCirclevBox(Circle* circle, Box* box)
+{
+   Point onCircle, onBox;
+   return ClosestCirclevBox(circle, box, onCircle, onBox);
+}
+
+//------------------------------------------------------
+// Box distances
+//------------------------------------------------------
+float DistanceBoxvBox(Box* boxA, Box* boxB)
+{
+   Point onA, onB;
+   return ClosestBoxvBox(boxA, boxB, onA, onB);
+}
@@ -0,0 +1,50 @@
+#ifndef SHAPEDISTANCE_H_
+#define SHAPEDISTANCE_H_
+
+#include "Collisions.h"
+
+   /*
+     Exact distances between shapes: how far apart the
+     closest two points of the shapes are. Shapes that touch
+     or overlap are 0 apart. Nothing is moved.
+   */
+   float ShapeDistance(Shape* objA, Shape* objB);
+
+   // Same, but also hands back the closest spot on each shape.
+   // (When they overlap, both are just some spot in the overlap)
+   float ClosestPoints(Shape* objA, Shape* objB, Point& onA, Point& onB);
+
+   // Distance from a spot to a shape
+   float ShapeDistance(Shape* shape, float x, float y);
+
+   // How far a spot is from an axis aligned box (0 inside it)
+   float BoundsDistance(const AABB& bounds, float x, float y);
+
+   // How far apart two axis aligned boxes are (0 if they touch)
+   float BoundsDistance(const AABB& boundsA, const AABB& boundsB);
+
+   // Point distances
+   float DistancePointvPoint(Point* pointA, Point* pointB);
+
+   float DistancePointvLine(Point* point, Line* line);
+
+   float DistancePointvCircle(Point* point, Circle* circle);
+
+   float DistancePointvBox(Point* point, Box* box);
+
+   // Line distances
+   float DistanceLinevLine(Line* lineA, Line* lineB);
+
+   float DistanceLinevCircle(Line* line, Circle* circle);
+
+   float DistanceLinevBox(Line* line, Box* box);
+
+   // Circle distances
+   float DistanceCirclevCircle(Circle* circleA, Circle* circleB);
+
+   float DistanceCirclevBox(Circle* circle, Box* box);
+
+   // Box distances
+   float DistanceBoxvBox(Box* boxA, Box* boxB);
+
+#endif // SHAPEDISTANCE_H_
@@ -0,0 +1,322 @@
+#include "ShapeIndex.h"
+#include "Chain.h"
+#include "Compound.h"
+#include "ShapeDistance.h"
+
+#include <algorithm>
+// For sqrtf
+#include <cmath>
+
+// A shape cast stops once the gap is this small
+const float castTolerance = 0.01f;
+// Give up on a shape that the cast is only sliding past
+const int maxCastSteps = 64;
+
+//------------------------------------------------------
+// A copy of a shape that can be put anywhere along a
+// move, so the real shape never gets touched
+//------------------------------------------------------
+struct SweptShape
+{
+   Shape* original;
+   float dx;
+   float dy;
+   Point point;
+   Line line;
+   Circle circle;
+   Box box;
+   Chain chain;
+   Compound compound;
+
+   SweptShape(Shape* original, float dx, float dy) : original(original), dx(dx), dy(dy) {}
+
+   // The copy, moved time of the way along
+   Shape* At(float time)
+   {
+      switch (original->Type()) {
+      case SHAPE_POINT:
+         point = *static_cast<Point*>(original);
+         point.Move(dx * time, dy * time);
+         return &point;
+      case LINE:
+         line = *static_cast<Line*>(original);
+         line.Move(dx * time, dy * time);
+         return &line;
+      case CIRCLE:
+         circle = *static_cast<Circle*>(original);
+         circle.Move(dx * time, dy * time);
+         return &circle;
+      case BOX:
+         box = *static_cast<Box*>(original);
+         box.Move(dx * time, dy * time);
+         return &box;
+      case CHAIN:
+         chain = *static_cast<Chain*>(original);
+         chain.Move(dx * time, dy * time);
+         return &chain;
+      case COMPOUND:
+         compound = *static_cast<Compound*>(original);
+         compound.Move(dx * time, dy * time);
+         return &compound;
+      default:
+         return original;
+      }
+   }
+};
+
+//------------------------------------------------------
+// Conservative advancement of the swept shape toward one
+// other shape. Returns the time they touch, or anything
+// past limit if they don't touch before then.
+//
+// For convex shapes the gap shrinks no faster than it is
+// shrinking right now (it's convex along the move), so
+// stepping by gap / closing speed never overshoots, and
+// once the gap stops shrinking they never touch. That's
+// much quicker than stepping by gap / move length when
+// the shape is sliding past at a shallow angle.
+//
+// Chains and compounds aren't convex, so against one the
+// gap can start shrinking faster later on. There only the
+// whole move length is safe to step by.
+//------------------------------------------------------
+float CastAgainst(SweptShape& swept, Shape* other, float limit, CastHit& hit)
+{
+   bool convex = (swept.original->Type() != CHAIN && swept.original->Type() != COMPOUND
+      && other->Type() != CHAIN && other->Type() != COMPOUND);
+   float moveLength = sqrtf(swept.dx * swept.dx + swept.dy * swept.dy);
+   float time = 0.0f;
+   for (int step = 0; step < maxCastSteps; ++step) {
+      Point onMoving, onOther;
+      float gap = ClosestPoints(swept.At(time), other, onMoving, onOther);
+      if (gap <= castTolerance) {
+         Point normal = onMoving - onOther;
+         if (gap <= 0.0f || normal.LengthSquared() == 0.0f) {
+            // Already overlapping, so the best guess is straight back
+            normal = Point(-swept.dx, -swept.dy);
+         }
+         normal.Normalize();
+         hit.time = time;
+         hit.normalX = normal.X();
+         hit.normalY = normal.Y();
+         hit.x = onOther.X();
+         hit.y = onOther.Y();
+         return time;
+      }
+
+      Point toOther = onOther - onMoving;
+      float closing = (convex ? (swept.dx * toOther.X() + swept.dy * toOther.Y()) / gap : moveLength);
+      if (closing <= 0.0f) {
+         break;
+      }
+
+      // Stop a little short, so the shapes never end up touching
+      time += (gap - castTolerance * 0.5f) / closing;
+      if (time > limit) {
+         break;
+      }
+   }
+   return limit + 1.0f;
+}
+
+//------------------------------------------------------
+// Heap orders. The open list wants its closest node on
+// top, the best list its furthest shape.
+//------------------------------------------------------
+bool FurtherNode(const std::pair<float, int>& a, const std::pair<float, int>& b)
+{
+   return a.first > b.first;
+}
+
+bool CloserCandidate(const std::pair<float, int>& a, const std::pair<float, int>& b)
+{
+   return a.first < b.first;
+}
+
+bool CloserHit(const NearestHit& a, const NearestHit& b)
+{
+   return a.distance < b.distance;
+}
+
+//------------------------------------------------------
+// Constructor
+//------------------------------------------------------
+ShapeIndex::ShapeIndex(int threadCount)
+   : tree(threadCount)
+{
+}
+
+//------------------------------------------------------
+// Takes everyone's bounds (on this thread, since that
+// can fill in lazy shape caches) and builds the tree
+//------------------------------------------------------
+void ShapeIndex::Build(Shape* const* shapes, int count)
+{
+   this->shapes.assign(shapes, shapes + count);
+   bounds.resize(count);
+   for (int ii = 0; ii < count; ++ii) {
+      bounds[ii] = ShapeBounds(shapes[ii]);
+   }
+   tree.Build(bounds);
+}
+
+//------------------------------------------------------
+// Branch and bound search. Leaves the answer in
+// search.best, closest first.
+//------------------------------------------------------
+int ShapeIndex::Nearest(Shape* probe, int k, float maxDistance, Search& search) const
+{
+   search.open.clear();
+   search.best.clear();
+   if (k <= 0 || shapes.empty()) {
+      return 0;
+   }
+
+   AABB probeBounds = ShapeBounds(probe);
+   search.open.push_back(std::make_pair(BoundsDistance(tree.NodeBounds(0), probeBounds), 0));
+
+   while (!search.open.empty()) {
+      std::pop_heap(search.open.begin(), search.open.end(), FurtherNode);
+      std::pair<float, int> next = search.open.back();
+      search.open.pop_back();
+
+      // Nothing left can beat what we have
+      float limit = maxDistance;
+      if ((int)search.best.size() == k && search.best.front().distance < limit) {
+         limit = search.best.front().distance;
+      }
+      if (next.first > limit) {
+         break;
+      }
+
+      int node = next.second;
+      if (!tree.IsLeaf(node)) {
+         int children[2] = { tree.LeftChild(node), tree.RightChild(node) };
+         for (int cc = 0; cc < 2; ++cc) {
+            float distance = BoundsDistance(tree.NodeBounds(children[cc]), probeBounds);
+            if (distance <= limit) {
+               search.open.push_back(std::make_pair(distance, children[cc]));
+               std::push_heap(search.open.begin(), search.open.end(), FurtherNode);
+            }
+         }
+         continue;
+      }
+
+      int index = tree.NodeItem(node);
+      Shape* shape = shapes[index];
+      if (shape == probe || !ShouldCollide(probe, shape)) {
+         continue;
+      }
+      float distance = ShapeDistance(probe, shape);
+      if (distance > limit) {
+         continue;
+      }
+
+      if ((int)search.best.size() == k) {
+         // Only a strictly closer shape bumps the worst one
+         if (distance >= search.best.front().distance) {
+            continue;
+         }
+         std::pop_heap(search.best.begin(), search.best.end(), CloserHit);
+         search.best.pop_back();
+      }
+      search.best.push_back(NearestHit(shape, index, distance));
+      std::push_heap(search.best.begin(), search.best.end(), CloserHit);
+   }
+
+   std::sort_heap(search.best.begin(), search.best.end(), CloserHit);
+   return (int)search.best.size();
+}
+
+//------------------------------------------------------
+// The k nearest shapes to the probe
+//------------------------------------------------------
+int ShapeIndex::Nearest(Shape* probe, int k, float maxDistance, vector<NearestHit>& hits) const
+{
+   Search search;
+   int found = Nearest(probe, k, maxDistance, search);
+   hits.swap(search.best);
+   return found;
+}
+
+//------------------------------------------------------
+// The nearest shape within a radius
+//------------------------------------------------------
+Shape* ShapeIndex::NearestWithin(Shape* probe, float radius, float* distance) const
+{
+   Search search;
+   if (Nearest(probe, 1, radius, search) == 0) {
+      return 0;
+   }
+   if (distance != 0) {
+      *distance = search.best[0].distance;
+   }
+   return search.best[0].shape;
+}
+
+//------------------------------------------------------
+// Nearest for a batch of spots, sharing the scratch
+//------------------------------------------------------
+void ShapeIndex::Nearest(const Point* points, int count, int k, float maxDistance,
+   vector<NearestHit>& hits, vector<int>& firstHit) const
+{
+   hits.clear();
+   firstHit.resize(count + 1);
+
+   Search search;
+   for (int ii = 0; ii < count; ++ii) {
+      firstHit[ii] = (int)hits.size();
+      Point probe = points[ii];
+      Nearest(&probe, k, maxDistance, search);
+      hits.insert(hits.end(), search.best.begin(), search.best.end());
+   }
+   firstHit[count] = (int)hits.size();
+}
+
+//------------------------------------------------------
+// Sweeps a shape along a move and finds the first hit
+//------------------------------------------------------
+bool ShapeIndex::ShapeCast(Shape* shape, float dx, float dy, CastHit& hit) const
+{
+   hit = CastHit();
+   if (shapes.empty()) {
+      return false;
+   }
+
+   // Everything the move could reach, in one walk
+   AABB start = ShapeBounds(shape);
+   AABB swept = start;
+   if (dx < 0.0f) swept.minX += dx; else swept.maxX += dx;
+   if (dy < 0.0f) swept.minY += dy; else swept.maxY += dy;
+   vector<int> reached;
+   tree.Query(swept, reached);
+
+   vector<std::pair<float, int> > candidates;
+   for (unsigned int ii = 0; ii < reached.size(); ++ii) {
+      Shape* other = shapes[reached[ii]];
+      if (other == shape || !ShouldCollide(shape, other)) {
+         continue;
+      }
+      candidates.push_back(std::make_pair(BoundsDistance(start, bounds[reached[ii]]), reached[ii]));
+   }
+   std::sort(candidates.begin(), candidates.end(), CloserCandidate);
+
+   float length = sqrtf(dx * dx + dy * dy);
+   SweptShape sweptShape(shape, dx, dy);
+   for (unsigned int ii = 0; ii < candidates.size(); ++ii) {
+      // Can't get there before the hit we already have
+      if (length > 0.0f && candidates[ii].first > hit.time * length) {
+         break;
+      }
+
+      CastHit candidateHit;
+      Shape* other = shapes[candidates[ii].second];
+      if (CastAgainst(sweptShape, other, hit.time, candidateHit) <= hit.time
+         && (hit.shape == 0 || candidateHit.time < hit.time)) {
+         hit = candidateHit;
+         hit.shape = other;
+         hit.index = candidates[ii].second;
+      }
+   }
+   return hit.shape != 0;
+}
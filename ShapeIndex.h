@@ -0,0 +1,120 @@
+#ifndef SHAPEINDEX_H_
+#define SHAPEINDEX_H_
+
+#include "ParallelBroadphase.h"
+
+#include <utility>
+
+   //------------------------------------------------------
+   // One shape found by a nearest query
+   //------------------------------------------------------
+   struct NearestHit
+   {
+      Shape* shape;
+      // Where the shape is in the list the index was built from
+      int index;
+      float distance;
+
+      NearestHit(Shape* shape = 0, int index = -1, float distance = 0.0f) : shape(shape), index(index), distance(distance) {}
+   };
+
+   //------------------------------------------------------
+   // What a shape cast ran into
+   //------------------------------------------------------
+   struct CastHit
+   {
+      Shape* shape;
+      int index;
+      // How far along the move it got, 0 to 1. Moving the
+      // shape that far leaves it just short of touching.
+      float time;
+      // Points out of the hit shape, toward the cast shape
+      float normalX;
+      float normalY;
+      // Where on the hit shape it touched
+      float x;
+      float y;
+
+      CastHit() : shape(0), index(-1), time(1.0f), normalX(0.0f), normalY(0.0f), x(0.0f), y(0.0f) {}
+   };
+
+   //------------------------------------------------------
+   // A tree over a set of shapes, for asking questions like
+   // "the 8 closest enemies" or "the nearest wall within
+   // 300 units" without measuring against everything.
+   //
+   // Nearest queries are branch and bound: tree nodes are
+   // visited closest bounds first, and once k shapes have
+   // been found, any node further away than the k-th one
+   // is skipped along with everything under it. Distances
+   // are exact (see ShapeDistance.h).
+   //
+   // Shape casts sweep a shape along a move and find the
+   // first thing it would touch. Everything the swept bounds
+   // touch is gathered in one walk of the tree, then each
+   // gets conservative advancement: the shape steps forward
+   // as far as it safely can given the gap and how fast it's
+   // closing, until the gap closes, stops closing, or the
+   // move runs out. Closest candidates go first, and once
+   // something is hit, nothing further away gets looked at.
+   //
+   // The probe itself, and shapes its collision filter
+   // rejects, are never returned.
+   //
+   // The index doesn't own the shapes, and doesn't notice
+   // them moving: Build() again when they do. Queries only
+   // read, so any number of threads can run them at once.
+   //------------------------------------------------------
+   class ShapeIndex
+   {
+   private:
+      vector<Shape*> shapes;
+      vector<AABB> bounds;
+      ParallelBroadphase tree;
+
+      // Scratch for one query: the nodes still to visit (a heap,
+      // closest first) and the best shapes so far (a heap, worst first)
+      struct Search
+      {
+         vector<std::pair<float, int> > open;
+         vector<NearestHit> best;
+      };
+
+      int Nearest(Shape* probe, int k, float maxDistance, Search& search) const;
+
+   public:
+      // Threads used by Build(). 0 means one per core.
+      ShapeIndex(int threadCount = 1);
+
+      // Accessors
+      int Count() const { return (int)shapes.size(); }
+      Shape* GetShape(int index) const { return shapes[index]; }
+      const AABB& Bounds(int index) const { return bounds[index]; }
+      const ParallelBroadphase& Tree() const { return tree; }
+
+      // Rebuilds the tree around a new set of shapes
+      void Build(Shape* const* shapes, int count);
+      void Build(const vector<Shape*>& shapes) { Build(shapes.empty() ? 0 : &shapes[0], (int)shapes.size()); }
+
+      // Up to k shapes no further than maxDistance from the
+      // probe, closest first. Returns how many were found.
+      int Nearest(Shape* probe, int k, float maxDistance, vector<NearestHit>& hits) const;
+
+      // The closest shape within radius of the probe (0 if none)
+      Shape* NearestWithin(Shape* probe, float radius, float* distance = 0) const;
+
+      /*
+        Nearest() for lots of spots at once. Spot ii's hits are
+        hits[firstHit[ii]] up to hits[firstHit[ii + 1]], so
+        firstHit ends up one longer than the spots.
+      */
+      void Nearest(const Point* points, int count, int k, float maxDistance,
+         vector<NearestHit>& hits, vector<int>& firstHit) const;
+
+      // Sweeps the shape along (dx, dy) without moving it.
+      // Returns false if it gets all the way. A shape that
+      // starts out touching something hits it at time 0.
+      bool ShapeCast(Shape* shape, float dx, float dy, CastHit& hit) const;
+   };
+
+#endif // SHAPEINDEX_H_
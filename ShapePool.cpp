@@ -0,0 +1,64 @@
+#include "ShapePool.h"
+
+//------------------------------------------------------
+// Destroys the shape a handle points at
+//------------------------------------------------------
+void ShapeStore::Destroy(ShapeHandle handle)
+{
+   // Stale handles must not destroy whatever reused the slot
+   if (Get(handle) == 0) {
+      return;
+   }
+
+   switch (handle.type) {
+      case SHAPE_POINT: points.Destroy(handle.index); break;
+      case LINE: lines.Destroy(handle.index); break;
+      case CIRCLE: circles.Destroy(handle.index); break;
+      case BOX: boxes.Destroy(handle.index); break;
+      default: break;
+   };
+}
+
+//------------------------------------------------------
+// Gets the shape a handle points at (0 if it's stale)
+//------------------------------------------------------
+Shape* ShapeStore::Get(ShapeHandle handle) const
+{
+   switch (handle.type) {
+      case SHAPE_POINT: return points.Get(handle.index, handle.generation);
+      case LINE: return lines.Get(handle.index, handle.generation);
+      case CIRCLE: return circles.Get(handle.index, handle.generation);
+      case BOX: return boxes.Get(handle.index, handle.generation);
+      default: return 0;
+   };
+}
+
+//------------------------------------------------------
+// Destroys every shape, but keeps the memory around
+//------------------------------------------------------
+void ShapeStore::Reset()
+{
+   points.Reset();
+   lines.Reset();
+   circles.Reset();
+   boxes.Reset();
+}
+
+//------------------------------------------------------
+// Destroys every shape and frees the memory
+//------------------------------------------------------
+void ShapeStore::Release()
+{
+   points.Release();
+   lines.Release();
+   circles.Release();
+   boxes.Release();
+}
+
+//------------------------------------------------------
+// Handles the collision between 2 pooled shapes
+//------------------------------------------------------
+bool HandleCollision(const ShapeStore& store, ShapeHandle objA, ShapeHandle objB, float pushPercent)
+{
+   return HandleCollision(store.Get(objA), store.Get(objB), pushPercent);
+}
@@ -0,0 +1,209 @@
+#ifndef SHAPEPOOL_H_
+#define SHAPEPOOL_H_
+
+#include "Collisions.h"
+
+// For placement new
+#include <new>
+// For std::forward
+#include <utility>
+
+   //------------------------------------------------------
+   // A handle to a shape living in a ShapeStore.
+   //
+   // The generation changes every time a slot is reused,
+   // so a handle to a destroyed shape stops working instead
+   // of quietly pointing at whatever took its place.
+   //------------------------------------------------------
+   struct ShapeHandle
+   {
+      ShapeType type;
+      int index;
+      unsigned int generation;
+
+      ShapeHandle(ShapeType type = NUM_SHAPES, int index = -1, unsigned int generation = 0)
+         : type(type), index(index), generation(generation) {}
+
+      bool IsNull() const { return index < 0; }
+      bool operator==(const ShapeHandle& rhs) const { return type == rhs.type && index == rhs.index && generation == rhs.generation; }
+      bool operator!=(const ShapeHandle& rhs) const { return !(*this == rhs); }
+   };
+
+   //------------------------------------------------------
+   // A pool of one kind of shape.
+   //
+   // Shapes live in slabs of SlabSize shapes each. Slabs are
+   // never moved or freed until Release(), so pointers stay
+   // good, and walking the pool goes straight through memory.
+   // Destroyed slots go on a free list to be reused.
+   //------------------------------------------------------
+   template <class T, int SlabSize = 256>
+   class ShapePool
+   {
+   private:
+      vector<unsigned char*> slabs;
+      vector<unsigned int> generations;
+      vector<bool> alive;
+      vector<int> freeSlots;
+      int liveCount;
+
+      T* Slot(int index) const { return reinterpret_cast<T*>(slabs[index / SlabSize]) + (index % SlabSize); }
+
+      // Adds another slab, and puts its slots on the free list
+      void Grow() {
+         int first = (int)slabs.size() * SlabSize;
+         slabs.push_back(new unsigned char[sizeof(T) * SlabSize]);
+         generations.resize(first + SlabSize, 0);
+         alive.resize(first + SlabSize, false);
+         // Backwards, so the lowest slot gets used first
+         for (int ii = first + SlabSize - 1; ii >= first; --ii) {
+            freeSlots.push_back(ii);
+         }
+      }
+
+      ShapePool(const ShapePool&) = delete;
+      ShapePool& operator=(const ShapePool&) = delete;
+
+   public:
+      ShapePool() : liveCount(0) {}
+      ~ShapePool() { Release(); }
+
+      // Makes a new shape, passing the arguments to its constructor.
+      // Returns the slot it went in.
+      template <class... Args>
+      int Create(Args&&... args) {
+         if (freeSlots.size() == 0) {
+            Grow();
+         }
+         int index = freeSlots.back();
+         freeSlots.pop_back();
+         new (Slot(index)) T(std::forward<Args>(args)...);
+         alive[index] = true;
+         ++liveCount;
+         return index;
+      }
+
+      // Destroys the shape in a slot
+      void Destroy(int index) {
+         if (index < 0 || index >= (int)alive.size() || !alive[index]) {
+            return;
+         }
+         Slot(index)->~T();
+         alive[index] = false;
+         ++generations[index];
+         freeSlots.push_back(index);
+         --liveCount;
+      }
+
+      // Gets a shape, or 0 if the slot has moved on since the handle was made
+      T* Get(int index, unsigned int generation) const {
+         if (index < 0 || index >= (int)alive.size() || !alive[index] || generations[index] != generation) {
+            return 0;
+         }
+         return Slot(index);
+      }
+
+      // Accessors
+      unsigned int Generation(int index) const { return generations[index]; }
+      bool Alive(int index) const { return index >= 0 && index < (int)alive.size() && alive[index]; }
+      int Count() const { return liveCount; }
+      int Capacity() const { return (int)alive.size(); }
+
+      // Calls function(T&) for every live shape, in memory order
+      template <class Function>
+      void ForEach(Function function) {
+         for (unsigned int ii = 0; ii < alive.size(); ++ii) {
+            if (alive[ii]) {
+               function(*Slot(ii));
+            }
+         }
+      }
+
+      // Destroys every shape but keeps the memory for next time
+      // (for tearing down a level and loading the next one)
+      void Reset() {
+         freeSlots.clear();
+         for (int ii = (int)alive.size() - 1; ii >= 0; --ii) {
+            if (alive[ii]) {
+               Slot(ii)->~T();
+               alive[ii] = false;
+               ++generations[ii];
+            }
+            freeSlots.push_back(ii);
+         }
+         liveCount = 0;
+      }
+
+      // Destroys everything and gives the memory back
+      void Release() {
+         Reset();
+         for (unsigned int ii = 0; ii < slabs.size(); ++ii) {
+            delete[] slabs[ii];
+         }
+         slabs.clear();
+         generations.clear();
+         alive.clear();
+         freeSlots.clear();
+      }
+   };
+
+   //------------------------------------------------------
+   // A pool for each kind of shape, handed out by handle
+   //------------------------------------------------------
+   class ShapeStore
+   {
+   private:
+      ShapePool<Point> points;
+      ShapePool<Line> lines;
+      ShapePool<Circle> circles;
+      ShapePool<Box> boxes;
+
+   public:
+      // Makers. Arguments go to the shape's constructor.
+      template <class... Args>
+      ShapeHandle CreatePoint(Args&&... args) {
+         int index = points.Create(std::forward<Args>(args)...);
+         return ShapeHandle(SHAPE_POINT, index, points.Generation(index));
+      }
+      template <class... Args>
+      ShapeHandle CreateLine(Args&&... args) {
+         int index = lines.Create(std::forward<Args>(args)...);
+         return ShapeHandle(LINE, index, lines.Generation(index));
+      }
+      template <class... Args>
+      ShapeHandle CreateCircle(Args&&... args) {
+         int index = circles.Create(std::forward<Args>(args)...);
+         return ShapeHandle(CIRCLE, index, circles.Generation(index));
+      }
+      template <class... Args>
+      ShapeHandle CreateBox(Args&&... args) {
+         int index = boxes.Create(std::forward<Args>(args)...);
+         return ShapeHandle(BOX, index, boxes.Generation(index));
+      }
+
+      void Destroy(ShapeHandle handle);
+
+      // Gets the shape (0 if the handle is stale)
+      Shape* Get(ShapeHandle handle) const;
+      Point* GetPoint(ShapeHandle handle) const { return (handle.type == SHAPE_POINT ? points.Get(handle.index, handle.generation) : 0); }
+      Line* GetLine(ShapeHandle handle) const { return (handle.type == LINE ? lines.Get(handle.index, handle.generation) : 0); }
+      Circle* GetCircle(ShapeHandle handle) const { return (handle.type == CIRCLE ? circles.Get(handle.index, handle.generation) : 0); }
+      Box* GetBox(ShapeHandle handle) const { return (handle.type == BOX ? boxes.Get(handle.index, handle.generation) : 0); }
+      bool IsValid(ShapeHandle handle) const { return Get(handle) != 0; }
+
+      // The pools themselves, for walking every shape of a kind
+      ShapePool<Point>& Points() { return points; }
+      ShapePool<Line>& Lines() { return lines; }
+      ShapePool<Circle>& Circles() { return circles; }
+      ShapePool<Box>& Boxes() { return boxes; }
+
+      // Destroys everything, keeping the memory (per level teardown)
+      void Reset();
+      // Destroys everything and gives the memory back
+      void Release();
+   };
+
+// Handles collisions between two pooled shapes. Stale handles never collide.
+bool HandleCollision(const ShapeStore& store, ShapeHandle objA, ShapeHandle objB, float pushPercent = -1.0f);
+
+#endif // SHAPEPOOL_H_
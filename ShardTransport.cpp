@@ -0,0 +1,303 @@
+#include "ShardTransport.h"
+
+#ifndef _WIN32
+
+// For steady_clock
+#include <chrono>
+// For memcpy
+#include <cstring>
+// For placement new
+#include <new>
+// For yield
+#include <thread>
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+//------------------------------------------------------
+// Milliseconds since some fixed time
+//------------------------------------------------------
+long long NowMs()
+{
+   return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//------------------------------------------------------
+// Constructor. Makes every socket up front.
+//------------------------------------------------------
+SocketTransport::SocketTransport(int regionCount, int timeoutMs)
+{
+   this->regionCount = regionCount;
+   this->timeoutMs = timeoutMs;
+   sockets.assign(regionCount * regionCount, -1);
+
+   for (int a = 0; a < regionCount; ++a) {
+      for (int b = a + 1; b < regionCount; ++b) {
+         int pair[2];
+         if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            for (unsigned int ii = 0; ii < sockets.size(); ++ii) {
+               if (sockets[ii] >= 0) {
+                  close(sockets[ii]);
+               }
+            }
+            sockets.clear();
+            return;
+         }
+         sockets[a * regionCount + b] = pair[0];
+         sockets[b * regionCount + a] = pair[1];
+      }
+   }
+}
+
+//------------------------------------------------------
+// Destructor
+//------------------------------------------------------
+SocketTransport::~SocketTransport()
+{
+   Close();
+}
+
+//------------------------------------------------------
+// Closes every socket. Exchange() fails from then on.
+//------------------------------------------------------
+void SocketTransport::Close()
+{
+   for (unsigned int ii = 0; ii < sockets.size(); ++ii) {
+      if (sockets[ii] >= 0) {
+         close(sockets[ii]);
+      }
+   }
+   sockets.clear();
+}
+
+//------------------------------------------------------
+// Swaps the messages. A swap that fails can stop halfway
+// through a message, with no way to tell where the next
+// one starts, so the sockets are closed rather than left
+// to be misread.
+//------------------------------------------------------
+bool SocketTransport::Exchange(int region, const vector<int>& neighbours,
+   const vector<vector<unsigned char> >& outgoing, vector<vector<unsigned char> >& incoming)
+{
+   if (!Swap(region, neighbours, outgoing, incoming)) {
+      Close();
+      return false;
+   }
+   return true;
+}
+
+//------------------------------------------------------
+// Writes whatever each socket will take and reads
+// whatever has arrived, until everything's gone out and
+// every neighbour's whole message is in
+//------------------------------------------------------
+bool SocketTransport::Swap(int region, const vector<int>& neighbours,
+   const vector<vector<unsigned char> >& outgoing, vector<vector<unsigned char> >& incoming)
+{
+   int count = (int)neighbours.size();
+   incoming.resize(count);
+   if (sockets.empty()) {
+      return false;
+   }
+
+   // Length prefixed copies of what's going out
+   vector<vector<unsigned char> > framed(count);
+   vector<size_t> written(count, 0);
+   vector<size_t> received(count, 0);
+   vector<unsigned char> lengths(count * 4);
+   for (int ii = 0; ii < count; ++ii) {
+      unsigned int size = (unsigned int)outgoing[ii].size();
+      framed[ii].resize(4 + size);
+      memcpy(&framed[ii][0], &size, 4);
+      if (size > 0) {
+         memcpy(&framed[ii][4], &outgoing[ii][0], size);
+      }
+      incoming[ii].clear();
+   }
+
+   long long deadline = NowMs() + timeoutMs;
+   vector<pollfd> polls(count);
+   while (true) {
+      bool done = true;
+      for (int ii = 0; ii < count; ++ii) {
+         polls[ii].fd = sockets[region * regionCount + neighbours[ii]];
+         polls[ii].events = 0;
+         polls[ii].revents = 0;
+         if (written[ii] < framed[ii].size()) {
+            polls[ii].events |= POLLOUT;
+         }
+         bool haveLength = received[ii] >= 4;
+         if (!haveLength || received[ii] < 4 + incoming[ii].size()) {
+            polls[ii].events |= POLLIN;
+         }
+         if (polls[ii].events != 0) {
+            done = false;
+         }
+      }
+      if (done) {
+         return true;
+      }
+
+      long long waitMs = deadline - NowMs();
+      if (waitMs <= 0) {
+         return false;
+      }
+      int ready = poll(&polls[0], count, (int)waitMs);
+      if (ready < 0 && errno != EINTR) {
+         return false;
+      }
+
+      for (int ii = 0; ii < count; ++ii) {
+         if (polls[ii].revents & (POLLERR | POLLNVAL)) {
+            return false;
+         }
+         if (polls[ii].revents & POLLOUT) {
+            ssize_t sent = send(polls[ii].fd, &framed[ii][written[ii]], framed[ii].size() - written[ii], MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+               return false;
+            }
+            written[ii] += (sent > 0 ? (size_t)sent : 0);
+         }
+         if (polls[ii].revents & (POLLIN | POLLHUP)) {
+            // The length first, then exactly that many bytes, so
+            // nothing from the next step's message gets eaten
+            unsigned char* target;
+            size_t wanted;
+            if (received[ii] < 4) {
+               target = &lengths[ii * 4] + received[ii];
+               wanted = 4 - received[ii];
+            }
+            else {
+               target = &incoming[ii][received[ii] - 4];
+               wanted = 4 + incoming[ii].size() - received[ii];
+            }
+            ssize_t got = recv(polls[ii].fd, target, wanted, MSG_DONTWAIT);
+            if (got == 0) {
+               // Hung up
+               return false;
+            }
+            if (got < 0) {
+               if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                  return false;
+               }
+               continue;
+            }
+            received[ii] += (size_t)got;
+            if (received[ii] == 4) {
+               unsigned int size;
+               memcpy(&size, &lengths[ii * 4], 4);
+               incoming[ii].resize(size);
+            }
+         }
+      }
+   }
+}
+
+//------------------------------------------------------
+// Constructor. Maps one shared block holding every
+// mailbox, each one starting on a cache line.
+//------------------------------------------------------
+SharedMemoryTransport::SharedMemoryTransport(int regionCount, size_t mailboxBytes, int timeoutMs)
+{
+   this->regionCount = regionCount;
+   this->timeoutMs = timeoutMs;
+   this->mailboxBytes = mailboxBytes;
+   this->mailboxStride = (sizeof(Mailbox) + mailboxBytes + 63) & ~(size_t)63;
+   this->memorySize = mailboxStride * regionCount * regionCount;
+   this->memory = 0;
+
+   void* mapped = mmap(0, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (mapped == MAP_FAILED) {
+      return;
+   }
+   memory = (unsigned char*)mapped;
+   for (int from = 0; from < regionCount; ++from) {
+      for (int to = 0; to < regionCount; ++to) {
+         Mailbox* mailbox = new (GetMailbox(from, to)) Mailbox;
+         mailbox->sent.store(0);
+         mailbox->taken.store(0);
+         mailbox->size.store(0);
+      }
+   }
+}
+
+//------------------------------------------------------
+// Destructor
+//------------------------------------------------------
+SharedMemoryTransport::~SharedMemoryTransport()
+{
+   if (memory != 0) {
+      munmap(memory, memorySize);
+   }
+}
+
+//------------------------------------------------------
+// Posts into each neighbour's mailbox as soon as they've
+// taken the last message, then collects from ours. A
+// neighbour takes its mail in its own Exchange(), so
+// nobody ends up waiting on somebody who's waiting on them.
+//------------------------------------------------------
+bool SharedMemoryTransport::Exchange(int region, const vector<int>& neighbours,
+   const vector<vector<unsigned char> >& outgoing, vector<vector<unsigned char> >& incoming)
+{
+   int count = (int)neighbours.size();
+   incoming.resize(count);
+   if (memory == 0) {
+      return false;
+   }
+
+   long long deadline = NowMs() + timeoutMs;
+   vector<bool> posted(count, false);
+   vector<bool> collected(count, false);
+   int remaining = 2 * count;
+   while (remaining > 0) {
+      bool progress = false;
+      for (int ii = 0; ii < count; ++ii) {
+         if (!posted[ii]) {
+            Mailbox* mailbox = GetMailbox(region, neighbours[ii]);
+            unsigned long long sent = mailbox->sent.load(std::memory_order_relaxed);
+            if (mailbox->taken.load(std::memory_order_acquire) == sent) {
+               if (outgoing[ii].size() > mailboxBytes) {
+                  return false;
+               }
+               if (!outgoing[ii].empty()) {
+                  memcpy(MailboxData(region, neighbours[ii]), &outgoing[ii][0], outgoing[ii].size());
+               }
+               mailbox->size.store((unsigned int)outgoing[ii].size(), std::memory_order_relaxed);
+               mailbox->sent.store(sent + 1, std::memory_order_release);
+               posted[ii] = true;
+               progress = true;
+               --remaining;
+            }
+         }
+
+         if (!collected[ii]) {
+            Mailbox* mailbox = GetMailbox(neighbours[ii], region);
+            unsigned long long taken = mailbox->taken.load(std::memory_order_relaxed);
+            if (mailbox->sent.load(std::memory_order_acquire) != taken) {
+               unsigned int size = mailbox->size.load(std::memory_order_relaxed);
+               const unsigned char* data = MailboxData(neighbours[ii], region);
+               incoming[ii].assign(data, data + size);
+               mailbox->taken.store(taken + 1, std::memory_order_release);
+               collected[ii] = true;
+               progress = true;
+               --remaining;
+            }
+         }
+      }
+
+      if (!progress) {
+         if (NowMs() > deadline) {
+            return false;
+         }
+         std::this_thread::yield();
+      }
+   }
+   return true;
+}
+
+#endif // _WIN32
@@ -0,0 +1,121 @@
+#ifndef SHARDTRANSPORT_H_
+#define SHARDTRANSPORT_H_
+
+#include <atomic>
+// For size_t
+#include <cstddef>
+#include <vector>
+
+using std::vector;
+
+   //------------------------------------------------------
+   // How shards of a ShardedWorld talk to each other.
+   //
+   // Once a step, every region swaps one message with each
+   // of its neighbours. Exchange() is called by every region
+   // at the same point in the step, each from its own process
+   // (or thread), passing its own region number.
+   //------------------------------------------------------
+   class ShardTransport
+   {
+   public:
+      virtual ~ShardTransport() {}
+
+      /*
+        Sends outgoing[ii] to neighbours[ii], and waits for
+        incoming[ii] from each of them. Returns false if a
+        neighbour went away or took too long. Whether it's
+        worth calling again after that is up to the transport.
+      */
+      virtual bool Exchange(int region, const vector<int>& neighbours,
+         const vector<vector<unsigned char> >& outgoing, vector<vector<unsigned char> >& incoming) = 0;
+   };
+
+#ifndef _WIN32
+
+   //------------------------------------------------------
+   // A Unix domain socket between every pair of regions.
+   //
+   // Make it before forking the region processes; every
+   // child keeps the whole set and uses its own ends.
+   // Messages are a 4 byte length then the bytes. Sending
+   // and receiving share one poll() loop, so big messages
+   // can't fill both sides' buffers and lock up.
+   //
+   // A failed Exchange() is the end of it: it may have
+   // stopped partway through a message, so the sockets are
+   // closed and every Exchange() after it fails too.
+   //------------------------------------------------------
+   class SocketTransport : public ShardTransport
+   {
+   private:
+      int regionCount;
+      int timeoutMs;
+      // sockets[a * regionCount + b] is a's end of the a-b socket
+      vector<int> sockets;
+
+      bool Swap(int region, const vector<int>& neighbours,
+         const vector<vector<unsigned char> >& outgoing, vector<vector<unsigned char> >& incoming);
+      void Close();
+
+      SocketTransport(const SocketTransport&) = delete;
+      SocketTransport& operator=(const SocketTransport&) = delete;
+
+   public:
+      SocketTransport(int regionCount, int timeoutMs = 5000);
+      ~SocketTransport();
+
+      // False if the sockets couldn't be made, or an exchange failed
+      bool IsOpen() const { return !sockets.empty(); }
+
+      bool Exchange(int region, const vector<int>& neighbours,
+         const vector<vector<unsigned char> >& outgoing, vector<vector<unsigned char> >& incoming);
+   };
+
+   //------------------------------------------------------
+   // A mailbox in shared memory for every pair of regions.
+   //
+   // Make it before forking (the memory is shared with the
+   // children), or share one between threads. Each mailbox
+   // holds one message: the sender waits for the last one
+   // to be taken, and the receiver for a new one to land.
+   // A message bigger than mailboxBytes can't be sent.
+   //------------------------------------------------------
+   class SharedMemoryTransport : public ShardTransport
+   {
+   private:
+      struct Mailbox
+      {
+         // Messages ever put in and taken out
+         std::atomic<unsigned long long> sent;
+         std::atomic<unsigned long long> taken;
+         std::atomic<unsigned int> size;
+      };
+
+      int regionCount;
+      int timeoutMs;
+      size_t mailboxBytes;
+      size_t mailboxStride;
+      unsigned char* memory;
+      size_t memorySize;
+
+      Mailbox* GetMailbox(int from, int to) const { return reinterpret_cast<Mailbox*>(memory + (from * regionCount + to) * mailboxStride); }
+      unsigned char* MailboxData(int from, int to) const { return memory + (from * regionCount + to) * mailboxStride + sizeof(Mailbox); }
+
+      SharedMemoryTransport(const SharedMemoryTransport&) = delete;
+      SharedMemoryTransport& operator=(const SharedMemoryTransport&) = delete;
+
+   public:
+      SharedMemoryTransport(int regionCount, size_t mailboxBytes = 1024 * 1024, int timeoutMs = 5000);
+      ~SharedMemoryTransport();
+
+      // False if the memory couldn't be mapped
+      bool IsOpen() const { return memory != 0; }
+
+      bool Exchange(int region, const vector<int>& neighbours,
+         const vector<vector<unsigned char> >& outgoing, vector<vector<unsigned char> >& incoming);
+   };
+
+#endif // _WIN32
+
+#endif // SHARDTRANSPORT_H_
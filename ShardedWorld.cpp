@@ -0,0 +1,548 @@
+#include "ShardedWorld.h"
+
+// For FLT_MAX
+#include <cfloat>
+// For floorf
+#include <cmath>
+// For memcpy/memcmp
+#include <cstring>
+
+// What a record is for
+enum RECORD_KIND {
+   RECORD_GHOST = 0,
+   RECORD_MIGRANT,
+   RECORD_REMOVED
+};
+
+//------------------------------------------------------
+// One shape on the wire. Boxes send everything they've
+// worked out, so both sides have bit for bit the same box.
+//------------------------------------------------------
+struct ShardedWorld::ShapeRecord
+{
+   unsigned long long id;
+   unsigned char kind;
+   unsigned char type;
+   unsigned char isStatic;
+   unsigned char unused;
+   unsigned short categoryBits;
+   unsigned short maskBits;
+   short groupIndex;
+   short unused2;
+   float fields[shardRecordFields];
+};
+
+//------------------------------------------------------
+// Writes a shape's geometry down as floats
+//------------------------------------------------------
+void WriteFields(Shape* shape, float* fields)
+{
+   memset(fields, 0, sizeof(float) * shardRecordFields);
+   switch (shape->Type()) {
+   case SHAPE_POINT:
+   {
+      Point* point = static_cast<Point*>(shape);
+      fields[0] = point->X();
+      fields[1] = point->Y();
+      break;
+   }
+   case LINE:
+   {
+      Line* line = static_cast<Line*>(shape);
+      fields[0] = line->StartX();
+      fields[1] = line->StartY();
+      fields[2] = line->EndX();
+      fields[3] = line->EndY();
+      break;
+   }
+   case CIRCLE:
+   {
+      Circle* circle = static_cast<Circle*>(shape);
+      fields[0] = circle->CenterX();
+      fields[1] = circle->CenterY();
+      fields[2] = circle->Radius();
+      break;
+   }
+   case BOX:
+   {
+      Box* box = static_cast<Box*>(shape);
+      Point topLeft = box->Diagonal(Box::TOPLEFT);
+      Point topRight = box->Diagonal(Box::TOPRIGHT);
+      fields[0] = box->Center().X();
+      fields[1] = box->Center().Y();
+      fields[2] = box->Width();
+      fields[3] = box->Height();
+      fields[4] = box->Rotation();
+      fields[5] = box->DiagonalLength();
+      fields[6] = topLeft.X();
+      fields[7] = topLeft.Y();
+      fields[8] = topRight.X();
+      fields[9] = topRight.Y();
+      box->Normal(0, fields[10], fields[11]);
+      box->Normal(1, fields[12], fields[13]);
+      break;
+   }
+   default:
+      break;
+   }
+}
+
+//------------------------------------------------------
+// Makes a shape match what was written down. The filter
+// doesn't come along, so put it back after.
+//------------------------------------------------------
+void ReadFields(Shape* shape, const float* fields)
+{
+   CollisionFilter filter = shape->Filter();
+   switch (shape->Type()) {
+   case SHAPE_POINT:
+      *static_cast<Point*>(shape) = Point(fields[0], fields[1]);
+      break;
+   case LINE:
+      *static_cast<Line*>(shape) = Line(fields[0], fields[1], fields[2], fields[3]);
+      break;
+   case CIRCLE:
+      *static_cast<Circle*>(shape) = Circle(fields[0], fields[1], fields[2]);
+      break;
+   case BOX:
+      *static_cast<Box*>(shape) = Box(Point(fields[0], fields[1]), fields[2], fields[3], fields[4], fields[5],
+         Point(fields[6], fields[7]), Point(fields[8], fields[9]), Point(fields[10], fields[11]), Point(fields[12], fields[13]));
+      break;
+   default:
+      break;
+   }
+   shape->Filter(filter);
+}
+
+//------------------------------------------------------
+// Makes an empty shape of a type in the store
+//------------------------------------------------------
+ShapeHandle CreateShape(ShapeStore& store, ShapeType type)
+{
+   switch (type) {
+   case SHAPE_POINT: return store.CreatePoint();
+   case LINE: return store.CreateLine();
+   case CIRCLE: return store.CreateCircle();
+   case BOX: return store.CreateBox();
+   default: return ShapeHandle();
+   }
+}
+
+//------------------------------------------------------
+// Does a touch b?
+//------------------------------------------------------
+bool BoundsTouch(const AABB& a, const AABB& b)
+{
+   return a.minX <= b.maxX && a.maxX >= b.minX && a.minY <= b.maxY && a.maxY >= b.minY;
+}
+
+//------------------------------------------------------
+// The region a spot belongs to
+//------------------------------------------------------
+int ShardLayout::RegionAt(float x, float y) const
+{
+   int column = (int)floorf((x - minX) / regionWidth);
+   int row = (int)floorf((y - minY) / regionHeight);
+   column = (column < 0 ? 0 : (column >= columns ? columns - 1 : column));
+   row = (row < 0 ? 0 : (row >= rows ? rows - 1 : row));
+   return row * columns + column;
+}
+
+//------------------------------------------------------
+// A region's rectangle. Regions on the edge of the grid
+// go on forever on that side.
+//------------------------------------------------------
+AABB ShardLayout::RegionBounds(int region) const
+{
+   int column = region % columns;
+   int row = region / columns;
+   AABB bounds(minX + column * regionWidth, minY + row * regionHeight,
+      minX + (column + 1) * regionWidth, minY + (row + 1) * regionHeight);
+   if (column == 0) bounds.minX = -FLT_MAX;
+   if (column == columns - 1) bounds.maxX = FLT_MAX;
+   if (row == 0) bounds.minY = -FLT_MAX;
+   if (row == rows - 1) bounds.maxY = FLT_MAX;
+   return bounds;
+}
+
+//------------------------------------------------------
+// Constructor. Works out who the neighbours are.
+//------------------------------------------------------
+ShardedWorld::ShardedWorld(const ShardLayout& layout, int region, ShardTransport& transport)
+   : layout(layout)
+{
+   this->region = region;
+   this->transport = &transport;
+   this->nextId = 0;
+
+   int column = region % layout.columns;
+   int row = region / layout.columns;
+   for (int yy = row - 1; yy <= row + 1; ++yy) {
+      for (int xx = column - 1; xx <= column + 1; ++xx) {
+         if (xx < 0 || yy < 0 || xx >= layout.columns || yy >= layout.rows || (xx == column && yy == row)) {
+            continue;
+         }
+         neighbours.push_back(yy * layout.columns + xx);
+      }
+   }
+   outgoing.resize(neighbours.size());
+   incoming.resize(neighbours.size());
+}
+
+//------------------------------------------------------
+// Adds a shape made in our store. Ids have the region
+// in the top bits so no two regions hand out the same one.
+//------------------------------------------------------
+unsigned long long ShardedWorld::AddShape(ShapeHandle handle, bool isStatic)
+{
+   unsigned long long id = ((unsigned long long)(region + 1) << 40) | ++nextId;
+
+   OwnedShape shape;
+   shape.handle = handle;
+   shape.proxyId = world.AddShape(store, handle, isStatic);
+   shape.isStatic = isStatic;
+   shape.ghostedTo = 0;
+   shape.sentVersion = 0;
+   owned[id] = shape;
+   TrackProxy(shape.proxyId, id);
+   return id;
+}
+
+//------------------------------------------------------
+// Removes an owned shape. Moving ones just stop being
+// sent; static ones need telling the neighbours about.
+//------------------------------------------------------
+void ShardedWorld::RemoveShape(unsigned long long id)
+{
+   std::map<unsigned long long, OwnedShape>::iterator found = owned.find(id);
+   if (found == owned.end()) {
+      return;
+   }
+
+   OwnedShape& shape = found->second;
+   if (shape.isStatic && shape.ghostedTo != 0) {
+      removedStatics.push_back(std::make_pair(id, shape.ghostedTo));
+   }
+   world.RemoveShape(shape.proxyId);
+   proxyIds[shape.proxyId] = 0;
+   store.Destroy(shape.handle);
+   owned.erase(found);
+}
+
+//------------------------------------------------------
+// The shape behind an id, if it's ours
+//------------------------------------------------------
+ShapeHandle ShardedWorld::Find(unsigned long long id) const
+{
+   std::map<unsigned long long, OwnedShape>::const_iterator found = owned.find(id);
+   return (found == owned.end() ? ShapeHandle() : found->second.handle);
+}
+
+//------------------------------------------------------
+// Every id we own
+//------------------------------------------------------
+void ShardedWorld::OwnedShapes(vector<unsigned long long>& ids) const
+{
+   ids.clear();
+   for (std::map<unsigned long long, OwnedShape>::const_iterator it = owned.begin(); it != owned.end(); ++it) {
+      ids.push_back(it->first);
+   }
+}
+
+//------------------------------------------------------
+// Is this proxy a copy of somebody else's shape?
+//------------------------------------------------------
+bool ShardedWorld::IsGhost(int proxyId) const
+{
+   if (proxyId < 0 || proxyId >= (int)proxyIds.size() || proxyIds[proxyId] == 0) {
+      return false;
+   }
+   return ghosts.find(proxyIds[proxyId]) != ghosts.end();
+}
+
+//------------------------------------------------------
+// Remembers which id a proxy is
+//------------------------------------------------------
+void ShardedWorld::TrackProxy(int proxyId, unsigned long long id)
+{
+   if (proxyId >= (int)proxyIds.size()) {
+      proxyIds.resize(proxyId + 1, 0);
+   }
+   proxyIds[proxyId] = id;
+}
+
+//------------------------------------------------------
+// Appends one record to a message
+//------------------------------------------------------
+void AppendRecord(vector<unsigned char>& message, const void* record, size_t size)
+{
+   size_t at = message.size();
+   message.resize(at + size);
+   memcpy(&message[at], record, size);
+}
+
+//------------------------------------------------------
+// Handles one record from a neighbour. Anything going
+// away is left for the caller to take out of the world
+// all at once.
+//------------------------------------------------------
+void ShardedWorld::ReadRecord(const ShapeRecord& record, int source, vector<int>& deadProxies, vector<ShapeHandle>& deadShapes)
+{
+   std::map<unsigned long long, GhostShape>::iterator found = ghosts.find(record.id);
+
+   if (record.kind == RECORD_REMOVED) {
+      // Only whoever sent it last can take it away
+      if (found != ghosts.end() && found->second.source == source) {
+         deadProxies.push_back(found->second.proxyId);
+         deadShapes.push_back(found->second.handle);
+         ghosts.erase(found);
+      }
+      return;
+   }
+
+   // Somebody else's copy of a shape we own can't be right
+   if (owned.find(record.id) != owned.end() || record.type >= NUM_SHAPES) {
+      return;
+   }
+
+   if (found == ghosts.end()) {
+      GhostShape ghost;
+      ghost.handle = CreateShape(store, (ShapeType)record.type);
+      ghost.isStatic = (record.isStatic != 0);
+      Shape* shape = store.Get(ghost.handle);
+      if (shape == 0) {
+         // Only the kinds of shape the store makes can be sent
+         return;
+      }
+      shape->Filter(CollisionFilter(record.categoryBits, record.maskBits, record.groupIndex));
+      ReadFields(shape, record.fields);
+      ghost.proxyId = world.AddShape(store, ghost.handle, ghost.isStatic);
+      TrackProxy(ghost.proxyId, record.id);
+      found = ghosts.insert(std::make_pair(record.id, ghost)).first;
+      memcpy(found->second.fields, record.fields, sizeof(record.fields));
+   }
+   else if (memcmp(found->second.fields, record.fields, sizeof(record.fields)) != 0) {
+      // Only touch it if it moved, so resting ghosts don't wake anything
+      memcpy(found->second.fields, record.fields, sizeof(record.fields));
+      ReadFields(store.Get(found->second.handle), record.fields);
+   }
+
+   GhostShape& ghost = found->second;
+   Shape* shape = store.Get(ghost.handle);
+   shape->Filter(CollisionFilter(record.categoryBits, record.maskBits, record.groupIndex));
+   ghost.source = source;
+   ghost.seen = true;
+   ghost.version = shape->Version();
+
+   if (record.kind == RECORD_MIGRANT) {
+      OwnedShape mine;
+      mine.handle = ghost.handle;
+      mine.proxyId = ghost.proxyId;
+      mine.isStatic = ghost.isStatic;
+      mine.ghostedTo = 0;
+      mine.sentVersion = 0;
+      owned[record.id] = mine;
+      ghosts.erase(found);
+   }
+}
+
+//------------------------------------------------------
+// Sends border shapes out and brings the neighbours' in.
+// See the class comment for what goes in a message.
+// Messages are written without changing anything, and
+// what was sent (hand-overs, removals, who has which
+// static) is only taken as done once the swap went
+// through, so a failed one can just be tried again.
+//------------------------------------------------------
+bool ShardedWorld::Exchange()
+{
+   int count = (int)neighbours.size();
+   for (int nn = 0; nn < count; ++nn) {
+      outgoing[nn].clear();
+   }
+   for (std::map<unsigned long long, GhostShape>::iterator it = ghosts.begin(); it != ghosts.end(); ++it) {
+      it->second.seen = false;
+   }
+
+   ShapeRecord record;
+   memset(&record, 0, sizeof(record));
+
+   // Statics that went away
+   record.kind = RECORD_REMOVED;
+   for (unsigned int ii = 0; ii < removedStatics.size(); ++ii) {
+      record.id = removedStatics[ii].first;
+      for (int nn = 0; nn < count; ++nn) {
+         if (removedStatics[ii].second & (1u << nn)) {
+            AppendRecord(outgoing[nn], &record, sizeof(record));
+         }
+      }
+   }
+
+   int column = region % layout.columns;
+   int row = region / layout.columns;
+   vector<unsigned long long> leaving;
+   vector<int> leavingTo;
+   // Who'll have each shape once this goes out
+   vector<OwnedShape*> sent;
+   vector<unsigned int> sentTo;
+   for (std::map<unsigned long long, OwnedShape>::iterator it = owned.begin(); it != owned.end(); ++it) {
+      OwnedShape& mine = it->second;
+      Shape* shape = store.Get(mine.handle);
+      AABB bounds = ShapeBounds(shape);
+      AABB reach(bounds.minX - layout.margin, bounds.minY - layout.margin, bounds.maxX + layout.margin, bounds.maxY + layout.margin);
+
+      // A shape that went more than a region in one step goes
+      // to the neighbour on the way, and moves on from there
+      int home = layout.RegionAt((bounds.minX + bounds.maxX) * 0.5f, (bounds.minY + bounds.maxY) * 0.5f);
+      int target = -1;
+      if (home != region) {
+         int homeColumn = home % layout.columns;
+         int homeRow = home / layout.columns;
+         homeColumn = (homeColumn < column - 1 ? column - 1 : (homeColumn > column + 1 ? column + 1 : homeColumn));
+         homeRow = (homeRow < row - 1 ? row - 1 : (homeRow > row + 1 ? row + 1 : homeRow));
+         target = homeRow * layout.columns + homeColumn;
+      }
+
+      record.id = it->first;
+      record.type = (unsigned char)shape->Type();
+      record.isStatic = (mine.isStatic ? 1 : 0);
+      record.categoryBits = shape->CategoryBits();
+      record.maskBits = shape->MaskBits();
+      record.groupIndex = shape->GroupIndex();
+      WriteFields(shape, record.fields);
+
+      unsigned int ghostedTo = mine.ghostedTo;
+      for (int nn = 0; nn < count; ++nn) {
+         bool near = BoundsTouch(reach, layout.RegionBounds(neighbours[nn]));
+         unsigned int bit = 1u << nn;
+         if (neighbours[nn] == target) {
+            record.kind = RECORD_MIGRANT;
+         }
+         else if (mine.isStatic && target >= 0) {
+            // Whoever takes it over sends it again
+            if (!(mine.ghostedTo & bit)) {
+               continue;
+            }
+            record.kind = RECORD_REMOVED;
+         }
+         else if (!mine.isStatic) {
+            if (!near) {
+               continue;
+            }
+            record.kind = RECORD_GHOST;
+         }
+         else if (near && (!(mine.ghostedTo & bit) || mine.sentVersion != shape->Version())) {
+            record.kind = RECORD_GHOST;
+            ghostedTo |= bit;
+         }
+         else if (!near && (mine.ghostedTo & bit)) {
+            record.kind = RECORD_REMOVED;
+            ghostedTo &= ~bit;
+         }
+         else {
+            continue;
+         }
+         AppendRecord(outgoing[nn], &record, sizeof(record));
+      }
+      sent.push_back(&mine);
+      sentTo.push_back(ghostedTo);
+
+      if (target >= 0) {
+         leaving.push_back(it->first);
+         leavingTo.push_back(target);
+      }
+   }
+
+   if (!transport->Exchange(region, neighbours, outgoing, incoming)) {
+      return false;
+   }
+
+   removedStatics.clear();
+   for (unsigned int ii = 0; ii < sent.size(); ++ii) {
+      sent[ii]->ghostedTo = sentTo[ii];
+      sent[ii]->sentVersion = store.Get(sent[ii]->handle)->Version();
+   }
+
+   // Shapes we've handed over. Moving ones stay as ghosts,
+   // since the new owner won't send them until next step.
+   for (unsigned int ii = 0; ii < leaving.size(); ++ii) {
+      OwnedShape mine = owned[leaving[ii]];
+      owned.erase(leaving[ii]);
+      if (mine.isStatic) {
+         world.RemoveShape(mine.proxyId);
+         proxyIds[mine.proxyId] = 0;
+         store.Destroy(mine.handle);
+         continue;
+      }
+      GhostShape ghost;
+      ghost.handle = mine.handle;
+      ghost.proxyId = mine.proxyId;
+      ghost.isStatic = false;
+      ghost.source = leavingTo[ii];
+      ghost.seen = true;
+      Shape* shape = store.Get(mine.handle);
+      WriteFields(shape, ghost.fields);
+      ghost.version = shape->Version();
+      ghosts[leaving[ii]] = ghost;
+   }
+
+   vector<int> deadProxies;
+   vector<ShapeHandle> deadShapes;
+   for (int nn = 0; nn < count; ++nn) {
+      const vector<unsigned char>& message = incoming[nn];
+      for (size_t at = 0; at + sizeof(ShapeRecord) <= message.size(); at += sizeof(ShapeRecord)) {
+         memcpy(&record, &message[at], sizeof(record));
+         ReadRecord(record, neighbours[nn], deadProxies, deadShapes);
+      }
+   }
+
+   // Moving ghosts nobody sent this time have left the border
+   for (std::map<unsigned long long, GhostShape>::iterator it = ghosts.begin(); it != ghosts.end();) {
+      if (!it->second.seen && !it->second.isStatic) {
+         deadProxies.push_back(it->second.proxyId);
+         deadShapes.push_back(it->second.handle);
+         ghosts.erase(it++);
+      }
+      else {
+         ++it;
+      }
+   }
+
+   if (!deadProxies.empty()) {
+      world.RemoveShapes(deadProxies);
+      for (unsigned int ii = 0; ii < deadProxies.size(); ++ii) {
+         proxyIds[deadProxies[ii]] = 0;
+         store.Destroy(deadShapes[ii]);
+      }
+   }
+   return true;
+}
+
+//------------------------------------------------------
+// Undoes whatever the step did to ghosts. Their owners
+// worked out the same push and kept it.
+//------------------------------------------------------
+void ShardedWorld::PutGhostsBack()
+{
+   for (std::map<unsigned long long, GhostShape>::iterator it = ghosts.begin(); it != ghosts.end(); ++it) {
+      GhostShape& ghost = it->second;
+      Shape* shape = store.Get(ghost.handle);
+      if (shape->Version() != ghost.version) {
+         ReadFields(shape, ghost.fields);
+         ghost.version = shape->Version();
+      }
+   }
+}
+
+//------------------------------------------------------
+// One step of this region
+//------------------------------------------------------
+int ShardedWorld::Step()
+{
+   if (!Exchange()) {
+      return -1;
+   }
+   int collided = world.Step();
+   PutGhostsBack();
+   return collided;
+}
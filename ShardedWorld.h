@@ -0,0 +1,173 @@
+#ifndef SHARDEDWORLD_H_
+#define SHARDEDWORLD_H_
+
+#include "CollisionWorld.h"
+#include "ShapePool.h"
+#include "ShardTransport.h"
+
+#include <map>
+
+   // Floats it takes to write down any shape
+   const int shardRecordFields = 14;
+
+   //------------------------------------------------------
+   // How space is cut into regions: a grid of equal
+   // rectangles, numbered across then down. Anything off
+   // the edge of the grid belongs to the nearest region.
+   //------------------------------------------------------
+   struct ShardLayout
+   {
+      float minX;
+      float minY;
+      float regionWidth;
+      float regionHeight;
+      int columns;
+      int rows;
+      // Shapes this close to a border get copied to the region on the other side
+      float margin;
+
+      ShardLayout(float minX = 0.0f, float minY = 0.0f, float regionWidth = 1024.0f, float regionHeight = 1024.0f,
+         int columns = 1, int rows = 1, float margin = 32.0f)
+         : minX(minX), minY(minY), regionWidth(regionWidth), regionHeight(regionHeight),
+           columns(columns), rows(rows), margin(margin) {}
+
+      int RegionCount() const { return columns * rows; }
+      int RegionAt(float x, float y) const;
+      AABB RegionBounds(int region) const;
+   };
+
+   //------------------------------------------------------
+   // One region of a world split across processes.
+   //
+   // Each region's process runs one of these. It owns the
+   // shapes whose centers are in its region, and holds
+   // ghosts: copies of the neighbours' shapes that are
+   // within the margin of its borders. Ghosts collide like
+   // anything else, so shapes see across the border.
+   //
+   // Every Step() starts by swapping one message with each
+   // neighbour. It carries:
+   //    - every moving shape near that neighbour (a moving
+   //      ghost that isn't sent again goes away)
+   //    - static shapes, only when they're new to that
+   //      neighbour or have changed, and when they go away
+   //    - shapes whose center has crossed into the neighbour,
+   //      which it takes over
+   //
+   // A pair across a border comes out the same on both
+   // sides. Both start the step with identical copies of the
+   // two shapes and resolve the pair the same way, so each
+   // side's share of the push is what the other side worked
+   // out too. Each keeps its own shape's share and puts the
+   // ghost back. (Long chains of contacts across a border can
+   // still differ a little from one big world, since each
+   // side only sees as far as the margin.) Incoming messages
+   // are handled in region order and their shapes in id
+   // order, so the local world is the same every run no
+   // matter who talks first.
+   //
+   // Shapes are made in Store(), then handed over with
+   // AddShape(), which gives back an id that's unique across
+   // every region. Shapes can move on to other regions,
+   // where they turn up with the same id (OwnedShapes()).
+   //------------------------------------------------------
+   class ShardedWorld
+   {
+   private:
+      struct OwnedShape
+      {
+         ShapeHandle handle;
+         int proxyId;
+         bool isStatic;
+         // Which neighbours have this static shape, and the version they have
+         unsigned int ghostedTo;
+         unsigned int sentVersion;
+      };
+
+      struct GhostShape
+      {
+         ShapeHandle handle;
+         int proxyId;
+         bool isStatic;
+         // The region that last sent it
+         int source;
+         // Version after it was last put back, to tell if the world pushed it
+         unsigned int version;
+         // Sent this exchange
+         bool seen;
+         // The shape as it was sent
+         float fields[shardRecordFields];
+      };
+
+      // One shape on the wire
+      struct ShapeRecord;
+
+      ShardLayout layout;
+      int region;
+      ShardTransport* transport;
+      // The store goes before the world, so it outlives it
+      ShapeStore store;
+      CollisionWorld world;
+      unsigned long long nextId;
+
+      // Keyed by id, so everything walks them in the same order
+      std::map<unsigned long long, OwnedShape> owned;
+      std::map<unsigned long long, GhostShape> ghosts;
+      // Static shapes removed since the last exchange, and who had them
+      vector<std::pair<unsigned long long, unsigned int> > removedStatics;
+      // Global id of every proxy in the world (0 for none)
+      vector<unsigned long long> proxyIds;
+
+      // Neighbouring regions, lowest first
+      vector<int> neighbours;
+      vector<vector<unsigned char> > outgoing;
+      vector<vector<unsigned char> > incoming;
+
+      void ReadRecord(const ShapeRecord& record, int source, vector<int>& deadProxies, vector<ShapeHandle>& deadShapes);
+      void TrackProxy(int proxyId, unsigned long long id);
+      bool Exchange();
+      void PutGhostsBack();
+
+      ShardedWorld(const ShardedWorld&) = delete;
+      ShardedWorld& operator=(const ShardedWorld&) = delete;
+
+   public:
+      // The transport isn't owned. Every region needs the same layout.
+      ShardedWorld(const ShardLayout& layout, int region, ShardTransport& transport);
+
+      // Where shapes come from
+      ShapeStore& Store() { return store; }
+      // The local world: owned shapes and ghosts. Don't add to it directly.
+      CollisionWorld& World() { return world; }
+
+      // Hands a shape made in Store() to this region. Returns its id.
+      unsigned long long AddShape(ShapeHandle handle, bool isStatic = false);
+      // Removes (and destroys) an owned shape
+      void RemoveShape(unsigned long long id);
+
+      // Accessors
+      const ShardLayout& Layout() const { return layout; }
+      int Region() const { return region; }
+      const vector<int>& Neighbours() const { return neighbours; }
+      int OwnedCount() const { return (int)owned.size(); }
+      int GhostCount() const { return (int)ghosts.size(); }
+      // The shape if this region owns it (a null handle if not)
+      ShapeHandle Find(unsigned long long id) const;
+      // Every id this region owns, lowest first
+      void OwnedShapes(vector<unsigned long long>& ids) const;
+      // What's behind a proxy in World()
+      unsigned long long GlobalId(int proxyId) const { return proxyIds[proxyId]; }
+      bool IsGhost(int proxyId) const;
+
+      /*
+        Swaps border shapes with the neighbours, then steps
+        the local world. Every region has to call this once a
+        step. Returns how many pairs collided, or -1 if a
+        neighbour couldn't be reached. Then nothing is
+        stepped and nothing handed over, so Step() can be
+        called again if the transport can carry on.
+      */
+      int Step();
+   };
+
+#endif // SHARDEDWORLD_H_
@@ -0,0 +1,553 @@
+#include "StaticMesh.h"
+
+// For sort & nth_element
+#include <algorithm>
+// For sqrtf, atan2f
+#include <cmath>
+
+// How close things need to be to count as touching/collinear
+const float bakeTolerance = 0.001f;
+
+// How many primitives a leaf can hold
+const int leafSize = 4;
+
+//------------------------------------------------------
+// A line while it's being merged. The line runs along
+// direction (dx, dy) from t0 to t1, offset from the
+// origin by "offset" along the line's normal. flipped is
+// set if the original line ran the other way, so its
+// normal points the other way too.
+//------------------------------------------------------
+struct MergeLine
+{
+   float angle;
+   float offset;
+   float t0, t1;
+   float dx, dy;
+   bool flipped;
+};
+
+bool MergeLineLess(const MergeLine& a, const MergeLine& b) {
+   if (a.angle != b.angle) return a.angle < b.angle;
+   if (a.offset != b.offset) return a.offset < b.offset;
+   if (a.flipped != b.flipped) return b.flipped;
+   return a.t0 < b.t0;
+}
+
+bool BoxRowLess(const StaticPrimitive& a, const StaticPrimitive& b) {
+   if (a.ay != b.ay) return a.ay < b.ay;
+   if (a.by != b.by) return a.by < b.by;
+   return a.ax < b.ax;
+}
+
+bool BoxColumnLess(const StaticPrimitive& a, const StaticPrimitive& b) {
+   if (a.ax != b.ax) return a.ax < b.ax;
+   if (a.bx != b.bx) return a.bx < b.bx;
+   return a.ay < b.ay;
+}
+
+//------------------------------------------------------
+// Adds a wall line to the mesh
+//------------------------------------------------------
+void StaticMesh::AddLine(const Line& line)
+{
+   StaticPrimitive primitive;
+   primitive.ax = line.StartX();
+   primitive.ay = line.StartY();
+   primitive.bx = line.EndX();
+   primitive.by = line.EndY();
+   line.Normal(0, primitive.nx, primitive.ny);
+   primitive.type = StaticPrimitive::SEGMENT;
+   primitive.pad = 0;
+   primitives.push_back(primitive);
+   baked = false;
+}
+
+//------------------------------------------------------
+// Adds an axis aligned box to the mesh
+//------------------------------------------------------
+bool StaticMesh::AddBox(const Box& box)
+{
+   // Only boxes with no rotation (or a multiple of 90) can be baked
+   float x, y;
+   box.Normal(0, x, y);
+   if (!FloatEquals(y, 0.0f) && !FloatEquals(x, 0.0f)) {
+      return false;
+   }
+
+   AABB bounds = ShapeBounds(const_cast<Box*>(&box));
+   StaticPrimitive primitive;
+   primitive.ax = bounds.minX;
+   primitive.ay = bounds.minY;
+   primitive.bx = bounds.maxX;
+   primitive.by = bounds.maxY;
+   primitive.nx = primitive.ny = 0.0f;
+   primitive.type = StaticPrimitive::BOX;
+   primitive.pad = 0;
+   primitives.push_back(primitive);
+   baked = false;
+   return true;
+}
+
+//------------------------------------------------------
+// Throws everything away
+//------------------------------------------------------
+void StaticMesh::Clear()
+{
+   primitives.clear();
+   nodes.clear();
+   baked = false;
+}
+
+//------------------------------------------------------
+// Merges lines that are on the same infinite line, face
+// the same way and touch/overlap into one longer line.
+// The merged line runs the same way as the ones it was
+// made from, so its normal still points out of the wall.
+//------------------------------------------------------
+void StaticMesh::MergeSegments()
+{
+   vector<MergeLine> lines;
+   vector<StaticPrimitive> others;
+
+   for (unsigned int ii = 0; ii < primitives.size(); ++ii) {
+      const StaticPrimitive& primitive = primitives[ii];
+      if (primitive.type != StaticPrimitive::SEGMENT) {
+         others.push_back(primitive);
+         continue;
+      }
+
+      float dx = primitive.bx - primitive.ax;
+      float dy = primitive.by - primitive.ay;
+      float length = sqrtf(dx * dx + dy * dy);
+      if (length <= bakeTolerance) {
+         // Zero length lines can't be hit anyway
+         continue;
+      }
+      dx /= length;
+      dy /= length;
+
+      // Always point the same way, so flipped lines still
+      // line up (but remember which way they faced)
+      bool flipped = false;
+      if (dx < -bakeTolerance || (dx <= bakeTolerance && dy < 0.0f)) {
+         dx = -dx;
+         dy = -dy;
+         flipped = true;
+      }
+
+      MergeLine line;
+      line.flipped = flipped;
+      line.dx = dx;
+      line.dy = dy;
+      line.angle = atan2f(dy, dx);
+      line.offset = (primitive.ax * -dy) + (primitive.ay * dx);
+      float tA = primitive.ax * dx + primitive.ay * dy;
+      float tB = primitive.bx * dx + primitive.by * dy;
+      line.t0 = (tA < tB ? tA : tB);
+      line.t1 = (tA < tB ? tB : tA);
+      lines.push_back(line);
+   }
+
+   std::sort(lines.begin(), lines.end(), MergeLineLess);
+
+   primitives = others;
+   unsigned int current = 0;
+   while (current < lines.size()) {
+      MergeLine merged = lines[current];
+      unsigned int next = current + 1;
+
+      // Swallow every following line that's on the same line, faces the same way and touches
+      while (next < lines.size()
+         && absValue(lines[next].angle - merged.angle) <= bakeTolerance
+         && absValue(lines[next].offset - merged.offset) <= bakeTolerance
+         && lines[next].flipped == merged.flipped
+         && lines[next].t0 <= merged.t1 + bakeTolerance) {
+         if (lines[next].t1 > merged.t1) {
+            merged.t1 = lines[next].t1;
+         }
+         ++next;
+      }
+
+      // Rebuild the end points from the line's offset and
+      // direction, running the way the originals did
+      StaticPrimitive primitive;
+      float baseX = -merged.dy * merged.offset;
+      float baseY = merged.dx * merged.offset;
+      float start = (merged.flipped ? merged.t1 : merged.t0);
+      float end = (merged.flipped ? merged.t0 : merged.t1);
+      primitive.ax = baseX + merged.dx * start;
+      primitive.ay = baseY + merged.dy * start;
+      primitive.bx = baseX + merged.dx * end;
+      primitive.by = baseY + merged.dy * end;
+      primitive.nx = (merged.flipped ? -merged.dy : merged.dy);
+      primitive.ny = (merged.flipped ? merged.dx : -merged.dx);
+      primitive.type = StaticPrimitive::SEGMENT;
+      primitive.pad = 0;
+      primitives.push_back(primitive);
+
+      current = next;
+   }
+}
+
+//------------------------------------------------------
+// Glues boxes that share a full edge into bigger boxes.
+// Rows first (same top & bottom), then columns.
+//------------------------------------------------------
+void StaticMesh::MergeBoxes()
+{
+   vector<StaticPrimitive> boxes;
+   vector<StaticPrimitive> others;
+   for (unsigned int ii = 0; ii < primitives.size(); ++ii) {
+      if (primitives[ii].type == StaticPrimitive::BOX) {
+         boxes.push_back(primitives[ii]);
+      }
+      else {
+         others.push_back(primitives[ii]);
+      }
+   }
+
+   for (int pass = 0; pass < 2; ++pass) {
+      bool rows = (pass == 0);
+      std::sort(boxes.begin(), boxes.end(), rows ? BoxRowLess : BoxColumnLess);
+
+      vector<StaticPrimitive> merged;
+      for (unsigned int ii = 0; ii < boxes.size(); ++ii) {
+         if (merged.size() > 0) {
+            StaticPrimitive& last = merged.back();
+            if (rows
+               && absValue(last.ay - boxes[ii].ay) <= bakeTolerance
+               && absValue(last.by - boxes[ii].by) <= bakeTolerance
+               && boxes[ii].ax <= last.bx + bakeTolerance) {
+               if (boxes[ii].bx > last.bx) last.bx = boxes[ii].bx;
+               continue;
+            }
+            if (!rows
+               && absValue(last.ax - boxes[ii].ax) <= bakeTolerance
+               && absValue(last.bx - boxes[ii].bx) <= bakeTolerance
+               && boxes[ii].ay <= last.by + bakeTolerance) {
+               if (boxes[ii].by > last.by) last.by = boxes[ii].by;
+               continue;
+            }
+         }
+         merged.push_back(boxes[ii]);
+      }
+      boxes = merged;
+   }
+
+   primitives = others;
+   primitives.insert(primitives.end(), boxes.begin(), boxes.end());
+}
+
+//------------------------------------------------------
+// Gets the bounds of a single primitive
+//------------------------------------------------------
+AABB StaticMesh::PrimitiveBounds(const StaticPrimitive& primitive) const
+{
+   return AABB(primitive.ax < primitive.bx ? primitive.ax : primitive.bx,
+      primitive.ay < primitive.by ? primitive.ay : primitive.by,
+      primitive.ax < primitive.bx ? primitive.bx : primitive.ax,
+      primitive.ay < primitive.by ? primitive.by : primitive.ay);
+}
+
+//------------------------------------------------------
+// Sorts primitives along an axis by their center
+//------------------------------------------------------
+struct CenterLess
+{
+   bool xAxis;
+   bool operator()(const StaticPrimitive& a, const StaticPrimitive& b) const {
+      return (xAxis ? (a.ax + a.bx) < (b.ax + b.bx) : (a.ay + a.by) < (b.ay + b.by));
+   }
+};
+
+//------------------------------------------------------
+// Builds the node for a run of primitives (and all of
+// its children). Returns the node's index.
+//------------------------------------------------------
+int StaticMesh::BuildNode(int first, int count)
+{
+   int nodeIndex = (int)nodes.size();
+   nodes.push_back(StaticNode());
+
+   // Fit the bounds around everything
+   AABB bounds = PrimitiveBounds(primitives[first]);
+   for (int ii = first + 1; ii < first + count; ++ii) {
+      AABB current = PrimitiveBounds(primitives[ii]);
+      if (current.minX < bounds.minX) bounds.minX = current.minX;
+      if (current.minY < bounds.minY) bounds.minY = current.minY;
+      if (current.maxX > bounds.maxX) bounds.maxX = current.maxX;
+      if (current.maxY > bounds.maxY) bounds.maxY = current.maxY;
+   }
+   nodes[nodeIndex].bounds = bounds;
+   nodes[nodeIndex].pad[0] = nodes[nodeIndex].pad[1] = 0;
+
+   if (count <= leafSize) {
+      nodes[nodeIndex].index = first;
+      nodes[nodeIndex].count = count;
+      return nodeIndex;
+   }
+
+   // Split down the middle of the longest side
+   CenterLess less;
+   less.xAxis = (bounds.maxX - bounds.minX) >= (bounds.maxY - bounds.minY);
+   int half = count / 2;
+   std::nth_element(primitives.begin() + first, primitives.begin() + first + half, primitives.begin() + first + count, less);
+
+   // Left child is always the next node
+   BuildNode(first, half);
+   int right = BuildNode(first + half, count - half);
+   nodes[nodeIndex].index = right;
+   nodes[nodeIndex].count = 0;
+   return nodeIndex;
+}
+
+//------------------------------------------------------
+// Merges everything that can be merged, and builds the tree
+//------------------------------------------------------
+void StaticMesh::Bake()
+{
+   MergeSegments();
+   MergeBoxes();
+
+   nodes.clear();
+   if (primitives.size() > 0) {
+      nodes.reserve(primitives.size() * 2 / leafSize + 1);
+      BuildNode(0, (int)primitives.size());
+   }
+
+   // Trim the fat, this is read only from now on
+   vector<StaticPrimitive>(primitives).swap(primitives);
+   vector<StaticNode>(nodes).swap(nodes);
+   baked = true;
+}
+
+//------------------------------------------------------
+// Finds every primitive whose bounds touch the area
+//------------------------------------------------------
+void StaticMesh::Query(const AABB& area, vector<int>& results) const
+{
+   if (nodes.size() == 0) {
+      return;
+   }
+
+   int stack[64];
+   int stackSize = 0;
+   stack[stackSize++] = 0;
+
+   while (stackSize > 0) {
+      const StaticNode& node = nodes[stack[--stackSize]];
+      if (!node.bounds.Overlaps(area)) {
+         continue;
+      }
+
+      if (node.count > 0) {
+         for (int ii = node.index; ii < node.index + node.count; ++ii) {
+            if (PrimitiveBounds(primitives[ii]).Overlaps(area)) {
+               results.push_back(ii);
+            }
+         }
+      }
+      else {
+         // Left is right after this node
+         stack[stackSize++] = node.index;
+         stack[stackSize++] = (int)(&node - &nodes[0]) + 1;
+      }
+   }
+}
+
+//------------------------------------------------------
+// Pushes a circle off a wall segment, away from the
+// closest point on it (out along the normal if the
+// center is right on the wall)
+//------------------------------------------------------
+bool PushCircleOffSegment(Circle* circle, const StaticPrimitive& segment)
+{
+   float x = circle->CenterX();
+   float y = circle->CenterY();
+   float alongX = segment.bx - segment.ax;
+   float alongY = segment.by - segment.ay;
+   float lengthSquared = alongX * alongX + alongY * alongY;
+   float t = 0.0f;
+   if (lengthSquared > 0.0f) {
+      t = ((x - segment.ax) * alongX + (y - segment.ay) * alongY) / lengthSquared;
+      t = (t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t));
+   }
+   float dx = x - (segment.ax + alongX * t);
+   float dy = y - (segment.ay + alongY * t);
+   float distanceSquared = dx * dx + dy * dy;
+
+   if (distanceSquared > circle->RadiusSquared()) {
+      return false;
+   }
+
+   if (distanceSquared > 0.0f) {
+      float distance = sqrtf(distanceSquared);
+      float push = circle->Radius() - distance;
+      circle->Move(dx / distance * push, dy / distance * push);
+   }
+   else {
+      circle->Move(segment.nx * circle->Radius(), segment.ny * circle->Radius());
+   }
+   return true;
+}
+
+//------------------------------------------------------
+// Pushes a point, line or box out of a primitive with
+// SAT, straight off the primitive's corners and normal.
+// A segment is tested along itself as well as its normal,
+// so shapes past its ends miss.
+//------------------------------------------------------
+bool PushOutOfPrimitive(Shape* shape, const StaticPrimitive& primitive)
+{
+   Point normals[6];
+   Point wall[4];
+   Point corners[4];
+   int normalCount = 0;
+   int wallCount = 0;
+   int cornerCount = 0;
+   float x, y;
+
+   if (primitive.type == StaticPrimitive::SEGMENT) {
+      wall[wallCount++] = Point(primitive.ax, primitive.ay);
+      wall[wallCount++] = Point(primitive.bx, primitive.by);
+      normals[normalCount++] = Point(primitive.nx, primitive.ny);
+      normals[normalCount++] = Point(primitive.ny, -primitive.nx);
+   }
+   else {
+      wall[wallCount++] = Point(primitive.ax, primitive.ay);
+      wall[wallCount++] = Point(primitive.bx, primitive.ay);
+      wall[wallCount++] = Point(primitive.ax, primitive.by);
+      wall[wallCount++] = Point(primitive.bx, primitive.by);
+      normals[normalCount++] = Point(1.0f, 0.0f);
+      normals[normalCount++] = Point(0.0f, 1.0f);
+   }
+
+   switch (shape->Type()) {
+   case SHAPE_POINT:
+      corners[cornerCount++] = *static_cast<Point*>(shape);
+      break;
+   case LINE:
+   {
+      Line* line = static_cast<Line*>(shape);
+      corners[cornerCount++] = line->Start();
+      corners[cornerCount++] = line->End();
+      line->Normal(0, x, y);
+      normals[normalCount++] = Point(x, y);
+      break;
+   }
+   case BOX:
+   {
+      Box* box = static_cast<Box*>(shape);
+      corners[cornerCount++] = box->TL();
+      corners[cornerCount++] = box->TR();
+      corners[cornerCount++] = box->BL();
+      corners[cornerCount++] = box->BR();
+      box->Normal(0, x, y);
+      normals[normalCount++] = Point(x, y);
+      box->Normal(1, x, y);
+      normals[normalCount++] = Point(x, y);
+      break;
+   }
+   default:
+      return false;
+   }
+
+   FrameAllocator& scratch = ThreadFrameAllocator();
+   FrameAllocator::Marker marker = scratch.GetMarker();
+   Point overlapDir;
+   float overlap;
+   bool collided = SatOverlap(normals, normalCount, wall, wallCount, corners, cornerCount, overlapDir, overlap, scratch);
+   scratch.Rewind(marker);
+   if (!collided) {
+      return false;
+   }
+
+   // The wall doesn't move, the shape takes it all
+   Point push = overlapDir * overlap;
+   switch (shape->Type()) {
+   case SHAPE_POINT: static_cast<Point*>(shape)->Move(push.X(), push.Y()); break;
+   case LINE: static_cast<Line*>(shape)->Move(push.X(), push.Y()); break;
+   default: static_cast<Box*>(shape)->Move(push.X(), push.Y()); break;
+   }
+   return true;
+}
+
+//------------------------------------------------------
+// Collides a shape against one primitive. The simple
+// shapes are tested right against the packed primitive.
+// Chains and compounds are made of those, so they get a
+// Line or Box to go through the usual pair test.
+//------------------------------------------------------
+bool StaticMesh::CollidePrimitive(Shape* shape, const StaticPrimitive& primitive) const
+{
+   if (!ShouldCollide(shape->Filter(), filter)) {
+      return false;
+   }
+
+   switch (shape->Type()) {
+   case CIRCLE:
+      if (primitive.type == StaticPrimitive::SEGMENT) {
+         return PushCircleOffSegment(static_cast<Circle*>(shape), primitive);
+      }
+      // Merged boxes can be really long, which the generic
+      // circle/box test doesn't handle well. Use the closest point.
+      return PushCircleOutOfAABB(static_cast<Circle*>(shape), PrimitiveBounds(primitive));
+   case SHAPE_POINT:
+   case LINE:
+   case BOX:
+      return PushOutOfPrimitive(shape, primitive);
+   default:
+      if (primitive.type == StaticPrimitive::SEGMENT) {
+         Line wall(primitive.ax, primitive.ay, primitive.bx, primitive.by);
+         wall.Filter(filter);
+         return HandleCollision(shape, &wall, PushPercentFor(shape, &wall, 1.0f));
+      }
+      else {
+         Box wall(Point(primitive.ax, primitive.ay), Point(primitive.bx, primitive.by));
+         wall.Filter(filter);
+         return HandleCollision(shape, &wall, PushPercentFor(shape, &wall, 1.0f));
+      }
+   }
+}
+
+//------------------------------------------------------
+// Collides a shape against the level. The level never
+// moves, so the shape takes the whole push.
+//
+// Walks the tree itself rather than using Query(), so
+// no list of results ever gets allocated.
+//------------------------------------------------------
+bool StaticMesh::Collide(Shape* shape) const
+{
+   if (shape == 0 || nodes.size() == 0) {
+      return false;
+   }
+
+   AABB area = ShapeBounds(shape);
+   int stack[64];
+   int stackSize = 0;
+   stack[stackSize++] = 0;
+
+   bool collided = false;
+   while (stackSize > 0) {
+      int nodeIndex = stack[--stackSize];
+      const StaticNode& node = nodes[nodeIndex];
+      if (!node.bounds.Overlaps(area)) {
+         continue;
+      }
+
+      if (node.count > 0) {
+         for (int ii = node.index; ii < node.index + node.count; ++ii) {
+            if (PrimitiveBounds(primitives[ii]).Overlaps(area)) {
+               collided |= CollidePrimitive(shape, primitives[ii]);
+            }
+         }
+      }
+      else {
+         stack[stackSize++] = node.index;
+         stack[stackSize++] = nodeIndex + 1;
+      }
+   }
+   return collided;
+}
@@ -0,0 +1,98 @@
+#ifndef STATICMESH_H_
+#define STATICMESH_H_
+
+#include "Collisions.h"
+
+   //------------------------------------------------------
+   // One piece of baked level geometry. Either a wall
+   // segment (a -> b, with its collision normal) or an
+   // axis aligned box (a = min corner, b = max corner).
+   //
+   // Kept small (32 bytes), since the leaves walk through
+   // runs of them.
+   //------------------------------------------------------
+   struct StaticPrimitive
+   {
+      enum TYPE {
+         SEGMENT = 0,
+         BOX
+      };
+
+      float ax, ay;
+      float bx, by;
+      float nx, ny;
+      int type;
+      int pad;
+   };
+
+   //------------------------------------------------------
+   // A BVH node. Leaves point at a run of primitives,
+   // inner nodes point at their two children
+   // (left child is always right after its parent).
+   //------------------------------------------------------
+   struct StaticNode
+   {
+      AABB bounds;
+      // Leaf: first primitive. Inner: right child.
+      int index;
+      // Leaf: number of primitives. Inner: 0
+      int count;
+      int pad[2];
+   };
+
+   //------------------------------------------------------
+   // Read only, baked collision geometry for a level.
+   //
+   // Add the level's Lines and axis aligned Boxes, then
+   // call Bake(). Baking merges collinear touching lines,
+   // glues neighbouring boxes together into bigger boxes,
+   // and builds a BVH over what's left. After that the
+   // original shapes can be deleted.
+   //------------------------------------------------------
+   class StaticMesh
+   {
+   private:
+      vector<StaticPrimitive> primitives;
+      vector<StaticNode> nodes;
+      CollisionFilter filter;
+      bool baked;
+
+      void MergeSegments();
+      void MergeBoxes();
+      int BuildNode(int first, int count);
+      AABB PrimitiveBounds(const StaticPrimitive& primitive) const;
+      bool CollidePrimitive(Shape* shape, const StaticPrimitive& primitive) const;
+
+   public:
+      StaticMesh() : baked(false) {}
+
+      // Adding geometry (only before Bake)
+      void AddLine(const Line& line);
+      // Rotated boxes can't be baked; returns false for them
+      bool AddBox(const Box& box);
+      void Clear();
+
+      // Merges and builds the tree
+      void Bake();
+
+      // Accessors
+      bool Baked() const { return baked; }
+      int PrimitiveCount() const { return (int)primitives.size(); }
+      const StaticPrimitive& Primitive(int index) const { return primitives[index]; }
+      int NodeCount() const { return (int)nodes.size(); }
+      AABB Bounds() const { return nodes.size() > 0 ? nodes[0].bounds : AABB(); }
+      const CollisionFilter& Filter() const { return filter; }
+
+      // Mutators
+      // (the filter every baked primitive collides with)
+      void Filter(const CollisionFilter& filter) { this->filter = filter; }
+
+      // Finds all the primitives whose bounds touch the area
+      void Query(const AABB& area, vector<int>& results) const;
+
+      // Collides a dynamic shape against the level, pushing
+      // only the shape. Returns true if it hit anything.
+      bool Collide(Shape* shape) const;
+   };
+
+#endif // STATICMESH_H_
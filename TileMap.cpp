@@ -0,0 +1,350 @@
+#include "TileMap.h"
+
+// For floorf
+#include <cmath>
+
+//------------------------------------------------------
+// Constructor. Everything starts empty.
+//------------------------------------------------------
+TileMap::TileMap(int columns, int rows, float tileSize, float originX, float originY)
+{
+   this->tileSize = tileSize;
+   this->originX = originX;
+   this->originY = originY;
+   Resize(columns, rows);
+}
+
+//------------------------------------------------------
+// Resizes the map. Every tile becomes empty.
+//------------------------------------------------------
+void TileMap::Resize(int columns, int rows)
+{
+   this->columns = (columns > 0 ? columns : 0);
+   this->rows = (rows > 0 ? rows : 0);
+   this->wordsPerRow = (this->columns + 31) / 32;
+   bits.assign(this->wordsPerRow * this->rows, 0);
+}
+
+//------------------------------------------------------
+// Is a tile solid? (Off the map is empty)
+//------------------------------------------------------
+bool TileMap::Solid(int column, int row) const
+{
+   if (column < 0 || row < 0 || column >= columns || row >= rows) {
+      return false;
+   }
+   return (bits[row * wordsPerRow + (column >> 5)] & (1u << (column & 31))) != 0;
+}
+
+//------------------------------------------------------
+// Sets if a tile is solid
+//------------------------------------------------------
+void TileMap::Solid(int column, int row, bool solid)
+{
+   if (column < 0 || row < 0 || column >= columns || row >= rows) {
+      return;
+   }
+   unsigned int& word = bits[row * wordsPerRow + (column >> 5)];
+   if (solid) {
+      word |= (1u << (column & 31));
+   }
+   else {
+      word &= ~(1u << (column & 31));
+   }
+}
+
+//------------------------------------------------------
+// Is the tile under a world position solid?
+//------------------------------------------------------
+bool TileMap::SolidAt(float x, float y) const
+{
+   return Solid((int)floorf((x - originX) / tileSize), (int)floorf((y - originY) / tileSize));
+}
+
+//------------------------------------------------------
+// Gets the world bounds of a tile
+//------------------------------------------------------
+AABB TileMap::TileBounds(int column, int row) const
+{
+   float left = originX + column * tileSize;
+   float top = originY + row * tileSize;
+   return AABB(left, top, left + tileSize, top + tileSize);
+}
+
+//------------------------------------------------------
+// Gets the range of tiles an area covers, clipped to the map.
+// The range is empty (first > last) if it's off the map.
+//------------------------------------------------------
+void TileMap::TileRange(const AABB& area, int& firstColumn, int& firstRow, int& lastColumn, int& lastRow) const
+{
+   firstColumn = (int)floorf((area.minX - originX) / tileSize);
+   firstRow = (int)floorf((area.minY - originY) / tileSize);
+   lastColumn = (int)floorf((area.maxX - originX) / tileSize);
+   lastRow = (int)floorf((area.maxY - originY) / tileSize);
+
+   if (firstColumn < 0) firstColumn = 0;
+   if (firstRow < 0) firstRow = 0;
+   if (lastColumn >= columns) lastColumn = columns - 1;
+   if (lastRow >= rows) lastRow = rows - 1;
+}
+
+//------------------------------------------------------
+// Pushes a convex set of points out of every solid tile
+// it overlaps, using SAT. The axes tested are the tile
+// axes plus the shape's own normals. The points are moved,
+// and the total move is returned in moveX/moveY.
+//------------------------------------------------------
+bool TileMap::CollidePoints(Point* points, int pointCount, Point* normals, int normalCount, float& moveX, float& moveY) const
+{
+   moveX = moveY = 0.0f;
+
+   // Bounds of the shape
+   AABB area(points[0].X(), points[0].Y(), points[0].X(), points[0].Y());
+   for (int ii = 1; ii < pointCount; ++ii) {
+      if (points[ii].X() < area.minX) area.minX = points[ii].X();
+      if (points[ii].X() > area.maxX) area.maxX = points[ii].X();
+      if (points[ii].Y() < area.minY) area.minY = points[ii].Y();
+      if (points[ii].Y() > area.maxY) area.maxY = points[ii].Y();
+   }
+
+   int firstColumn, firstRow, lastColumn, lastRow;
+   TileRange(area, firstColumn, firstRow, lastColumn, lastRow);
+
+   bool collided = false;
+   for (int row = firstRow; row <= lastRow; ++row) {
+      for (int column = firstColumn; column <= lastColumn; ++column) {
+         if (!Solid(column, row)) {
+            continue;
+         }
+
+         AABB tile = TileBounds(column, row);
+         Point tileCorners[4] = { Point(tile.minX, tile.minY), Point(tile.maxX, tile.minY),
+            Point(tile.minX, tile.maxY), Point(tile.maxX, tile.maxY) };
+
+         // Tile axes first, then the shape's own
+         bool separated = false;
+         bool first = true;
+         float bestPush = 0.0f;
+         Point bestAxis;
+         for (int axis = 0; axis < 2 + normalCount && !separated; ++axis) {
+            Point normal = (axis == 0 ? Point(1.0f, 0.0f) : (axis == 1 ? Point(0.0f, 1.0f) : normals[axis - 2]));
+
+            float aMin, aMax, bMin, bMax;
+            aMin = aMax = points[0].Dot(normal);
+            for (int ii = 1; ii < pointCount; ++ii) {
+               float dot = points[ii].Dot(normal);
+               if (dot < aMin) aMin = dot;
+               if (dot > aMax) aMax = dot;
+            }
+            bMin = bMax = tileCorners[0].Dot(normal);
+            for (int ii = 1; ii < 4; ++ii) {
+               float dot = tileCorners[ii].Dot(normal);
+               if (dot < bMin) bMin = dot;
+               if (dot > bMax) bMax = dot;
+            }
+
+            if (aMin >= bMax || aMax <= bMin) {
+               separated = true;
+               break;
+            }
+
+            // Smallest way out along this axis
+            float push = (absValue(bMax - aMin) < absValue(bMin - aMax) ? bMax - aMin : bMin - aMax);
+            if (first || absValue(push) < absValue(bestPush)) {
+               bestPush = push;
+               bestAxis = normal;
+               first = false;
+            }
+         }
+
+         if (separated) {
+            continue;
+         }
+
+         // Move the shape (and our copy of its points) out
+         float pushX = bestAxis.X() * bestPush;
+         float pushY = bestAxis.Y() * bestPush;
+         for (int ii = 0; ii < pointCount; ++ii) {
+            points[ii].Move(pushX, pushY);
+         }
+         moveX += pushX;
+         moveY += pushY;
+         collided = true;
+      }
+   }
+
+   return collided;
+}
+
+//------------------------------------------------------
+// Collides a circle against the tiles it covers.
+//
+// Tiles in the same row/column as the center go first,
+// since they push straight out of a face. By the time the
+// diagonal tiles are tested the circle has usually left
+// them, so it doesn't snag on the corners between tiles.
+//------------------------------------------------------
+bool TileMap::CollideCircle(Circle* circle) const
+{
+   AABB area(circle->CenterX() - circle->Radius(), circle->CenterY() - circle->Radius(),
+      circle->CenterX() + circle->Radius(), circle->CenterY() + circle->Radius());
+
+   int firstColumn, firstRow, lastColumn, lastRow;
+   TileRange(area, firstColumn, firstRow, lastColumn, lastRow);
+   int centerColumn = (int)floorf((circle->CenterX() - originX) / tileSize);
+   int centerRow = (int)floorf((circle->CenterY() - originY) / tileSize);
+
+   bool collided = false;
+   for (int pass = 0; pass < 2; ++pass) {
+      for (int row = firstRow; row <= lastRow; ++row) {
+         for (int column = firstColumn; column <= lastColumn; ++column) {
+            bool facing = (row == centerRow || column == centerColumn);
+            if (facing == (pass == 0) && Solid(column, row)) {
+               collided |= PushCircleOutOfAABB(circle, TileBounds(column, row));
+            }
+         }
+      }
+   }
+   return collided;
+}
+
+//------------------------------------------------------
+// Collides a box (rotated or not) against the tiles
+//------------------------------------------------------
+bool TileMap::CollideBox(Box* box) const
+{
+   Point corners[4] = { box->TL(), box->TR(), box->BL(), box->BR() };
+   Point normals[2];
+   float x, y;
+   box->Normal(0, x, y);
+   normals[0] = Point(x, y);
+   box->Normal(1, x, y);
+   normals[1] = Point(x, y);
+
+   float moveX, moveY;
+   if (CollidePoints(corners, 4, normals, 2, moveX, moveY)) {
+      box->Move(moveX, moveY);
+      return true;
+   }
+   return false;
+}
+
+//------------------------------------------------------
+// Collides a line against the tiles
+//------------------------------------------------------
+bool TileMap::CollideLine(Line* line) const
+{
+   Point ends[2] = { line->Start(), line->End() };
+   Point normal;
+   float x, y;
+   line->Normal(0, x, y);
+   normal = Point(x, y);
+
+   float moveX, moveY;
+   if (CollidePoints(ends, 2, &normal, 1, moveX, moveY)) {
+      line->Move(moveX, moveY);
+      return true;
+   }
+   return false;
+}
+
+//------------------------------------------------------
+// Pushes a point out of the tile it's in
+//------------------------------------------------------
+bool TileMap::CollidePoint(Point* point) const
+{
+   float moveX, moveY;
+   Point copy = *point;
+   if (CollidePoints(&copy, 1, 0, 0, moveX, moveY)) {
+      point->Move(moveX, moveY);
+      return true;
+   }
+   return false;
+}
+
+//------------------------------------------------------
+// Collides any shape against the tiles
+//------------------------------------------------------
+bool TileMap::Collide(Shape* shape) const
+{
+   if (shape == 0 || !ShouldCollide(shape->Filter(), filter)) {
+      return false;
+   }
+
+   switch (shape->Type()) {
+      case SHAPE_POINT:
+         return CollidePoint(dynamic_cast<Point*>(shape));
+      case LINE:
+         return CollideLine(dynamic_cast<Line*>(shape));
+      case CIRCLE:
+         return CollideCircle(dynamic_cast<Circle*>(shape));
+      case BOX:
+         return CollideBox(dynamic_cast<Box*>(shape));
+      default:
+         return false;
+   };
+}
+
+//------------------------------------------------------
+// Walks the grid along a ray, one tile at a time
+// (Amanatides & Woo). Stops at the first solid tile.
+//------------------------------------------------------
+bool TileMap::RayCast(const Point& start, const Point& end, Point& hitPoint, Point& hitNormal) const
+{
+   float startX = (start.X() - originX) / tileSize;
+   float startY = (start.Y() - originY) / tileSize;
+   float dirX = (end.X() - start.X()) / tileSize;
+   float dirY = (end.Y() - start.Y()) / tileSize;
+
+   int column = (int)floorf(startX);
+   int row = (int)floorf(startY);
+
+   // Starting in a wall
+   if (Solid(column, row)) {
+      hitPoint = start;
+      hitNormal = Point(0.0f, 0.0f);
+      return true;
+   }
+
+   int stepX = (dirX > 0.0f ? 1 : (dirX < 0.0f ? -1 : 0));
+   int stepY = (dirY > 0.0f ? 1 : (dirY < 0.0f ? -1 : 0));
+
+   // How far along the ray (0 - 1) to cross one whole tile
+   const float never = 1e30f;
+   float deltaX = (stepX != 0 ? absValue(1.0f / dirX) : never);
+   float deltaY = (stepY != 0 ? absValue(1.0f / dirY) : never);
+
+   // How far along the ray the first tile edge is
+   float nextX = (stepX > 0 ? (column + 1 - startX) * deltaX : (stepX < 0 ? (startX - column) * deltaX : never));
+   float nextY = (stepY > 0 ? (row + 1 - startY) * deltaY : (stepY < 0 ? (startY - row) * deltaY : never));
+
+   while (true) {
+      float t;
+      bool crossedX = (nextX < nextY);
+      if (crossedX) {
+         t = nextX;
+         column += stepX;
+         nextX += deltaX;
+      }
+      else {
+         t = nextY;
+         row += stepY;
+         nextY += deltaY;
+      }
+
+      // Ran out of ray (or out of the map, heading away)
+      if (t > 1.0f) {
+         return false;
+      }
+      if ((column < 0 && stepX <= 0) || (column >= columns && stepX >= 0)
+         || (row < 0 && stepY <= 0) || (row >= rows && stepY >= 0)) {
+         return false;
+      }
+
+      if (Solid(column, row)) {
+         hitPoint = Point(start.X() + (end.X() - start.X()) * t, start.Y() + (end.Y() - start.Y()) * t);
+         hitNormal = (crossedX ? Point((float)-stepX, 0.0f) : Point(0.0f, (float)-stepY));
+         return true;
+      }
+   }
+}
@@ -0,0 +1,70 @@
+#ifndef TILEMAP_H_
+#define TILEMAP_H_
+
+#include "Collisions.h"
+
+   //------------------------------------------------------
+   // A grid of solid/empty square tiles, one bit per tile.
+   //
+   // Shapes collide against just the tiles under them, and
+   // no Box is ever made for a tile. Tile (0, 0) has its
+   // top left corner at the origin, columns go right (+x)
+   // and rows go down (+y).
+   //------------------------------------------------------
+   class TileMap
+   {
+   private:
+      // Bits for each row, 32 tiles per unsigned int
+      vector<unsigned int> bits;
+      int columns;
+      int rows;
+      int wordsPerRow;
+      float tileSize;
+      float originX;
+      float originY;
+      CollisionFilter filter;
+
+      AABB TileBounds(int column, int row) const;
+      void TileRange(const AABB& area, int& firstColumn, int& firstRow, int& lastColumn, int& lastRow) const;
+      bool CollidePoints(Point* points, int pointCount, Point* normals, int normalCount, float& moveX, float& moveY) const;
+
+   public:
+      TileMap(int columns = 0, int rows = 0, float tileSize = 32.0f, float originX = 0.0f, float originY = 0.0f);
+
+      // Resizes the map, everything becomes empty
+      void Resize(int columns, int rows);
+
+      // Accessors
+      int Columns() const { return columns; }
+      int Rows() const { return rows; }
+      float TileSize() const { return tileSize; }
+      float OriginX() const { return originX; }
+      float OriginY() const { return originY; }
+      const CollisionFilter& Filter() const { return filter; }
+      // Outside the map counts as empty
+      bool Solid(int column, int row) const;
+      bool SolidAt(float x, float y) const;
+      bool ContainsPoint(const Point& point) const { return SolidAt(point.X(), point.Y()); }
+
+      // Mutators
+      void Solid(int column, int row, bool solid);
+      void Origin(float x, float y) { originX = x; originY = y; }
+      void Filter(const CollisionFilter& filter) { this->filter = filter; }
+
+      // Collides shapes against the solid tiles. The tiles never
+      // move, so the shape takes the whole push.
+      // Returns true if any tile was hit.
+      bool CollideCircle(Circle* circle) const;
+      bool CollideBox(Box* box) const;
+      bool CollideLine(Line* line) const;
+      bool CollidePoint(Point* point) const;
+      bool Collide(Shape* shape) const;
+
+      // Walks the tiles from start to end (DDA), stopping at the
+      // first solid tile. Fills in where it hit and the normal of
+      // the tile side it went through. Starting inside a solid
+      // tile is a hit at the start with a zero normal.
+      bool RayCast(const Point& start, const Point& end, Point& hitPoint, Point& hitNormal) const;
+   };
+
+#endif // TILEMAP_H_
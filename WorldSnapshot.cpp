@@ -0,0 +1,187 @@
+#include "WorldSnapshot.h"
+#include "ShapeDistance.h"
+
+//------------------------------------------------------
+// Constructor
+//------------------------------------------------------
+WorldSnapshot::WorldSnapshot(int threadCount)
+   : index(threadCount)
+{
+   version = 0;
+   readers.store(0);
+}
+
+//------------------------------------------------------
+// Copies every shape in the world, then builds the tree.
+// Building takes everyone's bounds, which also fills in
+// the copies' lazy caches, so readers never write to them.
+//------------------------------------------------------
+void WorldSnapshot::Copy(const CollisionWorld& world, unsigned long long version)
+{
+   this->version = version;
+   points.clear();
+   lines.clear();
+   circles.clear();
+   boxes.clear();
+   chains.clear();
+   compounds.clear();
+   proxyIds.clear();
+   isStatic.clear();
+
+   // Copy first, point at the copies once the lists stop growing
+   vector<int> slots;
+   for (int proxyId = 0; proxyId < world.ProxyCapacity(); ++proxyId) {
+      Shape* shape = world.GetShape(proxyId);
+      if (shape == 0) {
+         continue;
+      }
+
+      switch (shape->Type()) {
+      case SHAPE_POINT:
+         slots.push_back((int)points.size());
+         points.push_back(*static_cast<Point*>(shape));
+         break;
+      case LINE:
+         slots.push_back((int)lines.size());
+         lines.push_back(*static_cast<Line*>(shape));
+         break;
+      case CIRCLE:
+         slots.push_back((int)circles.size());
+         circles.push_back(*static_cast<Circle*>(shape));
+         break;
+      case BOX:
+         slots.push_back((int)boxes.size());
+         boxes.push_back(*static_cast<Box*>(shape));
+         break;
+      case CHAIN:
+         slots.push_back((int)chains.size());
+         chains.push_back(*static_cast<Chain*>(shape));
+         break;
+      case COMPOUND:
+         slots.push_back((int)compounds.size());
+         compounds.push_back(*static_cast<Compound*>(shape));
+         break;
+      default:
+         continue;
+      }
+      proxyIds.push_back(proxyId);
+      isStatic.push_back(world.IsStatic(proxyId));
+   }
+
+   shapes.resize(proxyIds.size());
+   for (unsigned int ii = 0; ii < proxyIds.size(); ++ii) {
+      switch (world.GetShape(proxyIds[ii])->Type()) {
+      case SHAPE_POINT: shapes[ii] = &points[slots[ii]]; break;
+      case LINE: shapes[ii] = &lines[slots[ii]]; break;
+      case CIRCLE: shapes[ii] = &circles[slots[ii]]; break;
+      case BOX: shapes[ii] = &boxes[slots[ii]]; break;
+      case CHAIN: shapes[ii] = &chains[slots[ii]]; break;
+      case COMPOUND: shapes[ii] = &compounds[slots[ii]]; break;
+      default: break;
+      }
+   }
+
+   index.Build(shapes);
+}
+
+//------------------------------------------------------
+// Everything the probe overlaps
+//------------------------------------------------------
+void WorldSnapshot::Overlaps(Shape* probe, vector<int>& hits) const
+{
+   vector<int> reached;
+   index.Tree().Query(ShapeBounds(probe), reached);
+
+   hits.clear();
+   for (unsigned int ii = 0; ii < reached.size(); ++ii) {
+      Shape* shape = shapes[reached[ii]];
+      if (ShouldCollide(probe, shape) && ShapeDistance(probe, shape) <= 0.0f) {
+         hits.push_back(reached[ii]);
+      }
+   }
+}
+
+//------------------------------------------------------
+// A ray cast is a shape cast of a point. (So like any
+// shape cast, it stops just short of what it hits)
+//------------------------------------------------------
+bool WorldSnapshot::RayCast(const Point& start, const Point& end, CastHit& hit) const
+{
+   Point ray = start;
+   return index.ShapeCast(&ray, end.X() - start.X(), end.Y() - start.Y(), hit);
+}
+
+//------------------------------------------------------
+// Constructor
+//------------------------------------------------------
+SnapshotPublisher::SnapshotPublisher(int threadCount)
+{
+   this->threadCount = threadCount;
+   this->published = 0;
+   current.store(0);
+}
+
+//------------------------------------------------------
+// Destructor
+//------------------------------------------------------
+SnapshotPublisher::~SnapshotPublisher()
+{
+   for (unsigned int ii = 0; ii < snapshots.size(); ++ii) {
+      delete snapshots[ii];
+   }
+}
+
+//------------------------------------------------------
+// Fills a snapshot that isn't current and that nobody is
+// reading, then makes it current.
+//
+// A reader might grab a snapshot after we've seen it
+// unread and started refilling it. That's fine: readers
+// check it's still current after grabbing it, and it
+// won't be again until it's completely refilled.
+//------------------------------------------------------
+void SnapshotPublisher::Publish(const CollisionWorld& world)
+{
+   WorldSnapshot* live = current.load();
+   WorldSnapshot* spare = 0;
+   for (unsigned int ii = 0; ii < snapshots.size(); ++ii) {
+      if (snapshots[ii] != live && snapshots[ii]->readers.load() == 0) {
+         spare = snapshots[ii];
+         break;
+      }
+   }
+   if (spare == 0) {
+      spare = new WorldSnapshot(threadCount);
+      snapshots.push_back(spare);
+   }
+
+   spare->Copy(world, ++published);
+   current.store(spare);
+}
+
+//------------------------------------------------------
+// Grabs the current snapshot
+//------------------------------------------------------
+const WorldSnapshot* SnapshotPublisher::Acquire()
+{
+   while (true) {
+      WorldSnapshot* snapshot = current.load();
+      if (snapshot == 0) {
+         return 0;
+      }
+      snapshot->readers.fetch_add(1);
+      if (current.load() == snapshot) {
+         return snapshot;
+      }
+      // Retired before we got hold of it
+      snapshot->readers.fetch_sub(1);
+   }
+}
+
+//------------------------------------------------------
+// Lets go of a snapshot
+//------------------------------------------------------
+void SnapshotPublisher::Release(const WorldSnapshot* snapshot)
+{
+   snapshot->readers.fetch_sub(1);
+}
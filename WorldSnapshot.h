@@ -0,0 +1,122 @@
+#ifndef WORLDSNAPSHOT_H_
+#define WORLDSNAPSHOT_H_
+
+#include "Chain.h"
+#include "Compound.h"
+#include "ShapeIndex.h"
+
+#include <atomic>
+
+   //------------------------------------------------------
+   // A frozen copy of a CollisionWorld's shapes, with a
+   // ShapeIndex over them. Nothing in it changes once it's
+   // published, so any number of threads can query it while
+   // the world carries on.
+   //
+   // Shapes are known by their index in the snapshot;
+   // ProxyId() says which world proxy each one came from.
+   //------------------------------------------------------
+   class WorldSnapshot
+   {
+   private:
+      friend class SnapshotPublisher;
+
+      unsigned long long version;
+      vector<Point> points;
+      vector<Line> lines;
+      vector<Circle> circles;
+      vector<Box> boxes;
+      vector<Chain> chains;
+      vector<Compound> compounds;
+      vector<Shape*> shapes;
+      vector<int> proxyIds;
+      vector<bool> isStatic;
+      ShapeIndex index;
+      // Readers using this snapshot right now
+      mutable std::atomic<int> readers;
+
+      WorldSnapshot(int threadCount);
+      void Copy(const CollisionWorld& world, unsigned long long version);
+
+      WorldSnapshot(const WorldSnapshot&) = delete;
+      WorldSnapshot& operator=(const WorldSnapshot&) = delete;
+
+   public:
+      // Accessors
+      unsigned long long Version() const { return version; }
+      int Count() const { return (int)shapes.size(); }
+      const Shape* GetShape(int shapeIndex) const { return shapes[shapeIndex]; }
+      int ProxyId(int shapeIndex) const { return proxyIds[shapeIndex]; }
+      bool IsStatic(int shapeIndex) const { return isStatic[shapeIndex]; }
+      const ShapeIndex& Index() const { return index; }
+
+      // Everything the probe overlaps (touching counts), by snapshot index
+      void Overlaps(Shape* probe, vector<int>& hits) const;
+
+      // First thing a ray from start to end hits
+      bool RayCast(const Point& start, const Point& end, CastHit& hit) const;
+   };
+
+   //------------------------------------------------------
+   // Publishes snapshots of a world for other threads.
+   //
+   // Publish() (on the thread that steps the world) copies
+   // the world into a snapshot nobody is reading, and makes
+   // it the current one. Readers Acquire() the current
+   // snapshot and Release() it when done.
+   //
+   // Nobody ever waits. A reader that grabs a snapshot just
+   // as it's retired notices, lets go and tries the new one.
+   // If every old snapshot is still being read, Publish()
+   // makes another one rather than wait, so a slow reader
+   // only costs memory.
+   //------------------------------------------------------
+   class SnapshotPublisher
+   {
+   private:
+      int threadCount;
+      unsigned long long published;
+      // All snapshots ever made (only the publishing thread touches this)
+      vector<WorldSnapshot*> snapshots;
+      std::atomic<WorldSnapshot*> current;
+
+      SnapshotPublisher(const SnapshotPublisher&) = delete;
+      SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+   public:
+      // Threads used to build each snapshot's tree
+      SnapshotPublisher(int threadCount = 1);
+      // Readers must be done before this
+      ~SnapshotPublisher();
+
+      // Publishing thread only
+      void Publish(const CollisionWorld& world);
+      int SnapshotCount() const { return (int)snapshots.size(); }
+
+      // Any thread. Acquire() returns 0 before the first Publish().
+      const WorldSnapshot* Acquire();
+      void Release(const WorldSnapshot* snapshot);
+   };
+
+   //------------------------------------------------------
+   // Holds on to the current snapshot until it goes out
+   // of scope
+   //------------------------------------------------------
+   class SnapshotRef
+   {
+   private:
+      SnapshotPublisher* publisher;
+      const WorldSnapshot* snapshot;
+
+      SnapshotRef(const SnapshotRef&) = delete;
+      SnapshotRef& operator=(const SnapshotRef&) = delete;
+
+   public:
+      SnapshotRef(SnapshotPublisher& publisher) : publisher(&publisher), snapshot(publisher.Acquire()) {}
+      ~SnapshotRef() { if (snapshot != 0) publisher->Release(snapshot); }
+
+      const WorldSnapshot* Get() const { return snapshot; }
+      const WorldSnapshot* operator->() const { return snapshot; }
+   };
+
+#endif // WORLDSNAPSHOT_H_
@@ -0,0 +1,374 @@
+#include "WorldStreaming.h"
+#include "SceneFile.h"
+#include "ShapeDistance.h"
+
+// For floorf
+#include <cmath>
+// For snprintf
+#include <cstdio>
+
+//------------------------------------------------------
+// Builds the index over the static shapes, and the bounds
+// around them
+//------------------------------------------------------
+void ChunkData::BuildIndex()
+{
+   vector<Shape*> fixed;
+   for (unsigned int ii = 0; ii < shapes.size(); ++ii) {
+      Shape* shape = store.Get(shapes[ii]);
+      if (shape != 0 && isStatic[ii]) {
+         fixed.push_back(shape);
+      }
+   }
+   index.Build(fixed);
+
+   bounds = AABB();
+   for (int ii = 0; ii < index.Count(); ++ii) {
+      const AABB& current = index.Bounds(ii);
+      if (ii == 0) {
+         bounds = current;
+         continue;
+      }
+      if (current.minX < bounds.minX) bounds.minX = current.minX;
+      if (current.minY < bounds.minY) bounds.minY = current.minY;
+      if (current.maxX > bounds.maxX) bounds.maxX = current.maxX;
+      if (current.maxY > bounds.maxY) bounds.maxY = current.maxY;
+   }
+}
+
+//------------------------------------------------------
+// Adds up what the chunk's pools are holding on to. The
+// index is about a pointer and two boxes per shape.
+//------------------------------------------------------
+size_t ChunkData::MemoryBytes()
+{
+   return store.Points().Capacity() * sizeof(Point)
+      + store.Lines().Capacity() * sizeof(Line)
+      + store.Circles().Capacity() * sizeof(Circle)
+      + store.Boxes().Capacity() * sizeof(Box)
+      + shapes.capacity() * sizeof(ShapeHandle)
+      + isStatic.capacity() / 8
+      + index.Count() * (sizeof(Shape*) + 2 * sizeof(AABB));
+}
+
+//------------------------------------------------------
+// Loads a chunk's scene file into the chunk's pools
+//------------------------------------------------------
+bool SceneChunkSource::LoadChunk(int chunkX, int chunkY, ChunkData& chunk)
+{
+   char name[64];
+   snprintf(name, sizeof(name), "/chunk_%d_%d.c2ds", chunkX, chunkY);
+
+   SceneView view;
+   if (!view.Open((directory + name).c_str())) {
+      return false;
+   }
+
+   for (unsigned int ii = 0; ii < view.Points().count; ++ii) {
+      chunk.shapes.push_back(chunk.store.CreatePoint(view.MakePoint(ii)));
+   }
+   for (unsigned int ii = 0; ii < view.Lines().count; ++ii) {
+      chunk.shapes.push_back(chunk.store.CreateLine(view.MakeLine(ii)));
+   }
+   for (unsigned int ii = 0; ii < view.Circles().count; ++ii) {
+      chunk.shapes.push_back(chunk.store.CreateCircle(view.MakeCircle(ii)));
+   }
+   for (unsigned int ii = 0; ii < view.Boxes().count; ++ii) {
+      chunk.shapes.push_back(chunk.store.CreateBox(view.MakeBox(ii)));
+   }
+   chunk.isStatic.assign(chunk.shapes.size(), true);
+   return true;
+}
+
+//------------------------------------------------------
+// Constructor. Starts the streaming thread.
+//------------------------------------------------------
+StreamingWorld::StreamingWorld(CollisionWorld& world, ChunkSource& source, float chunkSize, int loadRadius, size_t memoryBudget)
+   : world(world), source(source)
+{
+   this->chunkSize = chunkSize;
+   this->loadRadius = loadRadius;
+   this->memoryBudget = memoryBudget;
+   frame = 0;
+   pending = 0;
+   quitting = false;
+   worker = std::thread(&StreamingWorld::WorkerLoop, this);
+}
+
+//------------------------------------------------------
+// Destructor. Stops the thread, and takes every chunk
+// back out of the world.
+//------------------------------------------------------
+StreamingWorld::~StreamingWorld()
+{
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      quitting = true;
+   }
+   wakeWorker.notify_all();
+   worker.join();
+
+   for (unsigned int ii = 0; ii < loaded.size(); ++ii) {
+      delete loaded[ii].data;
+   }
+   for (std::map<long long, Chunk>::iterator it = chunks.begin(); it != chunks.end(); ++it) {
+      Detach(it->second);
+      delete it->second.data;
+   }
+}
+
+//------------------------------------------------------
+// The streaming thread. Loads whatever is asked for.
+//------------------------------------------------------
+void StreamingWorld::WorkerLoop()
+{
+   std::unique_lock<std::mutex> guard(lock);
+   while (true) {
+      while (!quitting && requests.empty()) {
+         wakeWorker.wait(guard);
+      }
+      if (quitting) {
+         return;
+      }
+
+      Chunk request = requests.front();
+      requests.pop_front();
+
+      // Don't hold the lock while loading
+      guard.unlock();
+      ChunkData* data = new ChunkData();
+      if (!source.LoadChunk(request.x, request.y, *data)) {
+         delete data;
+         data = 0;
+      }
+      else {
+         data->BuildIndex();
+      }
+      guard.lock();
+
+      LoadedChunk done;
+      done.key = Key(request.x, request.y);
+      done.data = data;
+      loaded.push_back(done);
+      --pending;
+      loadFinished.notify_all();
+   }
+}
+
+//------------------------------------------------------
+// Adds a chunk's shapes to the world
+//------------------------------------------------------
+void StreamingWorld::Attach(Chunk& chunk)
+{
+   if (chunk.attached || chunk.data == 0) {
+      return;
+   }
+   chunk.proxies.clear();
+   for (unsigned int ii = 0; ii < chunk.data->shapes.size(); ++ii) {
+      chunk.proxies.push_back(world.AddShape(chunk.data->store, chunk.data->shapes[ii], chunk.data->isStatic[ii]));
+   }
+   chunk.attached = true;
+}
+
+//------------------------------------------------------
+// Takes a chunk's shapes back out of the world
+//------------------------------------------------------
+void StreamingWorld::Detach(Chunk& chunk)
+{
+   if (!chunk.attached) {
+      return;
+   }
+   world.RemoveShapes(chunk.proxies);
+   chunk.proxies.clear();
+   chunk.attached = false;
+}
+
+//------------------------------------------------------
+// Throws away the least recently wanted chunks until
+// everything fits in the budget. Wanted chunks stay.
+//------------------------------------------------------
+void StreamingWorld::EnforceBudget()
+{
+   size_t used = MemoryUsed();
+   while (used > memoryBudget) {
+      std::map<long long, Chunk>::iterator oldest = chunks.end();
+      for (std::map<long long, Chunk>::iterator it = chunks.begin(); it != chunks.end(); ++it) {
+         if (it->second.data != 0 && !it->second.loading && it->second.lastWanted != frame
+            && (oldest == chunks.end() || it->second.lastWanted < oldest->second.lastWanted)) {
+            oldest = it;
+         }
+      }
+      if (oldest == chunks.end()) {
+         // Everything left is wanted
+         return;
+      }
+
+      used -= oldest->second.data->MemoryBytes();
+      Detach(oldest->second);
+      delete oldest->second.data;
+      chunks.erase(oldest);
+   }
+}
+
+//------------------------------------------------------
+// Streams chunks around a single focus point
+//------------------------------------------------------
+void StreamingWorld::Update(const Point& focusPoint)
+{
+   vector<Point> focusPoints(1, focusPoint);
+   Update(focusPoints);
+}
+
+//------------------------------------------------------
+// Picks up finished loads, asks for newly wanted chunks,
+// attaches/detaches chunks, and sticks to the budget
+//------------------------------------------------------
+void StreamingWorld::Update(const vector<Point>& focusPoints)
+{
+   ++frame;
+
+   // Pick up whatever the thread finished
+   vector<LoadedChunk> finished;
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      finished.swap(loaded);
+   }
+   for (unsigned int ii = 0; ii < finished.size(); ++ii) {
+      std::map<long long, Chunk>::iterator it = chunks.find(finished[ii].key);
+      if (it == chunks.end()) {
+         delete finished[ii].data;
+         continue;
+      }
+      it->second.data = finished[ii].data;
+      it->second.loading = false;
+   }
+
+   // Mark what's wanted, and ask for what's missing
+   bool requested = false;
+   for (unsigned int ii = 0; ii < focusPoints.size(); ++ii) {
+      int centerX = (int)floorf(focusPoints[ii].X() / chunkSize);
+      int centerY = (int)floorf(focusPoints[ii].Y() / chunkSize);
+      for (int y = centerY - loadRadius; y <= centerY + loadRadius; ++y) {
+         for (int x = centerX - loadRadius; x <= centerX + loadRadius; ++x) {
+            long long key = Key(x, y);
+            std::map<long long, Chunk>::iterator it = chunks.find(key);
+            if (it == chunks.end()) {
+               Chunk chunk;
+               chunk.x = x;
+               chunk.y = y;
+               chunk.data = 0;
+               chunk.lastWanted = frame;
+               chunk.loading = true;
+               chunk.attached = false;
+               chunks[key] = chunk;
+
+               std::lock_guard<std::mutex> guard(lock);
+               requests.push_back(chunk);
+               ++pending;
+               requested = true;
+            }
+            else {
+               it->second.lastWanted = frame;
+            }
+         }
+      }
+   }
+   if (requested) {
+      wakeWorker.notify_one();
+   }
+
+   // Attach wanted chunks, detach the rest. Empty chunks
+   // are forgotten once they aren't wanted.
+   for (std::map<long long, Chunk>::iterator it = chunks.begin(); it != chunks.end();) {
+      Chunk& chunk = it->second;
+      if (chunk.lastWanted == frame) {
+         Attach(chunk);
+         ++it;
+      }
+      else {
+         Detach(chunk);
+         if (!chunk.loading && chunk.data == 0) {
+            chunks.erase(it++);
+         }
+         else {
+            ++it;
+         }
+      }
+   }
+
+   EnforceBudget();
+}
+
+//------------------------------------------------------
+// Waits for the streaming thread to catch up. The
+// chunks get attached by the next Update().
+//------------------------------------------------------
+void StreamingWorld::WaitForLoads()
+{
+   std::unique_lock<std::mutex> guard(lock);
+   while (pending > 0) {
+      loadFinished.wait(guard);
+   }
+}
+
+//------------------------------------------------------
+// Counts the chunks that are in memory
+//------------------------------------------------------
+int StreamingWorld::LoadedChunks() const
+{
+   int count = 0;
+   for (std::map<long long, Chunk>::const_iterator it = chunks.begin(); it != chunks.end(); ++it) {
+      if (it->second.data != 0) ++count;
+   }
+   return count;
+}
+
+//------------------------------------------------------
+// Counts the chunks that are in the world
+//------------------------------------------------------
+int StreamingWorld::AttachedChunks() const
+{
+   int count = 0;
+   for (std::map<long long, Chunk>::const_iterator it = chunks.begin(); it != chunks.end(); ++it) {
+      if (it->second.attached) ++count;
+   }
+   return count;
+}
+
+//------------------------------------------------------
+// Adds up the memory of every chunk in memory
+//------------------------------------------------------
+size_t StreamingWorld::MemoryUsed() const
+{
+   size_t total = 0;
+   for (std::map<long long, Chunk>::const_iterator it = chunks.begin(); it != chunks.end(); ++it) {
+      if (it->second.data != 0) total += it->second.data->MemoryBytes();
+   }
+   return total;
+}
+
+//------------------------------------------------------
+// Searches each attached chunk the probe reaches with the
+// chunk's own index
+//------------------------------------------------------
+void StreamingWorld::Overlaps(Shape* probe, vector<Shape*>& hits) const
+{
+   hits.clear();
+   AABB area = ShapeBounds(probe);
+   vector<int> reached;
+   for (std::map<long long, Chunk>::const_iterator it = chunks.begin(); it != chunks.end(); ++it) {
+      const Chunk& chunk = it->second;
+      if (!chunk.attached || chunk.data->index.Count() == 0 || !chunk.data->bounds.Overlaps(area)) {
+         continue;
+      }
+
+      reached.clear();
+      chunk.data->index.Tree().Query(area, reached);
+      for (unsigned int ii = 0; ii < reached.size(); ++ii) {
+         Shape* shape = chunk.data->index.GetShape(reached[ii]);
+         if (shape != probe && ShouldCollide(probe, shape) && ShapeDistance(probe, shape) <= 0.0f) {
+            hits.push_back(shape);
+         }
+      }
+   }
+}
@@ -0,0 +1,152 @@
+#ifndef WORLDSTREAMING_H_
+#define WORLDSTREAMING_H_
+
+#include "CollisionWorld.h"
+#include "ShapeIndex.h"
+#include "ShapePool.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+   //------------------------------------------------------
+   // The shapes for one chunk of the world, and a local
+   // index over its static ones. The index is built on the
+   // streaming thread once the chunk has loaded, so a chunk
+   // arrives ready to query.
+   //------------------------------------------------------
+   struct ChunkData
+   {
+      ShapeStore store;
+      vector<ShapeHandle> shapes;
+      vector<bool> isStatic;
+
+      // The static shapes, and the bounds around all of them
+      ShapeIndex index;
+      AABB bounds;
+
+      // Builds the index (the shapes mustn't be in a world yet)
+      void BuildIndex();
+
+      // Roughly how much memory the chunk is holding on to
+      size_t MemoryBytes();
+   };
+
+   //------------------------------------------------------
+   // Where chunks come from. LoadChunk is called on the
+   // streaming thread, so it mustn't touch the world.
+   //------------------------------------------------------
+   class ChunkSource
+   {
+   public:
+      virtual ~ChunkSource() {}
+
+      // Fills in a chunk. Returns false if there's nothing there.
+      virtual bool LoadChunk(int chunkX, int chunkY, ChunkData& chunk) = 0;
+   };
+
+   //------------------------------------------------------
+   // Loads chunks from scene files, named
+   // <directory>/chunk_<x>_<y>.c2ds. Everything loaded
+   // is static.
+   //------------------------------------------------------
+   class SceneChunkSource : public ChunkSource
+   {
+   private:
+      std::string directory;
+
+   public:
+      SceneChunkSource(const std::string& directory) : directory(directory) {}
+      bool LoadChunk(int chunkX, int chunkY, ChunkData& chunk);
+   };
+
+   //------------------------------------------------------
+   // Streams square chunks of the world in and out around
+   // focus points (the players).
+   //
+   // Chunks within loadRadius chunks of a focus point are
+   // wanted. Missing ones are loaded on a background thread,
+   // and get added to the world by the next Update() once
+   // they're done. Chunks that aren't wanted any more are
+   // taken out of the world, but kept in memory until the
+   // memory budget runs out, then the least recently used
+   // ones get thrown away.
+   //
+   // Shapes are added to/removed from the world one chunk
+   // at a time, so the broadphase never gets rebuilt.
+   //------------------------------------------------------
+   class StreamingWorld
+   {
+   private:
+      struct Chunk
+      {
+         int x;
+         int y;
+         ChunkData* data;
+         vector<int> proxies;
+         unsigned long lastWanted;
+         bool loading;
+         bool attached;
+      };
+
+      struct LoadedChunk
+      {
+         long long key;
+         ChunkData* data;
+      };
+
+      CollisionWorld& world;
+      ChunkSource& source;
+      float chunkSize;
+      int loadRadius;
+      size_t memoryBudget;
+      unsigned long frame;
+      std::map<long long, Chunk> chunks;
+
+      // Shared with the streaming thread
+      std::thread worker;
+      std::mutex lock;
+      std::condition_variable wakeWorker;
+      std::condition_variable loadFinished;
+      std::deque<Chunk> requests;
+      vector<LoadedChunk> loaded;
+      int pending;
+      bool quitting;
+
+      static long long Key(int x, int y) { return (long long)(((unsigned long long)(unsigned int)x << 32) | (unsigned int)y); }
+      void WorkerLoop();
+      void Attach(Chunk& chunk);
+      void Detach(Chunk& chunk);
+      void EnforceBudget();
+
+      StreamingWorld(const StreamingWorld&) = delete;
+      StreamingWorld& operator=(const StreamingWorld&) = delete;
+
+   public:
+      StreamingWorld(CollisionWorld& world, ChunkSource& source, float chunkSize, int loadRadius = 1, size_t memoryBudget = 64 * 1024 * 1024);
+      ~StreamingWorld();
+
+      // Call once a frame with where the players are
+      void Update(const vector<Point>& focusPoints);
+      void Update(const Point& focusPoint);
+
+      // Blocks until every requested chunk has loaded (loading screens)
+      void WaitForLoads();
+
+      // Accessors
+      float ChunkSize() const { return chunkSize; }
+      int LoadedChunks() const;
+      int AttachedChunks() const;
+      size_t MemoryUsed() const;
+      void MemoryBudget(size_t bytes) { memoryBudget = bytes; }
+
+      // Static shapes in attached chunks that the probe overlaps.
+      // Only chunks whose bounds it touches get searched, each
+      // through its own index.
+      void Overlaps(Shape* probe, vector<Shape*>& hits) const;
+   };
+
+#endif // WORLDSTREAMING_H_
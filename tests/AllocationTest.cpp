@@ -0,0 +1,163 @@
+//------------------------------------------------------
+// Checks that a CollisionWorld in a steady state steps
+// without touching the heap. Every global new is counted,
+// and once the world has settled (and its lists and the
+// frame allocator have grown as big as they need to be)
+// a run of steps must not make a single one. Sleep is off
+// and everything keeps falling onto the floor, so the
+// narrowphase, the sensor and contact events all run in
+// the steps that are counted.
+//
+// Build it with the library sources, e.g.
+//    g++ -std=c++11 -pthread -fpermissive -I.. AllocationTest.cpp ../*.cpp
+// (GCC wants -fpermissive for Box::Line(), which shares
+// its name with the Line class.) It prints what it found
+// and returns non-zero on failure.
+//------------------------------------------------------
+#include "../CollisionWorld.h"
+#include "../ContactEvents.h"
+#include "../FrameAllocator.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Only counted while a test is looking
+std::atomic<bool> countingAllocations(false);
+std::atomic<long> allocationCount(0);
+
+void* operator new(size_t size)
+{
+   if (countingAllocations) {
+      ++allocationCount;
+   }
+   void* memory = malloc(size > 0 ? size : 1);
+   if (memory == 0) {
+      throw std::bad_alloc();
+   }
+   return memory;
+}
+
+void* operator new[](size_t size)
+{
+   return operator new(size);
+}
+
+// Called through a pointer so GCC can't see memory from
+// operator new going to free() and warn that they don't match
+void (*volatile releaseMemory)(void*) = free;
+
+void operator delete(void* memory) noexcept
+{
+   releaseMemory(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+   operator delete(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+   operator delete(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+   operator delete(memory);
+}
+
+//------------------------------------------------------
+// Moves every shape down a little, so they keep landing
+// on the floor and on each other
+//------------------------------------------------------
+void Fall(vector<Shape*>& shapes, float distance)
+{
+   for (unsigned int ii = 0; ii < shapes.size(); ++ii) {
+      Shape* shape = shapes[ii];
+      switch (shape->Type()) {
+      case SHAPE_POINT: static_cast<Point*>(shape)->Move(0.0f, -distance); break;
+      case LINE: static_cast<Line*>(shape)->Move(0.0f, -distance); break;
+      case CIRCLE: static_cast<Circle*>(shape)->Move(0.0f, -distance); break;
+      case BOX: static_cast<Box*>(shape)->Move(0.0f, -distance); break;
+      default: break;
+      }
+   }
+}
+
+//------------------------------------------------------
+// Steps a world a few times to let everything settle,
+// then counts what the next ones allocate. Also counts
+// the contacts found in the counted steps, to show they
+// really collided something.
+//------------------------------------------------------
+long CountStepAllocations(CollisionWorld& world, vector<Shape*>& shapes, int warmUpSteps, int countedSteps, long& contacts)
+{
+   for (int ii = 0; ii < warmUpSteps; ++ii) {
+      Fall(shapes, 1.0f);
+      world.Step();
+      ThreadFrameAllocator().Reset();
+   }
+
+   contacts = 0;
+   allocationCount = 0;
+   countingAllocations = true;
+   for (int ii = 0; ii < countedSteps; ++ii) {
+      Fall(shapes, 1.0f);
+      world.Step();
+      contacts += (long)world.Contacts().size();
+      ThreadFrameAllocator().Reset();
+   }
+   countingAllocations = false;
+   return allocationCount;
+}
+
+int main()
+{
+   int failures = 0;
+
+   // A pile of every kind of shape, overlapping to begin
+   // with, on a static floor, with a sensor over part of it
+   // and contact events on
+   vector<Shape*> shapes;
+   for (int ii = 0; ii < 40; ++ii) {
+      float x = (float)(ii % 10) * 18.0f;
+      float y = (float)(ii / 10) * 18.0f;
+      switch (ii % 4) {
+      case 0: shapes.push_back(new Box(Point(x, y), 20.0f, 12.0f, (float)(ii * 7))); break;
+      case 1: shapes.push_back(new Circle(Point(x, y), 10.0f)); break;
+      case 2: shapes.push_back(new Line(Point(x - 8.0f, y - 3.0f), Point(x + 8.0f, y + 3.0f))); break;
+      default: shapes.push_back(new Point(x, y)); break;
+      }
+   }
+   Box* floor = new Box(Point(90.0f, -20.0f), 400.0f, 20.0f, 0.0f);
+   Circle* sensor = new Circle(Point(40.0f, 20.0f), 30.0f);
+
+   ContactEventRing ring(1 << 12);
+   CollisionWorld world;
+   world.SleepEnabled(false);
+   world.ContactEvents(&ring);
+   for (unsigned int ii = 0; ii < shapes.size(); ++ii) {
+      world.AddShape(shapes[ii]);
+   }
+   world.AddShape(floor, true);
+   world.AddSensor(sensor);
+
+   long contacts = 0;
+   long allocations = CountStepAllocations(world, shapes, 200, 100, contacts);
+   printf("Steady state Step(): %ld allocations, %ld contacts in 100 steps\n", allocations, contacts);
+   if (allocations != 0 || contacts == 0) {
+      ++failures;
+   }
+
+   world.ContactEvents(0);
+   for (unsigned int ii = 0; ii < shapes.size(); ++ii) {
+      delete shapes[ii];
+   }
+   delete floor;
+   delete sensor;
+
+   printf(failures == 0 ? "PASSED\n" : "FAILED\n");
+   return (failures == 0 ? 0 : 1);
+}
@@ -0,0 +1,110 @@
+//------------------------------------------------------
+// Checks that snapshots of a world can be read from many
+// threads at once. A snapshot is meant to be read-only, so
+// nothing a query touches (compound children included)
+// may still have a lazy cache left to fill in. The same
+// probes go through a one thread QueryService and a four
+// thread one, and must find the same shapes.
+//
+// Build it with the library sources, e.g.
+//    g++ -std=c++11 -pthread -fpermissive -fsanitize=thread -I.. SnapshotThreadTest.cpp ../*.cpp
+// so any write a reader makes shows up as a race. (GCC
+// wants -fpermissive for Box::Line().) It prints what it
+// found and returns non-zero on failure.
+//------------------------------------------------------
+#include "../CollisionWorld.h"
+#include "../Compound.h"
+#include "../QueryService.h"
+#include "../WorldSnapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <future>
+
+const int probeCount = 400;
+
+//------------------------------------------------------
+// Fills a compound with a few of each kind of child
+//------------------------------------------------------
+void AddChildren(Compound& compound)
+{
+   for (int ii = 0; ii < 4; ++ii) {
+      float offset = (float)ii * 15.0f;
+      compound.AddChild(Line(Point(offset - 5.0f, -20.0f), Point(offset + 5.0f, 20.0f)));
+      compound.AddChild(Circle(Point(offset, 30.0f), 6.0f));
+      compound.AddChild(Box(Point(offset, -30.0f), 8.0f, 4.0f, (float)(ii * 20)));
+      compound.AddChild(Point(offset, 0.0f));
+   }
+}
+
+//------------------------------------------------------
+// Runs every probe through a service and waits for them
+//------------------------------------------------------
+vector<vector<int> > RunProbes(QueryService& service, vector<Circle>& probes)
+{
+   vector<std::future<vector<int> > > pending;
+   for (unsigned int ii = 0; ii < probes.size(); ++ii) {
+      pending.push_back(service.Overlaps(&probes[ii]));
+   }
+   service.Flush();
+
+   vector<vector<int> > results;
+   for (unsigned int ii = 0; ii < pending.size(); ++ii) {
+      results.push_back(pending[ii].get());
+      std::sort(results.back().begin(), results.back().end());
+   }
+   return results;
+}
+
+int main()
+{
+   int failures = 0;
+
+   // One compound that never moves, and one that has been
+   // moved since its caches were last filled in
+   Compound still(0.0f, 0.0f, 30.0f);
+   AddChildren(still);
+   Compound moved(200.0f, 0.0f, 0.0f);
+   AddChildren(moved);
+   moved.Bounds();
+   moved.Move(-40.0f, 10.0f);
+
+   CollisionWorld world;
+   world.AddShape(&still, true);
+   world.AddShape(&moved);
+   world.SleepEnabled(false);
+   world.Step();
+
+   vector<Circle> probes;
+   for (int ii = 0; ii < probeCount; ++ii) {
+      float x = -40.0f + (float)(ii % 40) * 6.0f;
+      float y = -40.0f + (float)(ii / 40) * 8.0f;
+      probes.push_back(Circle(Point(x, y), 3.0f));
+   }
+
+   SnapshotPublisher expectedPublisher(1);
+   expectedPublisher.Publish(world);
+   QueryService expectedService(expectedPublisher, 1);
+   vector<vector<int> > expected = RunProbes(expectedService, probes);
+
+   SnapshotPublisher sharedPublisher(4);
+   sharedPublisher.Publish(world);
+   QueryService sharedService(sharedPublisher, 4);
+   vector<vector<int> > shared = RunProbes(sharedService, probes);
+
+   int hits = 0;
+   int mismatches = 0;
+   for (int ii = 0; ii < probeCount; ++ii) {
+      hits += (int)expected[ii].size();
+      if (shared[ii] != expected[ii]) {
+         ++mismatches;
+      }
+   }
+   printf("%d probes on 4 threads: %d hits, %d mismatches\n", probeCount, hits, mismatches);
+   if (hits == 0 || mismatches != 0) {
+      ++failures;
+   }
+
+   printf(failures == 0 ? "PASSED\n" : "FAILED\n");
+   return (failures == 0 ? 0 : 1);
+}